@@ -0,0 +1,75 @@
+// -----------------------------------------------------------------------------
+// Instantiates every queue flavour for BENCH_PAYLOAD along with the type
+// erased wrappers used by the flavour table. Include once per payload type
+// from bench_queues.c.
+// -----------------------------------------------------------------------------
+
+#if !defined(BENCH_PAYLOAD)
+    #error Please define BENCH_PAYLOAD
+#endif
+
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_TYPE BENCH_PAYLOAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_TYPE BENCH_PAYLOAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/fan_in.h>
+
+#define QUEUE_MP   1
+#define QUEUE_MC   0
+#define QUEUE_TYPE BENCH_PAYLOAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_MP   0
+#define QUEUE_MC   1
+#define QUEUE_TYPE BENCH_PAYLOAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_TYPE BENCH_PAYLOAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+typedef BENCH_PAYLOAD BENCH_MERGE(Spread_, BENCH_PAYLOAD);
+
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_TYPE BENCH_MERGE(Spread_, BENCH_PAYLOAD)
+#define QUEUE_CELL_LAYOUT_SPREAD
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+typedef BENCH_PAYLOAD BENCH_MERGE(Faa_, BENCH_PAYLOAD);
+
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_TYPE BENCH_MERGE(Faa_, BENCH_PAYLOAD)
+#define QUEUE_MPMC_ENGINE_FAA
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+typedef BENCH_PAYLOAD BENCH_MERGE(Wait_, BENCH_PAYLOAD);
+
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_TYPE BENCH_MERGE(Wait_, BENCH_PAYLOAD)
+#define QUEUE_WAIT
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+BENCH_WRAP(spsc, Spsc, BENCH_PAYLOAD)
+BENCH_WRAP(spsc, Spsc, BENCH_MERGE(Wait_, BENCH_PAYLOAD))
+BENCH_WRAP(mpsc, Mpsc, BENCH_PAYLOAD)
+BENCH_WRAP(spmc, Spmc, BENCH_PAYLOAD)
+BENCH_WRAP(mpmc, Mpmc, BENCH_PAYLOAD)
+BENCH_WRAP(mpmc, Mpmc, BENCH_MERGE(Spread_, BENCH_PAYLOAD))
+BENCH_WRAP(mpmc, Mpmc, BENCH_MERGE(Faa_, BENCH_PAYLOAD))
+BENCH_WRAP_FAN_IN(BENCH_PAYLOAD)
+
+#undef BENCH_PAYLOAD
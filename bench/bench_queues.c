@@ -0,0 +1,791 @@
+// -----------------------------------------------------------------------------
+// Throughput and latency benchmark for every queue flavour.
+//
+// Each run starts the producers and consumers together, producers stamp every
+// message with the time it was enqueued and consumers histogram the time it
+// took to come out the other end. Results are printed as csv or json so they
+// can be diffed between releases.
+// -----------------------------------------------------------------------------
+#if defined(__linux__)
+#define _GNU_SOURCE // pthread_setaffinity_np
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include <stdatomic.h>
+
+// -----------------------------------------------------------------------------
+
+typedef struct Payload_8
+{
+    uint64_t stamp;
+}
+Payload_8;
+
+typedef struct Payload_64
+{
+    uint64_t stamp;
+    uint8_t  bytes[64 - sizeof(uint64_t)];
+}
+Payload_64;
+
+typedef struct Payload_512
+{
+    uint64_t stamp;
+    uint8_t  bytes[512 - sizeof(uint64_t)];
+}
+Payload_512;
+
+typedef struct Payload_4096
+{
+    uint64_t stamp;
+    uint8_t  bytes[4096 - sizeof(uint64_t)];
+}
+Payload_4096;
+
+// -----------------------------------------------------------------------------
+
+#define BENCH_MERGE_BASE(a, b) a ## b
+#define BENCH_MERGE(a, b)      BENCH_MERGE_BASE(a, b)
+
+#define BENCH_WRAP(fn, St, T) BENCH_WRAP_BASE(fn, St, T)
+#define BENCH_WRAP_BASE(fn, St, T)                                             \
+    static Queue_Result fn##_make_##T                                          \
+    (                                                                          \
+          size_t   cells                                                       \
+        , unsigned producers                                                   \
+        , void*    q                                                           \
+        , size_t*  bytes                                                       \
+    )                                                                          \
+    {                                                                          \
+        (void) producers;                                                      \
+        return fn##_make_queue_##T(cells, (Queue_##St##_##T*) q, bytes);       \
+    }                                                                          \
+    static Queue_Result fn##_push_##T(void* q, void const* data)               \
+    {                                                                          \
+        return fn##_try_enqueue_##T((Queue_##St##_##T*) q, (T const*) data);   \
+    }                                                                          \
+    static Queue_Result fn##_pop_##T(void* q, void* data)                      \
+    {                                                                          \
+        return fn##_try_dequeue_##T((Queue_##St##_##T*) q, (T*) data);         \
+    }
+
+// Fan in gets the same total cells as the others, split between the producers,
+// and each producer thread registers for its ring on its first push. Threads
+// are started fresh for every run, so the token never outlives its queue.
+#define BENCH_WRAP_FAN_IN(T) BENCH_WRAP_FAN_IN_BASE(T)
+#define BENCH_WRAP_FAN_IN_BASE(T)                                              \
+    static Queue_Result fan_in_make_##T                                        \
+    (                                                                          \
+          size_t   cells                                                       \
+        , unsigned producers                                                   \
+        , void*    q                                                           \
+        , size_t*  bytes                                                       \
+    )                                                                          \
+    {                                                                          \
+        size_t ring_cells = cells / producers;                                 \
+                                                                               \
+        while (ring_cells & (ring_cells - 1))                                  \
+        {                                                                      \
+            ring_cells &= ring_cells - 1;                                      \
+        }                                                                      \
+                                                                               \
+        return fan_in_make_queue_##T                                           \
+        (                                                                      \
+              producers                                                        \
+            , (ring_cells < 16) ? 16 : ring_cells                              \
+            , (Queue_Fan_In_##T*) q                                            \
+            , bytes                                                            \
+        );                                                                     \
+    }                                                                          \
+    static Queue_Result fan_in_push_##T(void* q, void const* data)             \
+    {                                                                          \
+        static _Thread_local size_t token_plus_one;                            \
+                                                                               \
+        if (!token_plus_one)                                                   \
+        {                                                                      \
+            size_t token = 0;                                                  \
+                                                                               \
+            Queue_Result result =                                              \
+                fan_in_register_producer_##T((Queue_Fan_In_##T*) q, &token);  \
+                                                                               \
+            if (result != Queue_Result_Ok)                                     \
+            {                                                                  \
+                return result;                                                 \
+            }                                                                  \
+                                                                               \
+            token_plus_one = token + 1;                                        \
+        }                                                                      \
+                                                                               \
+        return fan_in_try_enqueue_##T                                          \
+        (                                                                      \
+              (Queue_Fan_In_##T*) q                                            \
+            , token_plus_one - 1                                               \
+            , (T const*) data                                                  \
+        );                                                                     \
+    }                                                                          \
+    static Queue_Result fan_in_pop_##T(void* q, void* data)                    \
+    {                                                                          \
+        return fan_in_try_dequeue_##T((Queue_Fan_In_##T*) q, (T*) data);       \
+    }
+
+#define BENCH_PAYLOAD Payload_8
+#include "bench_flavours.h"
+
+#define BENCH_PAYLOAD Payload_64
+#include "bench_flavours.h"
+
+#define BENCH_PAYLOAD Payload_512
+#include "bench_flavours.h"
+
+#define BENCH_PAYLOAD Payload_4096
+#include "bench_flavours.h"
+
+// -----------------------------------------------------------------------------
+
+typedef Queue_Result (*Bench_Make)(size_t, unsigned, void*, size_t*);
+typedef Queue_Result (*Bench_Push)(void*, void const*);
+typedef Queue_Result (*Bench_Pop) (void*, void*);
+
+typedef struct Bench_Flavour
+{
+    const char* name;
+    unsigned    multi_producer;
+    unsigned    multi_consumer;
+    size_t      payload_bytes;
+    Bench_Make  make;
+    Bench_Push  push;
+    Bench_Pop   pop;
+}
+Bench_Flavour;
+
+#define BENCH_ENTRY(name, fn, T, mp, mc) BENCH_ENTRY_BASE(name, fn, T, mp, mc)
+#define BENCH_ENTRY_BASE(name, fn, T, mp, mc)                                  \
+    {name, mp, mc, sizeof(T), fn##_make_##T, fn##_push_##T, fn##_pop_##T}
+
+#define BENCH_ENTRIES(T)                                                       \
+      BENCH_ENTRY("Spsc",        spsc, T,                0, 0)                 \
+    , BENCH_ENTRY("Spsc_Wait",   spsc, Wait_##T,         0, 0)                 \
+    , BENCH_ENTRY("Mpsc",        mpsc, T,                1, 0)                 \
+    , BENCH_ENTRY("Spmc",        spmc, T,                0, 1)                 \
+    , BENCH_ENTRY("Mpmc",        mpmc, T,                1, 1)                 \
+    , BENCH_ENTRY("Mpmc_Spread", mpmc, Spread_##T,       1, 1)                 \
+    , BENCH_ENTRY("Mpmc_Faa",    mpmc, Faa_##T,          1, 1)                 \
+    , BENCH_ENTRY("Fan_In",      fan_in, T,              1, 0)
+
+static const Bench_Flavour flavours[] =
+{
+      BENCH_ENTRIES(Payload_8)
+    , BENCH_ENTRIES(Payload_64)
+    , BENCH_ENTRIES(Payload_512)
+    , BENCH_ENTRIES(Payload_4096)
+};
+
+#define BENCH_FLAVOUR_COUNT (sizeof(flavours) / sizeof(flavours[0]))
+
+// -----------------------------------------------------------------------------
+// Time and latency histogram
+// -----------------------------------------------------------------------------
+
+static uint64_t now_ns(void)
+{
+    struct timespec now;
+
+#if defined(CLOCK_MONOTONIC_RAW)
+    clock_gettime(CLOCK_MONOTONIC_RAW, &now);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &now);
+#endif
+
+    return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+}
+
+// Log linear buckets: 16 sub buckets for every power of two, so each bucket is
+// within about 6% of the values that land in it.
+#define BENCH_SUB_BITS     4
+#define BENCH_SUB_BUCKETS  (1 << BENCH_SUB_BITS)
+#define BENCH_BUCKETS      (64 * BENCH_SUB_BUCKETS)
+
+typedef struct Histogram
+{
+    uint64_t counts[BENCH_BUCKETS];
+    uint64_t max;
+    uint64_t total;
+}
+Histogram;
+
+static unsigned bucket_of(uint64_t value)
+{
+    if (value < BENCH_SUB_BUCKETS)
+    {
+        return (unsigned) value;
+    }
+
+    unsigned top   = 63 - (unsigned) __builtin_clzll(value);
+    unsigned shift = top - BENCH_SUB_BITS;
+    unsigned sub   = (unsigned) (value >> shift) & (BENCH_SUB_BUCKETS - 1);
+
+    return ((shift + 1) * BENCH_SUB_BUCKETS) + sub;
+}
+
+static uint64_t bucket_top(unsigned bucket)
+{
+    if (bucket < BENCH_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+
+    unsigned shift = (bucket / BENCH_SUB_BUCKETS) - 1;
+    uint64_t sub   = bucket % BENCH_SUB_BUCKETS;
+
+    return (((BENCH_SUB_BUCKETS + sub + 1) << shift) - 1);
+}
+
+static void histogram_add(Histogram* histogram, uint64_t value)
+{
+    histogram->counts[bucket_of(value)]++;
+    histogram->total++;
+
+    if (value > histogram->max)
+    {
+        histogram->max = value;
+    }
+}
+
+static void histogram_merge(Histogram* into, Histogram const* from)
+{
+    for (unsigned i = 0; i < BENCH_BUCKETS; i++)
+    {
+        into->counts[i] += from->counts[i];
+    }
+
+    into->total += from->total;
+
+    if (from->max > into->max)
+    {
+        into->max = from->max;
+    }
+}
+
+static uint64_t histogram_percentile(Histogram const* histogram, double percent)
+{
+    uint64_t wanted = (uint64_t) ((double) histogram->total * percent / 100.0);
+    uint64_t seen   = 0;
+
+    for (unsigned i = 0; i < BENCH_BUCKETS; i++)
+    {
+        seen += histogram->counts[i];
+
+        if (seen > wanted)
+        {
+            uint64_t top = bucket_top(i);
+
+            return (top < histogram->max) ? top : histogram->max;
+        }
+    }
+
+    return histogram->max;
+}
+
+// -----------------------------------------------------------------------------
+// Threads
+// -----------------------------------------------------------------------------
+
+typedef struct Run
+{
+    Bench_Flavour const* flavour;
+    void*                q;
+    unsigned             producers;
+    unsigned             consumers;
+    uint64_t             messages;
+    int                  oversubscribed;
+
+    atomic_uint          ready;
+    atomic_int           go;
+    atomic_uint_fast64_t consumed;
+}
+Run;
+
+typedef struct Worker
+{
+    Run*       run;
+    unsigned   index;
+    unsigned   cpu;
+    uint64_t   messages;
+    uint64_t   finished;
+    Histogram* histogram;
+}
+Worker;
+
+static unsigned cpu_count(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return (count > 0) ? (unsigned) count : 1;
+}
+
+static void pin(unsigned cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void) cpu;
+#endif
+}
+
+static void backoff(Run const* run)
+{
+    if (run->oversubscribed)
+    {
+        sched_yield();
+    }
+    else
+    {
+        QUEUE_PAUSE();
+    }
+}
+
+static void start(Worker* worker)
+{
+    pin(worker->cpu);
+
+    atomic_fetch_add_explicit(&worker->run->ready, 1, memory_order_acq_rel);
+
+    while (!atomic_load_explicit(&worker->run->go, memory_order_acquire))
+    {
+        QUEUE_PAUSE();
+    }
+}
+
+static void* producer(void* data)
+{
+    Worker* worker = (Worker*) data;
+    Run*    run    = worker->run;
+
+    // Big enough for the largest payload, only the stamp is written.
+    static _Thread_local Payload_4096 item;
+
+    start(worker);
+
+    for (uint64_t i = 0; i < worker->messages; i++)
+    {
+        item.stamp = now_ns();
+
+        while (run->flavour->push(run->q, &item) != Queue_Result_Ok)
+        {
+            backoff(run);
+        }
+    }
+
+    return NULL;
+}
+
+static void* consumer(void* data)
+{
+    Worker* worker = (Worker*) data;
+    Run*    run    = worker->run;
+
+    static _Thread_local Payload_4096 item;
+
+    uint64_t pending = 0;
+
+    start(worker);
+
+    for (;;)
+    {
+        if (run->flavour->pop(run->q, &item) == Queue_Result_Ok)
+        {
+            histogram_add(worker->histogram, now_ns() - item.stamp);
+
+            if (++pending < 256)
+            {
+                continue;
+            }
+        }
+
+        uint64_t consumed = pending + atomic_fetch_add_explicit
+        (
+              &run->consumed
+            , pending
+            , memory_order_relaxed
+        );
+
+        pending = 0;
+
+        if (consumed >= run->messages)
+        {
+            break;
+        }
+
+        backoff(run);
+    }
+
+    worker->finished = now_ns();
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Runs
+// -----------------------------------------------------------------------------
+
+typedef enum Format
+{
+      Format_Csv
+    , Format_Json
+}
+Format;
+
+typedef struct Options
+{
+    Format   format;
+    uint64_t messages;
+    unsigned max_threads;
+    unsigned quick;
+    const char* flavour;
+    size_t      payload;
+}
+Options;
+
+static unsigned results_printed = 0;
+
+static void print_result
+(
+      Options const*       options
+    , Run const*           run
+    , size_t               capacity
+    , double               seconds
+    , Histogram const*     histogram
+)
+{
+    double rate = (double) run->messages / seconds;
+
+    uint64_t p50  = histogram_percentile(histogram, 50.0);
+    uint64_t p99  = histogram_percentile(histogram, 99.0);
+    uint64_t p999 = histogram_percentile(histogram, 99.9);
+
+    if (options->format == Format_Csv)
+    {
+        if (!results_printed)
+        {
+            printf
+            (
+                "flavour,payload_bytes,capacity,producers,consumers,"
+                "messages,seconds,messages_per_second,"
+                "p50_ns,p99_ns,p999_ns,max_ns\n"
+            );
+        }
+
+        printf
+        (
+              "%s,%zu,%zu,%u,%u,%llu,%.6f,%.0f,%llu,%llu,%llu,%llu\n"
+            , run->flavour->name
+            , run->flavour->payload_bytes
+            , capacity
+            , run->producers
+            , run->consumers
+            , (unsigned long long) run->messages
+            , seconds
+            , rate
+            , (unsigned long long) p50
+            , (unsigned long long) p99
+            , (unsigned long long) p999
+            , (unsigned long long) histogram->max
+        );
+    }
+    else
+    {
+        printf
+        (
+              "%s\n  {\"flavour\": \"%s\", \"payload_bytes\": %zu"
+              ", \"capacity\": %zu, \"producers\": %u, \"consumers\": %u"
+              ", \"messages\": %llu, \"seconds\": %.6f"
+              ", \"messages_per_second\": %.0f"
+              ", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu"
+              ", \"max_ns\": %llu}"
+            , results_printed ? "," : "["
+            , run->flavour->name
+            , run->flavour->payload_bytes
+            , capacity
+            , run->producers
+            , run->consumers
+            , (unsigned long long) run->messages
+            , seconds
+            , rate
+            , (unsigned long long) p50
+            , (unsigned long long) p99
+            , (unsigned long long) p999
+            , (unsigned long long) histogram->max
+        );
+    }
+
+    results_printed++;
+
+    fflush(stdout);
+}
+
+static int bench
+(
+      Options const*       options
+    , Bench_Flavour const* flavour
+    , size_t               capacity
+    , unsigned             producers
+    , unsigned             consumers
+)
+{
+    size_t bytes = 0;
+
+    if (flavour->make(capacity, producers, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return 1;
+    }
+
+    size_t align = QUEUE_CACHELINE_BYTES;
+
+    bytes = (bytes + align - 1) & ~(align - 1);
+
+    void* q = aligned_alloc(align, bytes);
+
+    if (!q || (flavour->make(capacity, producers, q, &bytes) != Queue_Result_Ok))
+    {
+        free(q);
+        return 1;
+    }
+
+    Run run;
+
+    run.flavour        = flavour;
+    run.q              = q;
+    run.producers      = producers;
+    run.consumers      = consumers;
+    run.messages       = options->messages;
+    run.oversubscribed = (producers + consumers) > cpu_count();
+
+    atomic_init(&run.ready,    0);
+    atomic_init(&run.go,       0);
+    atomic_init(&run.consumed, 0);
+
+    unsigned   count     = producers + consumers;
+    pthread_t* threads   = (pthread_t*) calloc(count, sizeof(pthread_t));
+    Worker*    workers   = (Worker*)    calloc(count, sizeof(Worker));
+    Histogram* histogram = (Histogram*) calloc(consumers + 1, sizeof(Histogram));
+
+    if (!threads || !workers || !histogram)
+    {
+        free(threads);
+        free(workers);
+        free(histogram);
+        free(q);
+        return 1;
+    }
+
+    unsigned cpus = cpu_count();
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        Worker* worker = &workers[i];
+
+        worker->run   = &run;
+        worker->index = i;
+        worker->cpu   = i % cpus;
+
+        if (i < producers)
+        {
+            worker->messages = options->messages / producers;
+
+            if (i < (options->messages % producers))
+            {
+                worker->messages++;
+            }
+
+            pthread_create(&threads[i], NULL, producer, worker);
+        }
+        else
+        {
+            worker->histogram = &histogram[i - producers + 1];
+
+            pthread_create(&threads[i], NULL, consumer, worker);
+        }
+    }
+
+    while (atomic_load_explicit(&run.ready, memory_order_acquire) < count)
+    {
+        sched_yield();
+    }
+
+    uint64_t begin = now_ns();
+
+    atomic_store_explicit(&run.go, 1, memory_order_release);
+
+    uint64_t end = begin;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        pthread_join(threads[i], NULL);
+
+        if ((i >= producers) && (workers[i].finished > end))
+        {
+            end = workers[i].finished;
+        }
+    }
+
+    for (unsigned i = 1; i <= consumers; i++)
+    {
+        histogram_merge(&histogram[0], &histogram[i]);
+    }
+
+    double seconds = (double) (end - begin) / 1e9;
+
+    print_result(options, &run, capacity, seconds, &histogram[0]);
+
+    free(threads);
+    free(workers);
+    free(histogram);
+    free(q);
+
+    return 0;
+}
+
+static void usage(const char* name)
+{
+    fprintf
+    (
+          stderr
+        , "usage: %s [--csv | --json] [--messages N] [--threads N]\n"
+          "          [--flavour NAME] [--payload BYTES] [--quick]\n"
+        , name
+    );
+}
+
+int main(int arg_count, char** args)
+{
+    Options options;
+
+    options.format      = Format_Csv;
+    options.messages    = 1 << 20;
+    options.max_threads = cpu_count();
+    options.quick       = 0;
+    options.flavour     = NULL;
+    options.payload     = 0;
+
+    for (int i = 1; i < arg_count; i++)
+    {
+        const char* arg = args[i];
+        const char* value = (i + 1 < arg_count) ? args[i + 1] : NULL;
+
+        if (!strcmp(arg, "--csv"))
+        {
+            options.format = Format_Csv;
+        }
+        else if (!strcmp(arg, "--json"))
+        {
+            options.format = Format_Json;
+        }
+        else if (!strcmp(arg, "--quick"))
+        {
+            options.quick    = 1;
+            options.messages = 1 << 16;
+        }
+        else if (!strcmp(arg, "--messages") && value)
+        {
+            options.messages = strtoull(value, NULL, 10);
+            i++;
+        }
+        else if (!strcmp(arg, "--threads") && value)
+        {
+            options.max_threads = (unsigned) strtoul(value, NULL, 10);
+            i++;
+        }
+        else if (!strcmp(arg, "--flavour") && value)
+        {
+            options.flavour = value;
+            i++;
+        }
+        else if (!strcmp(arg, "--payload") && value)
+        {
+            options.payload = (size_t) strtoull(value, NULL, 10);
+            i++;
+        }
+        else
+        {
+            usage(args[0]);
+            return 1;
+        }
+    }
+
+    if (options.max_threads < 2)
+    {
+        options.max_threads = 2;
+    }
+
+    if (!options.messages)
+    {
+        usage(args[0]);
+        return 1;
+    }
+
+    static const size_t capacities[] = {256, 4096};
+    unsigned capacity_count = options.quick ? 1 : 2;
+
+    for (unsigned f = 0; f < BENCH_FLAVOUR_COUNT; f++)
+    {
+        Bench_Flavour const* flavour = &flavours[f];
+
+        if (options.flavour && strcmp(options.flavour, flavour->name))
+        {
+            continue;
+        }
+
+        if (options.payload && (options.payload != flavour->payload_bytes))
+        {
+            continue;
+        }
+
+        for (unsigned c = 0; c < capacity_count; c++)
+        {
+            // Each multi side is swept over powers of two, leaving room for
+            // the other side within the thread budget.
+            unsigned sides = flavour->multi_producer + flavour->multi_consumer;
+            unsigned limit = (sides == 2)
+                ? (options.max_threads / 2)
+                : (options.max_threads - 1);
+
+            for (unsigned n = 1; n <= (limit ? limit : 1); n *= 2)
+            {
+                unsigned producers = flavour->multi_producer ? n : 1;
+                unsigned consumers = flavour->multi_consumer ? n : 1;
+
+                if (bench(&options, flavour, capacities[c], producers, consumers))
+                {
+                    fprintf(stderr, "%s: failed to make queue\n", flavour->name);
+                    return 1;
+                }
+
+                if (!sides)
+                {
+                    break;
+                }
+            }
+        }
+    }
+
+    if ((options.format == Format_Json) && results_printed)
+    {
+        printf("\n]\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+// Memory for big queues: page aligned (so cache line aligned) memory straight
+// from mmap, optionally on 2 MB pages, bound to a NUMA node and faulted in up
+// front so the first lap round the ring doesn't take a page fault per page.
+//
+// Get the size from make_queue, then:
+//
+//     Queue_Memory memory;
+//
+//     queue_alloc(bytes, node, Queue_Alloc_Huge | Queue_Alloc_Prefault, &memory);
+//     spsc_make_queue_My_Struct(cell_count, memory.bytes, &bytes);
+//     ...
+//     queue_free(&memory);
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_ALLOC_DEFINED)
+
+    #define QUEUE_ALLOC_DEFINED
+
+    #if defined(_WIN32)
+        #error amblaq/alloc.h is not supported on windows
+    #endif
+
+    #include <errno.h>
+    #include <sys/mman.h>
+    #include <unistd.h>
+
+    #if defined(__linux__)
+        #include <sys/syscall.h>
+    #endif
+
+    #if !defined(QUEUE_ALLOC_HUGE_BYTES)
+        #define QUEUE_ALLOC_HUGE_BYTES (2 * 1024 * 1024)
+    #endif
+
+    // Nodes 0 to QUEUE_ALLOC_NODES - 1 can be bound to, or pass
+    // QUEUE_ALLOC_ANY_NODE to leave placement to the kernel.
+    #define QUEUE_ALLOC_NODES    1024
+    #define QUEUE_ALLOC_ANY_NODE -1
+
+    typedef enum Queue_Alloc_Flags
+    {
+        // 2 MB pages if some are reserved (vm.nr_hugepages), otherwise
+        // transparent huge pages are asked for with madvise.
+          Queue_Alloc_Huge      = 1 << 0
+
+        // Reserved 2 MB pages or Queue_Result_Error_System, no fallback.
+        , Queue_Alloc_Huge_Only = 1 << 1
+
+        // Touch every page before returning, after binding to the node.
+        , Queue_Alloc_Prefault  = 1 << 2
+    }
+    Queue_Alloc_Flags;
+
+    typedef enum Queue_Alloc_Pages
+    {
+          Queue_Alloc_Pages_Normal
+        , Queue_Alloc_Pages_Huge
+        , Queue_Alloc_Pages_Transparent // Asked for, up to the kernel.
+    }
+    Queue_Alloc_Pages;
+
+    typedef struct Queue_Memory
+    {
+        void*             bytes;
+        size_t            mapped_bytes;
+        Queue_Alloc_Pages pages;
+    }
+    Queue_Memory;
+
+    static inline void* queue_alloc_map(size_t bytes, int flags)
+    {
+        void* result = mmap
+        (
+              NULL
+            , bytes
+            , PROT_READ | PROT_WRITE
+            , MAP_PRIVATE | MAP_ANONYMOUS | flags
+            , -1
+            , 0
+        );
+
+        return (result == MAP_FAILED) ? NULL : result;
+    }
+
+    // Starts on a huge page boundary, or transparent huge pages can't back the
+    // first and last few MB.
+    static inline void* queue_alloc_map_huge_aligned(size_t bytes)
+    {
+        size_t   padded  = bytes + QUEUE_ALLOC_HUGE_BYTES;
+        uint8_t* mapping = (uint8_t*) queue_alloc_map(padded, 0);
+
+        if (!mapping)
+        {
+            return NULL;
+        }
+
+        uintptr_t start =
+              ((uintptr_t) mapping + QUEUE_ALLOC_HUGE_BYTES - 1)
+            & ~((uintptr_t) QUEUE_ALLOC_HUGE_BYTES - 1);
+
+        size_t before = (size_t) (start - (uintptr_t) mapping);
+        size_t after  = padded - before - bytes;
+
+        if (before)
+        {
+            munmap(mapping, before);
+        }
+
+        if (after)
+        {
+            munmap(mapping + before + bytes, after);
+        }
+
+        return mapping + before;
+    }
+
+    static inline Queue_Result queue_alloc_bind
+    (
+          void*  bytes
+        , size_t count
+        , int    node
+    )
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        unsigned long mask[QUEUE_ALLOC_NODES / (8 * sizeof(unsigned long))] = {0};
+        size_t        bits = 8 * sizeof(unsigned long);
+
+        mask[(size_t) node / bits] = 1UL << ((size_t) node % bits);
+
+        // 2 is MPOL_BIND. numaif.h comes with libnuma, which isn't needed for
+        // one system call.
+        if (syscall(SYS_mbind, bytes, count, 2, mask, QUEUE_ALLOC_NODES + 1, 0))
+        {
+            // A kernel built without NUMA only has node 0.
+            if ((errno == ENOSYS) && !node)
+            {
+                return Queue_Result_Ok;
+            }
+
+            return Queue_Result_Error_System;
+        }
+#else
+        // No mbind, pages land on the node of the thread that first touches
+        // them, so pin the calling thread and use Queue_Alloc_Prefault.
+        (void) bytes;
+        (void) count;
+        (void) node;
+#endif
+
+        return Queue_Result_Ok;
+    }
+
+    static inline Queue_Result queue_alloc
+    (
+          size_t        bytes
+        , int           node
+        , unsigned      flags
+        , Queue_Memory* memory
+    )
+    {
+        memset(memory, 0, sizeof(Queue_Memory));
+
+        if (!bytes)
+        {
+            return Queue_Result_Error_Too_Small;
+        }
+
+        if
+        (
+               (bytes > (SIZE_MAX - (2 * QUEUE_ALLOC_HUGE_BYTES)))
+            || (node >= QUEUE_ALLOC_NODES)
+        )
+        {
+            return Queue_Result_Error_Too_Big;
+        }
+
+        size_t page_bytes = (size_t) sysconf(_SC_PAGESIZE);
+        int    huge       = !!(flags & (Queue_Alloc_Huge | Queue_Alloc_Huge_Only));
+        size_t round      = huge ? QUEUE_ALLOC_HUGE_BYTES : page_bytes;
+        size_t mapped     = (bytes + round - 1) & ~(round - 1);
+
+        Queue_Alloc_Pages pages   = Queue_Alloc_Pages_Normal;
+        void*             mapping = NULL;
+
+        if (huge)
+        {
+#if defined(MAP_HUGETLB)
+            mapping = queue_alloc_map(mapped, MAP_HUGETLB);
+
+            if (mapping)
+            {
+                pages      = Queue_Alloc_Pages_Huge;
+                page_bytes = QUEUE_ALLOC_HUGE_BYTES;
+            }
+#endif
+
+            if (!mapping && (flags & Queue_Alloc_Huge_Only))
+            {
+                return Queue_Result_Error_System;
+            }
+
+            if (!mapping)
+            {
+                mapping = queue_alloc_map_huge_aligned(mapped);
+
+#if defined(MADV_HUGEPAGE)
+                if (mapping && !madvise(mapping, mapped, MADV_HUGEPAGE))
+                {
+                    pages = Queue_Alloc_Pages_Transparent;
+                }
+#endif
+            }
+        }
+        else
+        {
+            mapping = queue_alloc_map(mapped, 0);
+        }
+
+        if (!mapping)
+        {
+            return Queue_Result_Error_System;
+        }
+
+        if (node >= 0)
+        {
+            Queue_Result result = queue_alloc_bind(mapping, mapped, node);
+
+            if (result != Queue_Result_Ok)
+            {
+                munmap(mapping, mapped);
+
+                return result;
+            }
+        }
+
+        if (flags & Queue_Alloc_Prefault)
+        {
+            volatile uint8_t* touch = (volatile uint8_t*) mapping;
+
+            for (size_t i = 0; i < mapped; i += page_bytes)
+            {
+                touch[i] = 0;
+            }
+        }
+
+        memory->bytes        = mapping;
+        memory->mapped_bytes = mapped;
+        memory->pages        = pages;
+
+        return Queue_Result_Ok;
+    }
+
+    static inline void queue_free(Queue_Memory* memory)
+    {
+        if (memory->bytes)
+        {
+            munmap(memory->bytes, memory->mapped_bytes);
+        }
+
+        memset(memory, 0, sizeof(Queue_Memory));
+    }
+#endif
@@ -0,0 +1,512 @@
+// Broadcast ring: one producer, and every subscribed reader sees every item.
+// Items are written once and read in place by all readers, instead of being
+// copied into a queue per reader.
+//
+// Define QUEUE_TYPE and optionally QUEUE_IMPLEMENTATION, then include. Names
+// look like broadcast_try_enqueue_My_Struct.
+//
+// The producer publishes by moving its cursor, like the spsc queue. Each reader
+// has its own cursor, in its own cache line, and the producer may only run
+// capacity items ahead of the slowest active reader. The producer keeps a
+// cached copy of that minimum and only scans the readers again when the cache
+// says the ring is full.
+
+#if !defined(QUEUE_TYPE)
+    #error Please define QUEUE_TYPE
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_BROADCAST_DEFINED)
+
+    #define QUEUE_BROADCAST_DEFINED
+
+    #if !defined(QUEUE_BROADCAST_READERS)
+        #define QUEUE_BROADCAST_READERS 8
+    #endif
+
+    typedef struct Queue_Broadcast_Reader
+    {
+        QUEUE_ATOMIC_SIZE_T cursor;
+        QUEUE_ATOMIC_SIZE_T active;
+
+        // Reader only, its copy of the producer's cursor.
+        size_t              published_cached;
+
+        uint8_t pad[QUEUE_CACHELINE_BYTES - (sizeof(QUEUE_ATOMIC_SIZE_T) * 2)
+                                          - sizeof(size_t)];
+    }
+    Queue_Broadcast_Reader;
+#endif
+
+#define QUEUE_BROADCAST_FN(name)                                               \
+    QUEUE_MERGE(broadcast_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_BROADCAST_STRUCT QUEUE_MERGE(Queue_Broadcast_, QUEUE_TYPE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_BROADCAST_STRUCT QUEUE_BROADCAST_STRUCT;
+
+// Same as make_queue in queues.h.
+Queue_Result QUEUE_BROADCAST_FN(make_queue)
+(
+      size_t                  cell_count
+    , QUEUE_BROADCAST_STRUCT* queue
+    , size_t*                 bytes
+);
+
+// Takes one of the QUEUE_BROADCAST_READERS slots, Queue_Result_Full if they
+// are all in use. A reader sees everything enqueued after it subscribes.
+// Readers can come and go while the queue is in use.
+Queue_Result QUEUE_BROADCAST_FN(subscribe)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t*                 reader
+);
+
+void QUEUE_BROADCAST_FN(unsubscribe)(QUEUE_BROADCAST_STRUCT* queue, size_t reader);
+
+// Full means the slowest reader is a whole ring behind. With no readers items
+// are simply dropped.
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE const*       data
+);
+
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue_bulk)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE const*       data
+    , size_t                  count
+    , size_t*                 written
+);
+
+// Zero copy, one outstanding reserve at a time.
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue_reserve)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE**            data
+);
+
+void QUEUE_BROADCAST_FN(enqueue_commit)(QUEUE_BROADCAST_STRUCT* queue);
+
+// Every reader is single threaded and only reads with its own slot.
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE*             data
+);
+
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue_bulk)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE*             data
+    , size_t                  count
+    , size_t*                 read
+);
+
+// Batch read in place: hands out every item available up to the end of the
+// ring. Release as many of them as have been handled, the producer can't
+// overwrite them until then.
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue_peek)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE const**      data
+    , size_t*                 count
+);
+
+void QUEUE_BROADCAST_FN(dequeue_release)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , size_t                  count
+);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_BROADCAST_STRUCT
+{
+    uint8_t                pad0[QUEUE_CACHELINE_BYTES];
+
+    QUEUE_ATOMIC_SIZE_T    published;
+    uint8_t                pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    // Producer only.
+    size_t                 gating_cached;
+    uint8_t                pad2[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    size_t                 cell_mask;
+    uint8_t                pad3[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    Queue_Broadcast_Reader readers[QUEUE_BROADCAST_READERS];
+
+    QUEUE_TYPE             cells[];
+}
+QUEUE_BROADCAST_STRUCT;
+
+Queue_Result QUEUE_BROADCAST_FN(make_queue)
+(
+      size_t                  cell_count
+    , QUEUE_BROADCAST_STRUCT* queue
+    , size_t*                 bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (cell_count < 2)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if (cell_count > QUEUE_TOO_BIG)
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    if (cell_count & (cell_count - 1))
+    {
+        return Queue_Result_Error_Not_Pow2;
+    }
+
+    size_t bytes_local =
+          sizeof(QUEUE_BROADCAST_STRUCT)
+        + (sizeof(QUEUE_TYPE) * cell_count);
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, bytes_local);
+
+    queue->cell_mask = cell_count - 1;
+
+    QUEUE_ATOMIC_STORE(&queue->published, 0, QUEUE_ORDER_RELAXED);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(subscribe)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t*                 reader
+)
+{
+    for (size_t i = 0; i < QUEUE_BROADCAST_READERS; i++)
+    {
+        Queue_Broadcast_Reader* slot = &queue->readers[i];
+
+        size_t expected = 0;
+
+        if
+        (
+            !QUEUE_ATOMIC_CAS
+            (
+                  &slot->active
+                , &expected
+                , 1
+                , QUEUE_ORDER_SEQ_CST
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            continue;
+        }
+
+        // Read the cursor after the slot is active: either the producer's
+        // scan saw the slot, or it was before this load and can't have run
+        // a lap past what this load returns. Until the store the slot holds
+        // an older cursor, which only makes the producer more careful.
+        size_t published =
+            QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_SEQ_CST);
+
+        slot->published_cached = published;
+
+        QUEUE_ATOMIC_STORE(&slot->cursor, published, QUEUE_ORDER_RELEASE);
+
+        *reader = i;
+
+        return Queue_Result_Ok;
+    }
+
+    return Queue_Result_Full;
+}
+
+void QUEUE_BROADCAST_FN(unsubscribe)(QUEUE_BROADCAST_STRUCT* queue, size_t reader)
+{
+    QUEUE_ATOMIC_STORE(&queue->readers[reader].active, 0, QUEUE_ORDER_RELEASE);
+}
+
+// Returns how many cells after pos the producer can write, up to count.
+static size_t QUEUE_BROADCAST_FN(writable)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  pos
+    , size_t                  count
+)
+{
+    size_t capacity = queue->cell_mask + 1;
+    size_t space    = capacity - (pos - queue->gating_cached);
+
+    if (space >= count)
+    {
+        return count;
+    }
+
+    // Pairs with the seq_cst claim in subscribe.
+    QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+    size_t gating = pos;
+
+    for (size_t i = 0; i < QUEUE_BROADCAST_READERS; i++)
+    {
+        Queue_Broadcast_Reader* slot = &queue->readers[i];
+
+        if (!QUEUE_ATOMIC_LOAD(&slot->active, QUEUE_ORDER_SEQ_CST))
+        {
+            continue;
+        }
+
+        size_t cursor = QUEUE_ATOMIC_LOAD(&slot->cursor, QUEUE_ORDER_ACQUIRE);
+
+        if ((intptr_t) (cursor - gating) < 0)
+        {
+            gating = cursor;
+        }
+    }
+
+    queue->gating_cached = gating;
+
+    // A stale cursor from a reader that is still joining can be over a lap
+    // behind, which counts as full until the reader stores its real one.
+    if ((pos - gating) >= capacity)
+    {
+        return 0;
+    }
+
+    space = capacity - (pos - gating);
+
+    return (space < count) ? space : count;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE const*       data
+)
+{
+    size_t pos = QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_BROADCAST_FN(writable)(queue, pos, 1))
+    {
+        return Queue_Result_Full;
+    }
+
+    queue->cells[pos & queue->cell_mask] = *data;
+
+    QUEUE_ATOMIC_STORE(&queue->published, pos + 1, QUEUE_ORDER_RELEASE);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue_bulk)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE const*       data
+    , size_t                  count
+    , size_t*                 written
+)
+{
+    size_t pos = QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_RELAXED);
+
+    size_t to_write = QUEUE_BROADCAST_FN(writable)(queue, pos, count);
+
+    *written = to_write;
+
+    if (!to_write)
+    {
+        return count ? Queue_Result_Full : Queue_Result_Ok;
+    }
+
+    for (size_t i = 0; i < to_write; i++)
+    {
+        queue->cells[(pos + i) & queue->cell_mask] = data[i];
+    }
+
+    QUEUE_ATOMIC_STORE(&queue->published, pos + to_write, QUEUE_ORDER_RELEASE);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_enqueue_reserve)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , QUEUE_TYPE**            data
+)
+{
+    size_t pos = QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_BROADCAST_FN(writable)(queue, pos, 1))
+    {
+        return Queue_Result_Full;
+    }
+
+    *data = &queue->cells[pos & queue->cell_mask];
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_BROADCAST_FN(enqueue_commit)(QUEUE_BROADCAST_STRUCT* queue)
+{
+    size_t pos = QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&queue->published, pos + 1, QUEUE_ORDER_RELEASE);
+}
+
+// Returns how many items the reader has waiting, refreshing its copy of the
+// producer's cursor only when the copy says there are none.
+static size_t QUEUE_BROADCAST_FN(readable)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , Queue_Broadcast_Reader* slot
+    , size_t                  pos
+)
+{
+    if (pos == slot->published_cached)
+    {
+        slot->published_cached =
+            QUEUE_ATOMIC_LOAD(&queue->published, QUEUE_ORDER_ACQUIRE);
+    }
+
+    return slot->published_cached - pos;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE*             data
+)
+{
+    size_t read;
+
+    return QUEUE_BROADCAST_FN(try_dequeue_bulk)(queue, reader, data, 1, &read);
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue_bulk)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE*             data
+    , size_t                  count
+    , size_t*                 read
+)
+{
+    Queue_Broadcast_Reader* slot = &queue->readers[reader];
+
+    size_t pos = QUEUE_ATOMIC_LOAD(&slot->cursor, QUEUE_ORDER_RELAXED);
+
+    size_t available = QUEUE_BROADCAST_FN(readable)(queue, slot, pos);
+    size_t to_read   = (available < count) ? available : count;
+
+    *read = to_read;
+
+    if (!to_read)
+    {
+        return count ? Queue_Result_Empty : Queue_Result_Ok;
+    }
+
+    for (size_t i = 0; i < to_read; i++)
+    {
+        data[i] = queue->cells[(pos + i) & queue->cell_mask];
+    }
+
+    QUEUE_ATOMIC_STORE(&slot->cursor, pos + to_read, QUEUE_ORDER_RELEASE);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BROADCAST_FN(try_dequeue_peek)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , QUEUE_TYPE const**      data
+    , size_t*                 count
+)
+{
+    Queue_Broadcast_Reader* slot = &queue->readers[reader];
+
+    size_t pos = QUEUE_ATOMIC_LOAD(&slot->cursor, QUEUE_ORDER_RELAXED);
+
+    size_t available = QUEUE_BROADCAST_FN(readable)(queue, slot, pos);
+
+    if (!available)
+    {
+        return Queue_Result_Empty;
+    }
+
+    size_t offset = pos & queue->cell_mask;
+    size_t to_end = (queue->cell_mask + 1) - offset;
+
+    *data  = &queue->cells[offset];
+    *count = (available < to_end) ? available : to_end;
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_BROADCAST_FN(dequeue_release)
+(
+      QUEUE_BROADCAST_STRUCT* queue
+    , size_t                  reader
+    , size_t                  count
+)
+{
+    Queue_Broadcast_Reader* slot = &queue->readers[reader];
+
+    size_t pos = QUEUE_ATOMIC_LOAD(&slot->cursor, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&slot->cursor, pos + count, QUEUE_ORDER_RELEASE);
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_TYPE
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_BROADCAST_FN
+#undef QUEUE_BROADCAST_STRUCT
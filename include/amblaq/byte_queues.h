@@ -0,0 +1,524 @@
+// Variable length records in a byte ring, for items of mixed sizes that would
+// waste most of a typed queue sized for the biggest one.
+//
+// Define QUEUE_MP, QUEUE_MC (only 0 is supported) and optionally
+// QUEUE_IMPLEMENTATION, then include. Names end in _Bytes, eg:
+// mpsc_try_enqueue_reserve_Bytes.
+//
+// Each record is a header and the payload, rounded up to QUEUE_BYTES_ALIGN,
+// and records follow each other around the ring. A record that would run off
+// the end of the ring starts again at 0, behind a padding record that fills up
+// the end. Single producers publish records by moving the enqueue index like
+// the spsc queue. Multiple producers claim space with a compare and swap on the
+// enqueue index and publish each record with its header, so the consumer
+// zeroes records as it frees them, for the next lap's headers to read 0.
+
+#if !defined(QUEUE_MP) || !defined(QUEUE_MC)
+    #error Please define QUEUE_MP and QUEUE_MC
+#endif
+
+#if (QUEUE_MC)
+    #error Byte queues only support a single consumer, QUEUE_MC must be 0
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_BYTES_DEFINED)
+
+    #define QUEUE_BYTES_DEFINED
+
+    // Payloads start at this alignment.
+    #define QUEUE_BYTES_ALIGN 8
+    #define QUEUE_BYTES_MIN   64
+
+    #define QUEUE_BYTES_FREE    0
+    #define QUEUE_BYTES_DATA    1
+    #define QUEUE_BYTES_PADDING 2
+
+    typedef struct Queue_Bytes_Header
+    {
+        QUEUE_ATOMIC_U32 state;
+        uint32_t         length;
+    }
+    Queue_Bytes_Header;
+
+    #define QUEUE_BYTES_RECORD(length)                                         \
+        (                                                                      \
+              (sizeof(Queue_Bytes_Header) + (length) + QUEUE_BYTES_ALIGN - 1)  \
+            & ~((size_t) QUEUE_BYTES_ALIGN - 1)                                \
+        )
+#endif
+
+#if (QUEUE_MP)
+    #define QUEUE_BYTES_FN(name) QUEUE_MERGE(mpsc_, QUEUE_MERGE(name, _Bytes))
+    #define QUEUE_BYTES_STRUCT   Queue_Mpsc_Bytes
+#else
+    #define QUEUE_BYTES_FN(name) QUEUE_MERGE(spsc_, QUEUE_MERGE(name, _Bytes))
+    #define QUEUE_BYTES_STRUCT   Queue_Spsc_Bytes
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_BYTES_STRUCT QUEUE_BYTES_STRUCT;
+
+// capacity is in bytes, a power of 2 and at least QUEUE_BYTES_MIN. Works like
+// make_queue in queues.h: call with a NULL queue to get the bytes needed.
+Queue_Result QUEUE_BYTES_FN(make_queue)
+(
+      size_t              capacity
+    , QUEUE_BYTES_STRUCT* queue
+    , size_t*             bytes
+);
+
+// The longest payload that is guaranteed to fit, half the capacity less the
+// header. Longer ones get Queue_Result_Error_Too_Big.
+size_t QUEUE_BYTES_FN(max_length)(QUEUE_BYTES_STRUCT* queue);
+
+// Zero copy access, as in queues.h. The reserved payload has room for length
+// bytes and is published by enqueue_commit. The single producer version only
+// allows one outstanding reserve at a time. Peek skips padding and gives back
+// the payload and its length, and dequeue_release frees it.
+Queue_Result QUEUE_BYTES_FN(try_enqueue_reserve)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , size_t              length
+    , void**              data
+);
+
+Queue_Result QUEUE_BYTES_FN(enqueue_reserve)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , size_t              length
+    , void**              data
+);
+
+void QUEUE_BYTES_FN(enqueue_commit)(QUEUE_BYTES_STRUCT* queue, void* data);
+
+Queue_Result QUEUE_BYTES_FN(try_dequeue_peek)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void**              data
+    , size_t*             length
+);
+
+void QUEUE_BYTES_FN(dequeue_release)(QUEUE_BYTES_STRUCT* queue, void* data);
+
+// Copying versions. For try_dequeue length is the size of data going in and
+// the length of the record coming out. When data is too small the record is
+// left in the queue, length is set to what is needed and the result is
+// Queue_Result_Error_Bytes_Smaller_Than_Needed.
+Queue_Result QUEUE_BYTES_FN(try_enqueue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void const*         data
+    , size_t              length
+);
+
+Queue_Result QUEUE_BYTES_FN(enqueue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void const*         data
+    , size_t              length
+);
+
+Queue_Result QUEUE_BYTES_FN(try_dequeue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void*               data
+    , size_t*             length
+);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_BYTES_STRUCT
+{
+    uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+    QUEUE_ATOMIC_SIZE_T enqueue_index;
+    uint8_t             pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    QUEUE_ATOMIC_SIZE_T dequeue_index;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    // Single producer only.
+    size_t              dequeue_index_cached;
+    size_t              reserved_end;
+    uint8_t             pad3[QUEUE_CACHELINE_BYTES - (sizeof(size_t) * 2)];
+
+    // Single producer only, the consumer's copy.
+    size_t              enqueue_index_cached;
+    uint8_t             pad4[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    size_t              mask;
+    uint8_t             pad5[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    uint8_t             buffer[];
+}
+QUEUE_BYTES_STRUCT;
+
+Queue_Result QUEUE_BYTES_FN(make_queue)
+(
+      size_t              capacity
+    , QUEUE_BYTES_STRUCT* queue
+    , size_t*             bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (capacity < QUEUE_BYTES_MIN)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if (capacity > QUEUE_TOO_BIG)
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    if (capacity & (capacity - 1))
+    {
+        return Queue_Result_Error_Not_Pow2;
+    }
+
+    size_t bytes_local = sizeof(QUEUE_BYTES_STRUCT) + capacity;
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    // Every header starts out free.
+    memset(queue, 0, bytes_local);
+
+    queue->mask = capacity - 1;
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, 0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, 0, QUEUE_ORDER_RELAXED);
+
+    return Queue_Result_Ok;
+}
+
+size_t QUEUE_BYTES_FN(max_length)(QUEUE_BYTES_STRUCT* queue)
+{
+    return ((queue->mask + 1) / 2) - sizeof(Queue_Bytes_Header);
+}
+
+Queue_Result QUEUE_BYTES_FN(try_enqueue_reserve)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , size_t              length
+    , void**              data
+)
+{
+    if (length > QUEUE_BYTES_FN(max_length)(queue))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t capacity = queue->mask + 1;
+    size_t needed   = QUEUE_BYTES_RECORD(length);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    size_t offset  = pos & queue->mask;
+    size_t padding = ((offset + needed) > capacity) ? (capacity - offset) : 0;
+    size_t end     = pos + padding + needed;
+
+#if (QUEUE_MP)
+    size_t dequeue =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+    // Signed, as pos can be stale and behind the consumer already.
+    if ((intptr_t) (end - dequeue) > (intptr_t) capacity)
+    {
+        return Queue_Result_Full;
+    }
+
+    if
+    (
+        !atomic_compare_exchange_weak_explicit
+        (
+              &queue->enqueue_index
+            , &pos
+            , end
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+    )
+    {
+        return Queue_Result_Contention;
+    }
+#else
+    if ((end - queue->dequeue_index_cached) > capacity)
+    {
+        queue->dequeue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        if ((end - queue->dequeue_index_cached) > capacity)
+        {
+            return Queue_Result_Full;
+        }
+    }
+
+    queue->reserved_end = end;
+#endif
+
+    if (padding)
+    {
+        Queue_Bytes_Header* pad = (Queue_Bytes_Header*) &queue->buffer[offset];
+
+        QUEUE_ATOMIC_STORE_U32
+        (
+              &pad->state
+            , QUEUE_BYTES_PADDING
+            , QUEUE_ORDER_RELEASE
+        );
+
+        offset = 0;
+    }
+
+    Queue_Bytes_Header* header = (Queue_Bytes_Header*) &queue->buffer[offset];
+
+    header->length = (uint32_t) length;
+
+    *data = header + 1;
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BYTES_FN(enqueue_reserve)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , size_t              length
+    , void**              data
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_BYTES_FN(try_enqueue_reserve)(queue, length, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+void QUEUE_BYTES_FN(enqueue_commit)(QUEUE_BYTES_STRUCT* queue, void* data)
+{
+    Queue_Bytes_Header* header = ((Queue_Bytes_Header*) data) - 1;
+
+    QUEUE_ATOMIC_STORE_U32
+    (
+          &header->state
+        , QUEUE_BYTES_DATA
+        , QUEUE_ORDER_RELEASE
+    );
+
+#if !(QUEUE_MP)
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->enqueue_index
+        , queue->reserved_end
+        , QUEUE_ORDER_RELEASE
+    );
+#else
+    (void) queue;
+#endif
+}
+
+Queue_Result QUEUE_BYTES_FN(try_dequeue_peek)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void**              data
+    , size_t*             length
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    for (;;)
+    {
+#if !(QUEUE_MP)
+        if (pos == queue->enqueue_index_cached)
+        {
+            queue->enqueue_index_cached =
+                QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+            if (pos == queue->enqueue_index_cached)
+            {
+                return Queue_Result_Empty;
+            }
+        }
+#endif
+
+        size_t offset = pos & queue->mask;
+
+        Queue_Bytes_Header* header =
+            (Queue_Bytes_Header*) &queue->buffer[offset];
+
+        uint32_t state =
+            QUEUE_ATOMIC_LOAD(&header->state, QUEUE_ORDER_ACQUIRE);
+
+        if (state == QUEUE_BYTES_DATA)
+        {
+            *data   = header + 1;
+            *length = header->length;
+
+            return Queue_Result_Ok;
+        }
+
+        // Nothing committed here yet. Only happens with many producers.
+        if (state != QUEUE_BYTES_PADDING)
+        {
+            return Queue_Result_Empty;
+        }
+
+        size_t padding = (queue->mask + 1) - offset;
+
+#if (QUEUE_MP)
+        memset((void*) header, 0, padding);
+#endif
+
+        pos += padding;
+
+        QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos, QUEUE_ORDER_RELEASE);
+    }
+}
+
+void QUEUE_BYTES_FN(dequeue_release)(QUEUE_BYTES_STRUCT* queue, void* data)
+{
+    Queue_Bytes_Header* header = ((Queue_Bytes_Header*) data) - 1;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    size_t record = QUEUE_BYTES_RECORD(header->length);
+
+#if (QUEUE_MP)
+    memset((void*) header, 0, record);
+#endif
+
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->dequeue_index
+        , pos + record
+        , QUEUE_ORDER_RELEASE
+    );
+}
+
+Queue_Result QUEUE_BYTES_FN(try_enqueue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void const*         data
+    , size_t              length
+)
+{
+    void* payload;
+
+    Queue_Result result =
+        QUEUE_BYTES_FN(try_enqueue_reserve)(queue, length, &payload);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    memcpy(payload, data, length);
+
+    QUEUE_BYTES_FN(enqueue_commit)(queue, payload);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_BYTES_FN(enqueue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void const*         data
+    , size_t              length
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_BYTES_FN(try_enqueue)(queue, data, length);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_BYTES_FN(try_dequeue)
+(
+      QUEUE_BYTES_STRUCT* queue
+    , void*               data
+    , size_t*             length
+)
+{
+    void*  payload;
+    size_t payload_length;
+
+    Queue_Result result =
+        QUEUE_BYTES_FN(try_dequeue_peek)(queue, &payload, &payload_length);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    if (payload_length > *length)
+    {
+        *length = payload_length;
+
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    memcpy(data, payload, payload_length);
+
+    *length = payload_length;
+
+    QUEUE_BYTES_FN(dequeue_release)(queue, payload);
+
+    return Queue_Result_Ok;
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_MP
+#undef QUEUE_MC
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_BYTES_FN
+#undef QUEUE_BYTES_STRUCT
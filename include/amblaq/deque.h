@@ -0,0 +1,233 @@
+// Bounded work stealing deque (Chase-Lev) of pointers. The owning thread
+// pushes and pops at the bottom, any thread can steal from the top, so the
+// owner only races a thief for the last item.
+//
+// Chase and Lev, "Dynamic circular work-stealing deque", with the C11 memory
+// orders from Le, Pop, Cohen and Zappa Nardelli, "Correct and efficient
+// work-stealing for weak memory models". Fixed size, so push returns
+// Queue_Result_Full rather than growing.
+//
+//     queue_deque_make(1024, deque, &bytes);
+//
+//     // owner
+//     queue_deque_push(deque, task);
+//     queue_deque_pop(deque, &task);
+//
+//     // anyone
+//     queue_deque_steal(deque, &task);
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_DEQUE_DEFINED)
+
+    #define QUEUE_DEQUE_DEFINED
+
+    // The items are pointers kept as integers, so a thief can read a cell the
+    // owner is writing, and throw it away when it loses the race for it.
+    typedef struct Queue_Deque
+    {
+        uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+        QUEUE_ATOMIC_SIZE_T top;
+        uint8_t             pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+        QUEUE_ATOMIC_SIZE_T bottom;
+        uint8_t             pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+        size_t              cell_mask;
+        uint8_t             pad3[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+        QUEUE_ATOMIC_SIZE_T cells[];
+    }
+    Queue_Deque;
+
+    // Works like make_queue in queues.h: call with a NULL deque to get the
+    // bytes needed.
+    static inline Queue_Result queue_deque_make
+    (
+          size_t       cell_count
+        , Queue_Deque* deque
+        , size_t*      bytes
+    )
+    {
+        if (!bytes)
+        {
+            return Queue_Result_Error_Null_Bytes;
+        }
+
+        if (cell_count < 2)
+        {
+            return Queue_Result_Error_Too_Small;
+        }
+
+        if (cell_count > QUEUE_TOO_BIG)
+        {
+            return Queue_Result_Error_Too_Big;
+        }
+
+        if (cell_count & (cell_count - 1))
+        {
+            return Queue_Result_Error_Not_Pow2;
+        }
+
+        size_t bytes_local =
+              sizeof(Queue_Deque)
+            + (sizeof(QUEUE_ATOMIC_SIZE_T) * cell_count);
+
+        if (!deque)
+        {
+            *bytes = bytes_local;
+            return Queue_Result_Ok;
+        }
+
+        if (*bytes < bytes_local)
+        {
+            return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+        }
+
+        {
+            intptr_t deque_value = (intptr_t) deque;
+
+            if (deque_value & 0x0F)
+            {
+                return Queue_Result_Error_Not_Aligned_16_Bytes;
+            }
+        }
+
+        memset((void*) deque, 0, bytes_local);
+
+        deque->cell_mask = cell_count - 1;
+
+        QUEUE_ATOMIC_STORE(&deque->top,    0, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_STORE(&deque->bottom, 0, QUEUE_ORDER_RELAXED);
+
+        return Queue_Result_Ok;
+    }
+
+    // Owner only.
+    static inline Queue_Result queue_deque_push(Queue_Deque* deque, void* data)
+    {
+        size_t bottom = QUEUE_ATOMIC_LOAD(&deque->bottom, QUEUE_ORDER_RELAXED);
+        size_t top    = QUEUE_ATOMIC_LOAD(&deque->top,    QUEUE_ORDER_ACQUIRE);
+
+        if ((bottom - top) > deque->cell_mask)
+        {
+            return Queue_Result_Full;
+        }
+
+        QUEUE_ATOMIC_STORE
+        (
+              &deque->cells[bottom & deque->cell_mask]
+            , (size_t) (uintptr_t) data
+            , QUEUE_ORDER_RELAXED
+        );
+
+        // A release store rather than the paper's release fence and relaxed
+        // store. No dearer, and thread sanitizer understands it.
+        QUEUE_ATOMIC_STORE(&deque->bottom, bottom + 1, QUEUE_ORDER_RELEASE);
+
+        return Queue_Result_Ok;
+    }
+
+    // Owner only. Newest first.
+    static inline Queue_Result queue_deque_pop(Queue_Deque* deque, void** data)
+    {
+        size_t bottom =
+            QUEUE_ATOMIC_LOAD(&deque->bottom, QUEUE_ORDER_RELAXED) - 1;
+
+        // Take the bottom item before looking at top, so a thief that reads
+        // bottom after this leaves it alone.
+        QUEUE_ATOMIC_STORE(&deque->bottom, bottom, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+        size_t top = QUEUE_ATOMIC_LOAD(&deque->top, QUEUE_ORDER_RELAXED);
+
+        if ((intptr_t) (bottom - top) < 0)
+        {
+            QUEUE_ATOMIC_STORE(&deque->bottom, bottom + 1, QUEUE_ORDER_RELAXED);
+
+            return Queue_Result_Empty;
+        }
+
+        size_t value = QUEUE_ATOMIC_LOAD
+        (
+              &deque->cells[bottom & deque->cell_mask]
+            , QUEUE_ORDER_RELAXED
+        );
+
+        if (bottom != top)
+        {
+            *data = (void*) (uintptr_t) value;
+
+            return Queue_Result_Ok;
+        }
+
+        // The last one, which a thief could be taking too.
+        Queue_Result result = Queue_Result_Ok;
+
+        if
+        (
+            !QUEUE_ATOMIC_CAS
+            (
+                  &deque->top
+                , &top
+                , top + 1
+                , QUEUE_ORDER_SEQ_CST
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            result = Queue_Result_Empty;
+        }
+
+        QUEUE_ATOMIC_STORE(&deque->bottom, bottom + 1, QUEUE_ORDER_RELAXED);
+
+        if (result == Queue_Result_Ok)
+        {
+            *data = (void*) (uintptr_t) value;
+        }
+
+        return result;
+    }
+
+    // Any thread. Oldest first. Queue_Result_Contention if another thread got
+    // the item first, and there may be more.
+    static inline Queue_Result queue_deque_steal(Queue_Deque* deque, void** data)
+    {
+        size_t top = QUEUE_ATOMIC_LOAD(&deque->top, QUEUE_ORDER_ACQUIRE);
+
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+        size_t bottom = QUEUE_ATOMIC_LOAD(&deque->bottom, QUEUE_ORDER_ACQUIRE);
+
+        if ((intptr_t) (bottom - top) <= 0)
+        {
+            return Queue_Result_Empty;
+        }
+
+        size_t value = QUEUE_ATOMIC_LOAD
+        (
+              &deque->cells[top & deque->cell_mask]
+            , QUEUE_ORDER_RELAXED
+        );
+
+        if
+        (
+            !QUEUE_ATOMIC_CAS
+            (
+                  &deque->top
+                , &top
+                , top + 1
+                , QUEUE_ORDER_SEQ_CST
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            return Queue_Result_Contention;
+        }
+
+        *data = (void*) (uintptr_t) value;
+
+        return Queue_Result_Ok;
+    }
+#endif
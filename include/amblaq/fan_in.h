@@ -0,0 +1,357 @@
+// Fan in: many producers, one consumer, without a shared producer index. Each
+// producer registers for a token, which is its own spsc ring, and the consumer
+// goes round the rings in turn.
+//
+// Built on the spsc queue for the same type, so include amblaq/queues.h with
+// QUEUE_MP 0 and QUEUE_MC 0 for QUEUE_TYPE first (with QUEUE_IMPLEMENTATION
+// somewhere). Then define QUEUE_TYPE, and optionally QUEUE_IMPLEMENTATION, and
+// include this. Names look like fan_in_try_enqueue_My_Struct.
+
+#if !defined(QUEUE_TYPE)
+    #error Please define QUEUE_TYPE
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#define QUEUE_FAN_IN_FN(name)                                                  \
+    QUEUE_MERGE(fan_in_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_FAN_IN_STRUCT QUEUE_MERGE(Queue_Fan_In_, QUEUE_TYPE)
+
+#define QUEUE_FAN_IN_SPSC(name)                                                \
+    QUEUE_MERGE(spsc_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_FAN_IN_RING QUEUE_MERGE(Queue_Spsc_, QUEUE_TYPE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_FAN_IN_STRUCT QUEUE_FAN_IN_STRUCT;
+
+// Room for producer_count producers, each with a ring of cell_count cells. The
+// cell_count rules, and the bytes handshake, are the same as make_queue in
+// queues.h.
+Queue_Result QUEUE_FAN_IN_FN(make_queue)
+(
+      size_t               producer_count
+    , size_t               cell_count
+    , QUEUE_FAN_IN_STRUCT* queue
+    , size_t*              bytes
+);
+
+// Hands out the next ring, Queue_Result_Full once all producer_count are
+// taken. A token must only be used by one thread at a time.
+Queue_Result QUEUE_FAN_IN_FN(register_producer)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t*              token
+);
+
+Queue_Result QUEUE_FAN_IN_FN(try_enqueue)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t               token
+    , QUEUE_TYPE const*    data
+);
+
+Queue_Result QUEUE_FAN_IN_FN(try_enqueue_bulk)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t               token
+    , QUEUE_TYPE const*    data
+    , size_t               count
+    , size_t*              written
+);
+
+// One item from the next ring that has one, starting after the ring the last
+// item came from, so a busy producer can't starve the others. Items from one
+// producer stay in order, there is no order between producers.
+Queue_Result QUEUE_FAN_IN_FN(try_dequeue)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , QUEUE_TYPE*          data
+);
+
+// Same, but takes a batch from each ring in turn until count items are read
+// or every ring has been tried once.
+Queue_Result QUEUE_FAN_IN_FN(try_dequeue_bulk)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , QUEUE_TYPE*          data
+    , size_t               count
+    , size_t*              read
+);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_FAN_IN_STRUCT
+{
+    uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+    QUEUE_ATOMIC_SIZE_T registered;
+    uint8_t             pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    // Consumer only.
+    size_t              next;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    size_t              producer_count;
+    size_t              ring_bytes;
+    uint8_t             pad3[QUEUE_CACHELINE_BYTES - (2 * sizeof(size_t))];
+
+    uint8_t             rings[];
+}
+QUEUE_FAN_IN_STRUCT;
+
+static inline QUEUE_FAN_IN_RING* QUEUE_FAN_IN_FN(ring)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t               index
+)
+{
+    return (QUEUE_FAN_IN_RING*) (void*) &queue->rings[index * queue->ring_bytes];
+}
+
+// Rings are only handed out in order, so only the first few need looking at.
+static inline size_t QUEUE_FAN_IN_FN(ring_count)(QUEUE_FAN_IN_STRUCT* queue)
+{
+    size_t registered =
+        QUEUE_ATOMIC_LOAD(&queue->registered, QUEUE_ORDER_RELAXED);
+
+    return (registered < queue->producer_count)
+        ? registered
+        : queue->producer_count;
+}
+
+Queue_Result QUEUE_FAN_IN_FN(make_queue)
+(
+      size_t               producer_count
+    , size_t               cell_count
+    , QUEUE_FAN_IN_STRUCT* queue
+    , size_t*              bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (!producer_count)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    size_t ring_bytes = 0;
+
+    Queue_Result result =
+        QUEUE_FAN_IN_SPSC(make_queue)(cell_count, NULL, &ring_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    // Keeps every ring on its own cache lines, and 16 byte aligned.
+    ring_bytes =
+          (ring_bytes + QUEUE_CACHELINE_BYTES - 1)
+        & ~((size_t) QUEUE_CACHELINE_BYTES - 1);
+
+    if (producer_count > ((SIZE_MAX - sizeof(QUEUE_FAN_IN_STRUCT)) / ring_bytes))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t bytes_local =
+          sizeof(QUEUE_FAN_IN_STRUCT)
+        + (ring_bytes * producer_count);
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, sizeof(QUEUE_FAN_IN_STRUCT));
+
+    queue->producer_count = producer_count;
+    queue->ring_bytes     = ring_bytes;
+
+    for (size_t i = 0; i < producer_count; i++)
+    {
+        size_t ring_bytes_local = ring_bytes;
+
+        QUEUE_FAN_IN_SPSC(make_queue)
+        (
+              cell_count
+            , QUEUE_FAN_IN_FN(ring)(queue, i)
+            , &ring_bytes_local
+        );
+    }
+
+    QUEUE_ATOMIC_STORE(&queue->registered, 0, QUEUE_ORDER_RELAXED);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FAN_IN_FN(register_producer)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t*              token
+)
+{
+    size_t index =
+        QUEUE_ATOMIC_FETCH_ADD(&queue->registered, 1, QUEUE_ORDER_RELAXED);
+
+    if (index >= queue->producer_count)
+    {
+        return Queue_Result_Full;
+    }
+
+    *token = index;
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FAN_IN_FN(try_enqueue)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t               token
+    , QUEUE_TYPE const*    data
+)
+{
+    return QUEUE_FAN_IN_SPSC(try_enqueue)(QUEUE_FAN_IN_FN(ring)(queue, token), data);
+}
+
+Queue_Result QUEUE_FAN_IN_FN(try_enqueue_bulk)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , size_t               token
+    , QUEUE_TYPE const*    data
+    , size_t               count
+    , size_t*              written
+)
+{
+    return QUEUE_FAN_IN_SPSC(try_enqueue_bulk)
+    (
+          QUEUE_FAN_IN_FN(ring)(queue, token)
+        , data
+        , count
+        , written
+    );
+}
+
+Queue_Result QUEUE_FAN_IN_FN(try_dequeue)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , QUEUE_TYPE*          data
+)
+{
+    size_t ring_count = QUEUE_FAN_IN_FN(ring_count)(queue);
+    size_t index      = queue->next;
+
+    for (size_t i = 0; i < ring_count; i++)
+    {
+        if (index >= ring_count)
+        {
+            index = 0;
+        }
+
+        QUEUE_FAN_IN_RING* ring = QUEUE_FAN_IN_FN(ring)(queue, index);
+
+        index++;
+
+        if (QUEUE_FAN_IN_SPSC(try_dequeue)(ring, data) == Queue_Result_Ok)
+        {
+            queue->next = index;
+
+            return Queue_Result_Ok;
+        }
+    }
+
+    return Queue_Result_Empty;
+}
+
+Queue_Result QUEUE_FAN_IN_FN(try_dequeue_bulk)
+(
+      QUEUE_FAN_IN_STRUCT* queue
+    , QUEUE_TYPE*          data
+    , size_t               count
+    , size_t*              read
+)
+{
+    size_t ring_count = QUEUE_FAN_IN_FN(ring_count)(queue);
+    size_t index      = queue->next;
+    size_t total      = 0;
+
+    for (size_t i = 0; (i < ring_count) && (total < count); i++)
+    {
+        if (index >= ring_count)
+        {
+            index = 0;
+        }
+
+        QUEUE_FAN_IN_RING* ring = QUEUE_FAN_IN_FN(ring)(queue, index);
+
+        index++;
+
+        size_t ring_read = 0;
+
+        QUEUE_FAN_IN_SPSC(try_dequeue_bulk)
+        (
+              ring
+            , &data[total]
+            , count - total
+            , &ring_read
+        );
+
+        if (ring_read)
+        {
+            total      += ring_read;
+            queue->next = index;
+        }
+    }
+
+    *read = total;
+
+    if (!total && count)
+    {
+        return Queue_Result_Empty;
+    }
+
+    return Queue_Result_Ok;
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_TYPE
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_FAN_IN_FN
+#undef QUEUE_FAN_IN_STRUCT
+#undef QUEUE_FAN_IN_SPSC
+#undef QUEUE_FAN_IN_RING
@@ -0,0 +1,343 @@
+// Queues of pointers, where each cell is just the pointer and NULL means the
+// cell is free, rather than a sequence and the item. Twice the cells per cache
+// line, half the memory and one less atomic per operation than queues.h with
+// QUEUE_TYPE void*. NULL itself can't be queued.
+//
+// Define QUEUE_MP, QUEUE_MC and optionally QUEUE_IMPLEMENTATION, then include.
+// Names end in _Pointers, eg: mpsc_try_enqueue_Pointers.
+//
+// A single producer or consumer only looks at the cells: the producer waits
+// for a NULL, the consumer for anything else, which it swaps back to NULL. A
+// free cell doesn't tell multiple producers whether the last lap's producer is
+// done with it, and a full one doesn't tell multiple consumers which lap it is
+// from, so that side also checks the other side's index, which the single side
+// publishes and the multi side keeps a copy of on its own cache line. Both
+// sides at once would need both checks in one step, so there is no mpmc.
+
+#if !defined(QUEUE_MP) || !defined(QUEUE_MC)
+    #error Please define QUEUE_MP and QUEUE_MC
+#endif
+
+#if (QUEUE_MP) && (QUEUE_MC)
+    #error Pointer queues support spsc, mpsc and spmc, not mpmc
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if (QUEUE_MP)
+    #define QUEUE_POINTERS_FN(name) QUEUE_MERGE(mpsc_, QUEUE_MERGE(name, _Pointers))
+    #define QUEUE_POINTERS_STRUCT   Queue_Mpsc_Pointers
+#elif (QUEUE_MC)
+    #define QUEUE_POINTERS_FN(name) QUEUE_MERGE(spmc_, QUEUE_MERGE(name, _Pointers))
+    #define QUEUE_POINTERS_STRUCT   Queue_Spmc_Pointers
+#else
+    #define QUEUE_POINTERS_FN(name) QUEUE_MERGE(spsc_, QUEUE_MERGE(name, _Pointers))
+    #define QUEUE_POINTERS_STRUCT   Queue_Spsc_Pointers
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_POINTERS_STRUCT QUEUE_POINTERS_STRUCT;
+
+// Works like make_queue in queues.h: call with a NULL queue to get the bytes
+// needed.
+Queue_Result QUEUE_POINTERS_FN(make_queue)
+(
+      size_t                 cell_count
+    , QUEUE_POINTERS_STRUCT* queue
+    , size_t*                bytes
+);
+
+// Queue_Result_Error for a NULL data.
+Queue_Result QUEUE_POINTERS_FN(try_enqueue)(QUEUE_POINTERS_STRUCT* queue, void*  data);
+Queue_Result QUEUE_POINTERS_FN(try_dequeue)(QUEUE_POINTERS_STRUCT* queue, void** data);
+Queue_Result QUEUE_POINTERS_FN(enqueue)    (QUEUE_POINTERS_STRUCT* queue, void*  data);
+Queue_Result QUEUE_POINTERS_FN(dequeue)    (QUEUE_POINTERS_STRUCT* queue, void** data);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_POINTERS_STRUCT
+{
+    uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+    // Producers, plus their copy of dequeue_index for mpsc.
+    QUEUE_ATOMIC_SIZE_T enqueue_index;
+    QUEUE_ATOMIC_SIZE_T dequeue_index_cached;
+    uint8_t             pad1[QUEUE_CACHELINE_BYTES - (2 * sizeof(QUEUE_ATOMIC_SIZE_T))];
+
+    // Consumers, plus their copy of enqueue_index for spmc.
+    QUEUE_ATOMIC_SIZE_T dequeue_index;
+    QUEUE_ATOMIC_SIZE_T enqueue_index_cached;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - (2 * sizeof(QUEUE_ATOMIC_SIZE_T))];
+
+    size_t              cell_mask;
+    uint8_t             pad3[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    // The pointers, as integers so the usual atomics work on them.
+    QUEUE_ATOMIC_SIZE_T cells[];
+}
+QUEUE_POINTERS_STRUCT;
+
+Queue_Result QUEUE_POINTERS_FN(make_queue)
+(
+      size_t                 cell_count
+    , QUEUE_POINTERS_STRUCT* queue
+    , size_t*                bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (cell_count < 2)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if (cell_count > QUEUE_TOO_BIG)
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    if (cell_count & (cell_count - 1))
+    {
+        return Queue_Result_Error_Not_Pow2;
+    }
+
+    size_t bytes_local =
+          sizeof(QUEUE_POINTERS_STRUCT)
+        + (sizeof(QUEUE_ATOMIC_SIZE_T) * cell_count);
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, bytes_local);
+
+    queue->cell_mask = cell_count - 1;
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index,        0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index_cached, 0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index,        0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index_cached, 0, QUEUE_ORDER_RELAXED);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_POINTERS_FN(try_enqueue)(QUEUE_POINTERS_STRUCT* queue, void* data)
+{
+    if (!data)
+    {
+        return Queue_Result_Error;
+    }
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_SIZE_T* cell = &queue->cells[pos & queue->cell_mask];
+
+#if (QUEUE_MP)
+    // The cell is only free once the consumer is past it, a NULL could be a
+    // producer from the last lap that claimed it but hasn't written it yet.
+    size_t consumed =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index_cached, QUEUE_ORDER_ACQUIRE);
+
+    if ((pos - consumed) > queue->cell_mask)
+    {
+        consumed =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        QUEUE_ATOMIC_STORE
+        (
+              &queue->dequeue_index_cached
+            , consumed
+            , QUEUE_ORDER_RELEASE
+        );
+
+        intptr_t used = (intptr_t) (pos - consumed);
+
+        if (used < 0)
+        {
+            return Queue_Result_Contention;
+        }
+
+        if ((size_t) used > queue->cell_mask)
+        {
+            return Queue_Result_Full;
+        }
+    }
+
+    if
+    (
+        !atomic_compare_exchange_weak_explicit
+        (
+              &queue->enqueue_index
+            , &pos
+            , pos + 1
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+    )
+    {
+        return Queue_Result_Contention;
+    }
+
+    QUEUE_ATOMIC_STORE(cell, (size_t) (uintptr_t) data, QUEUE_ORDER_RELEASE);
+#else
+    if (QUEUE_ATOMIC_LOAD(cell, QUEUE_ORDER_RELAXED))
+    {
+        return Queue_Result_Full;
+    }
+
+    QUEUE_ATOMIC_STORE(cell, (size_t) (uintptr_t) data, QUEUE_ORDER_RELEASE);
+
+#if (QUEUE_MC)
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+#else
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELAXED);
+#endif
+#endif
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_POINTERS_FN(try_dequeue)(QUEUE_POINTERS_STRUCT* queue, void** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_SIZE_T* cell = &queue->cells[pos & queue->cell_mask];
+
+#if (QUEUE_MC)
+    // The cell only holds this lap's item once the producer is past it, until
+    // then it could still be the last lap's, claimed but not taken yet.
+    size_t produced =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index_cached, QUEUE_ORDER_ACQUIRE);
+
+    if ((intptr_t) (produced - pos) <= 0)
+    {
+        produced =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+        QUEUE_ATOMIC_STORE
+        (
+              &queue->enqueue_index_cached
+            , produced
+            , QUEUE_ORDER_RELEASE
+        );
+
+        if ((intptr_t) (produced - pos) <= 0)
+        {
+            return Queue_Result_Empty;
+        }
+    }
+
+    size_t value = QUEUE_ATOMIC_LOAD(cell, QUEUE_ORDER_ACQUIRE);
+
+    // Taken already, pos is stale.
+    if (!value)
+    {
+        return Queue_Result_Contention;
+    }
+
+    if
+    (
+        !atomic_compare_exchange_weak_explicit
+        (
+              &queue->dequeue_index
+            , &pos
+            , pos + 1
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+    )
+    {
+        return Queue_Result_Contention;
+    }
+
+    QUEUE_ATOMIC_STORE(cell, 0, QUEUE_ORDER_RELAXED);
+#else
+    size_t value = QUEUE_ATOMIC_LOAD(cell, QUEUE_ORDER_ACQUIRE);
+
+    if (!value)
+    {
+        return Queue_Result_Empty;
+    }
+
+    QUEUE_ATOMIC_STORE(cell, 0, QUEUE_ORDER_RELAXED);
+
+#if (QUEUE_MP)
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELEASE);
+#else
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELAXED);
+#endif
+#endif
+
+    *data = (void*) (uintptr_t) value;
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_POINTERS_FN(enqueue)(QUEUE_POINTERS_STRUCT* queue, void* data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_POINTERS_FN(try_enqueue)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_POINTERS_FN(dequeue)(QUEUE_POINTERS_STRUCT* queue, void** data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_POINTERS_FN(try_dequeue)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_MP
+#undef QUEUE_MC
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_POINTERS_FN
+#undef QUEUE_POINTERS_STRUCT
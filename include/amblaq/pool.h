@@ -0,0 +1,376 @@
+// Fixed size pool of slots, for recycling buffers between threads without
+// going through malloc and free. The slots are one cache line aligned block,
+// handed out and taken back through an mpmc queue of slot indices, so any
+// thread can release a slot another thread acquired.
+//
+// Each thread can keep a Queue_Pool_Cache of its own, which holds up to
+// QUEUE_POOL_CACHE indices. Acquire and release then only touch the shared
+// queue to move half a cache's worth at a time, eg:
+//
+//     Queue_Pool_Cache cache = {0};
+//     void*            buffer;
+//
+//     queue_pool_make(1024, sizeof(My_Struct), pool, &bytes);
+//
+//     queue_pool_acquire(pool, &cache, &buffer);
+//     queue_pool_release(pool, &cache, buffer);
+//
+//     // Before the thread is done, or the cached slots are lost to the others.
+//     queue_pool_cache_flush(pool, &cache);
+//
+// Pass a NULL cache to go straight to the shared queue.
+//
+// Define QUEUE_IMPLEMENTATION in one c file before including.
+
+// Kept aside, the queues.h include below would use it up.
+#if defined(QUEUE_IMPLEMENTATION)
+    #define QUEUE_POOL_IMPLEMENTATION
+    #undef QUEUE_IMPLEMENTATION
+#endif
+
+#if !defined(QUEUE_POOL_DEFINED)
+
+#define QUEUE_POOL_DEFINED
+
+#include "queues_common.h"
+
+// The most indices a cache holds, even and at least 2.
+#if !defined(QUEUE_POOL_CACHE)
+    #define QUEUE_POOL_CACHE 32
+#endif
+
+#if (QUEUE_POOL_CACHE < 2) || (QUEUE_POOL_CACHE & 1)
+    #error QUEUE_POOL_CACHE must be even and at least 2
+#endif
+
+// The free slots, a plain mpmc queue of indices.
+typedef size_t Queue_Pool_Index;
+
+#define QUEUE_TYPE Queue_Pool_Index
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#include "queues.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct Queue_Pool Queue_Pool;
+
+// Owned by one thread, zero it before first use.
+typedef struct Queue_Pool_Cache
+{
+    size_t           count;
+    Queue_Pool_Index indices[QUEUE_POOL_CACHE];
+}
+Queue_Pool_Cache;
+
+// slot_count slots of slot_bytes each, rounded up to 16 bytes. Round
+// slot_bytes up to QUEUE_CACHELINE_BYTES yourself if slots used by different
+// threads shouldn't share cache lines. Works like make_queue in queues.h: call
+// with a NULL pool to get the bytes needed, and give it cache line aligned
+// memory for cache line aligned slots. Every slot starts out free.
+Queue_Result queue_pool_make
+(
+      size_t      slot_count
+    , size_t      slot_bytes
+    , Queue_Pool* pool
+    , size_t*     bytes
+);
+
+// Queue_Result_Empty when every slot is in use, or sitting in other threads'
+// caches.
+Queue_Result queue_pool_acquire
+(
+      Queue_Pool*       pool
+    , Queue_Pool_Cache* cache
+    , void**            slot
+);
+
+// Queue_Result_Error if slot isn't one of the pool's.
+Queue_Result queue_pool_release
+(
+      Queue_Pool*       pool
+    , Queue_Pool_Cache* cache
+    , void*             slot
+);
+
+// Gives every slot in cache back to the pool.
+void queue_pool_cache_flush(Queue_Pool* pool, Queue_Pool_Cache* cache);
+
+// -----------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUEUE_POOL_DEFINED
+
+#if defined(QUEUE_POOL_IMPLEMENTATION) && !defined(QUEUE_POOL_IMPLEMENTED)
+
+#define QUEUE_POOL_IMPLEMENTED
+
+#define QUEUE_TYPE Queue_Pool_Index
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_IMPLEMENTATION
+#include "queues.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Followed by the queue of free indices, then the slots, each starting on a
+// cache line.
+typedef struct Queue_Pool
+{
+    uint8_t pad0[QUEUE_CACHELINE_BYTES];
+
+    size_t  slot_count;
+    size_t  slot_bytes;
+    size_t  free_bytes;
+    uint8_t pad1[QUEUE_CACHELINE_BYTES - (3 * sizeof(size_t))];
+
+    uint8_t data[];
+}
+Queue_Pool;
+
+static inline size_t queue_pool_round_up(size_t bytes, size_t to)
+{
+    return (bytes + to - 1) & ~(to - 1);
+}
+
+static inline Queue_Mpmc_Queue_Pool_Index* queue_pool_free(Queue_Pool* pool)
+{
+    return (Queue_Mpmc_Queue_Pool_Index*) (void*) pool->data;
+}
+
+static inline uint8_t* queue_pool_slots(Queue_Pool* pool)
+{
+    return &pool->data[pool->free_bytes];
+}
+
+Queue_Result queue_pool_make
+(
+      size_t      slot_count
+    , size_t      slot_bytes
+    , Queue_Pool* pool
+    , size_t*     bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (!slot_count || !slot_bytes)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if ((slot_count > QUEUE_TOO_BIG) || (slot_bytes > QUEUE_TOO_BIG))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    // Room for every index, so releasing never finds it full.
+    size_t free_cells = 2;
+
+    while (free_cells < slot_count)
+    {
+        free_cells <<= 1;
+    }
+
+    size_t       free_bytes = 0;
+    Queue_Result result     =
+        mpmc_make_queue_Queue_Pool_Index(free_cells, NULL, &free_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    free_bytes = queue_pool_round_up(free_bytes, QUEUE_CACHELINE_BYTES);
+    slot_bytes = queue_pool_round_up(slot_bytes, 16);
+
+    if (slot_count > ((SIZE_MAX - sizeof(Queue_Pool) - free_bytes) / slot_bytes))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t bytes_local =
+          sizeof(Queue_Pool)
+        + free_bytes
+        + (slot_bytes * slot_count);
+
+    if (!pool)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t pool_value = (intptr_t) pool;
+
+        if (pool_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) pool, 0, sizeof(Queue_Pool));
+
+    pool->slot_count = slot_count;
+    pool->slot_bytes = slot_bytes;
+    pool->free_bytes = free_bytes;
+
+    mpmc_make_queue_Queue_Pool_Index(free_cells, queue_pool_free(pool), &free_bytes);
+
+    for (Queue_Pool_Index i = 0; i < slot_count; i++)
+    {
+        mpmc_try_enqueue_Queue_Pool_Index(queue_pool_free(pool), &i);
+    }
+
+    return Queue_Result_Ok;
+}
+
+// The queue always has room, but a consumer still reading a cell keeps it
+// from the next lap for a moment.
+static inline void queue_pool_put
+(
+      Queue_Pool*             pool
+    , Queue_Pool_Index const* indices
+    , size_t                  count
+)
+{
+    while (count)
+    {
+        size_t written = 0;
+
+        mpmc_enqueue_bulk_Queue_Pool_Index
+        (
+              queue_pool_free(pool)
+            , indices
+            , count
+            , &written
+        );
+
+        indices += written;
+        count   -= written;
+    }
+}
+
+Queue_Result queue_pool_acquire
+(
+      Queue_Pool*       pool
+    , Queue_Pool_Cache* cache
+    , void**            slot
+)
+{
+    Queue_Pool_Index index  = 0;
+    Queue_Result     result = Queue_Result_Ok;
+
+    if (!cache)
+    {
+        result = mpmc_dequeue_Queue_Pool_Index(queue_pool_free(pool), &index);
+    }
+    else
+    {
+        if (!cache->count)
+        {
+            result = mpmc_dequeue_bulk_Queue_Pool_Index
+            (
+                  queue_pool_free(pool)
+                , cache->indices
+                , QUEUE_POOL_CACHE / 2
+                , &cache->count
+            );
+        }
+
+        if (result == Queue_Result_Ok)
+        {
+            index = cache->indices[--cache->count];
+        }
+    }
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    *slot = &queue_pool_slots(pool)[index * pool->slot_bytes];
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result queue_pool_release
+(
+      Queue_Pool*       pool
+    , Queue_Pool_Cache* cache
+    , void*             slot
+)
+{
+    uintptr_t slots  = (uintptr_t) queue_pool_slots(pool);
+    uintptr_t at     = (uintptr_t) slot;
+    size_t    offset = (size_t) (at - slots);
+
+    if
+    (
+           (at < slots)
+        || (offset >= (pool->slot_count * pool->slot_bytes))
+        || (offset % pool->slot_bytes)
+    )
+    {
+        return Queue_Result_Error;
+    }
+
+    Queue_Pool_Index index = offset / pool->slot_bytes;
+
+    if (!cache)
+    {
+        queue_pool_put(pool, &index, 1);
+
+        return Queue_Result_Ok;
+    }
+
+    // Keep the newest half, they are the ones still in this core's cache.
+    if (cache->count == QUEUE_POOL_CACHE)
+    {
+        queue_pool_put(pool, cache->indices, QUEUE_POOL_CACHE / 2);
+
+        memmove
+        (
+              cache->indices
+            , &cache->indices[QUEUE_POOL_CACHE / 2]
+            , (QUEUE_POOL_CACHE / 2) * sizeof(Queue_Pool_Index)
+        );
+
+        cache->count = QUEUE_POOL_CACHE / 2;
+    }
+
+    cache->indices[cache->count++] = index;
+
+    return Queue_Result_Ok;
+}
+
+void queue_pool_cache_flush(Queue_Pool* pool, Queue_Pool_Cache* cache)
+{
+    queue_pool_put(pool, cache->indices, cache->count);
+
+    cache->count = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUEUE_POOL_IMPLEMENTATION
+
+#undef QUEUE_POOL_IMPLEMENTATION
@@ -0,0 +1,341 @@
+// Strict priority queue: a fixed number of lanes, each an mpmc ring, and a
+// word with a bit per lane that isn't empty. Dequeue takes from the lowest
+// numbered lane with its bit set, found with one count trailing zeros, so
+// anything in lane 0 overtakes everything in lane 1 and so on. Items keep
+// their order within a lane.
+//
+// Built on the mpmc queue for the same type, so include amblaq/queues.h with
+// QUEUE_MP 1 and QUEUE_MC 1 for QUEUE_TYPE first (with QUEUE_IMPLEMENTATION
+// somewhere). Then define QUEUE_TYPE, and optionally QUEUE_IMPLEMENTATION, and
+// include this. Names look like priority_try_enqueue_My_Struct.
+
+#if !defined(QUEUE_TYPE)
+    #error Please define QUEUE_TYPE
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_PRIORITY_DEFINED)
+
+    #define QUEUE_PRIORITY_DEFINED
+
+    // One bit per lane in a size_t.
+    #define QUEUE_PRIORITY_LANES_MAX (sizeof(size_t) * 8)
+#endif
+
+#define QUEUE_PRIORITY_FN(name)                                                \
+    QUEUE_MERGE(priority_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_PRIORITY_STRUCT QUEUE_MERGE(Queue_Priority_, QUEUE_TYPE)
+
+#define QUEUE_PRIORITY_MPMC(name)                                              \
+    QUEUE_MERGE(mpmc_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_PRIORITY_RING QUEUE_MERGE(Queue_Mpmc_, QUEUE_TYPE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_PRIORITY_STRUCT QUEUE_PRIORITY_STRUCT;
+
+// lane_count lanes, up to QUEUE_PRIORITY_LANES_MAX, each a ring of cell_count
+// cells. The cell_count rules, and the bytes handshake, are the same as
+// make_queue in queues.h.
+Queue_Result QUEUE_PRIORITY_FN(make_queue)
+(
+      size_t                 lane_count
+    , size_t                 cell_count
+    , QUEUE_PRIORITY_STRUCT* queue
+    , size_t*                bytes
+);
+
+// Into lane, 0 being the most urgent. Queue_Result_Full if that lane is full,
+// whatever room the others have. Queue_Result_Error if there is no such lane.
+Queue_Result QUEUE_PRIORITY_FN(try_enqueue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , size_t                 lane
+    , QUEUE_TYPE const*      data
+);
+
+// From the most urgent lane that has something. lane, if not NULL, is set to
+// the lane it came from.
+Queue_Result QUEUE_PRIORITY_FN(try_dequeue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , QUEUE_TYPE*            data
+    , size_t*                lane
+);
+
+// As above, but retrying on Queue_Result_Contention.
+Queue_Result QUEUE_PRIORITY_FN(enqueue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , size_t                 lane
+    , QUEUE_TYPE const*      data
+);
+
+Queue_Result QUEUE_PRIORITY_FN(dequeue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , QUEUE_TYPE*            data
+    , size_t*                lane
+);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_PRIORITY_STRUCT
+{
+    uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+    // Bit n set if lane n may have something in it. Only ever clear when the
+    // lane was seen empty after clearing it, see try_dequeue.
+    QUEUE_ATOMIC_SIZE_T ready;
+    uint8_t             pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    size_t              lane_count;
+    size_t              ring_bytes;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - (2 * sizeof(size_t))];
+
+    uint8_t             rings[];
+}
+QUEUE_PRIORITY_STRUCT;
+
+static inline QUEUE_PRIORITY_RING* QUEUE_PRIORITY_FN(ring)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , size_t                 lane
+)
+{
+    return (QUEUE_PRIORITY_RING*) (void*) &queue->rings[lane * queue->ring_bytes];
+}
+
+Queue_Result QUEUE_PRIORITY_FN(make_queue)
+(
+      size_t                 lane_count
+    , size_t                 cell_count
+    , QUEUE_PRIORITY_STRUCT* queue
+    , size_t*                bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (!lane_count)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if (lane_count > QUEUE_PRIORITY_LANES_MAX)
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t ring_bytes = 0;
+
+    Queue_Result result =
+        QUEUE_PRIORITY_MPMC(make_queue)(cell_count, NULL, &ring_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    // Each ring starts on its own cache line.
+    ring_bytes =
+          (ring_bytes + QUEUE_CACHELINE_BYTES - 1)
+        & ~((size_t) QUEUE_CACHELINE_BYTES - 1);
+
+    if (lane_count > ((SIZE_MAX - sizeof(QUEUE_PRIORITY_STRUCT)) / ring_bytes))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t bytes_local = sizeof(QUEUE_PRIORITY_STRUCT) + (lane_count * ring_bytes);
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, sizeof(QUEUE_PRIORITY_STRUCT));
+
+    queue->lane_count = lane_count;
+    queue->ring_bytes = ring_bytes;
+
+    QUEUE_ATOMIC_STORE(&queue->ready, 0, QUEUE_ORDER_RELAXED);
+
+    for (size_t i = 0; i < lane_count; i++)
+    {
+        size_t ring_bytes_local = ring_bytes;
+
+        QUEUE_PRIORITY_MPMC(make_queue)
+        (
+              cell_count
+            , QUEUE_PRIORITY_FN(ring)(queue, i)
+            , &ring_bytes_local
+        );
+    }
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_PRIORITY_FN(try_enqueue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , size_t                 lane
+    , QUEUE_TYPE const*      data
+)
+{
+    if (lane >= queue->lane_count)
+    {
+        return Queue_Result_Error;
+    }
+
+    Queue_Result result = QUEUE_PRIORITY_MPMC(try_enqueue)
+    (
+          QUEUE_PRIORITY_FN(ring)(queue, lane)
+        , data
+    );
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    // The item before the bit, pairing with the fence in try_dequeue, so
+    // either this sees the bit cleared or the consumer sees the item. Only
+    // the first item into an empty lane pays for the fetch_or.
+    size_t bit = (size_t) 1 << lane;
+
+    QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+    if (!(QUEUE_ATOMIC_LOAD(&queue->ready, QUEUE_ORDER_RELAXED) & bit))
+    {
+        QUEUE_ATOMIC_FETCH_OR(&queue->ready, bit, QUEUE_ORDER_RELEASE);
+    }
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_PRIORITY_FN(try_dequeue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , QUEUE_TYPE*            data
+    , size_t*                lane
+)
+{
+    size_t ready = QUEUE_ATOMIC_LOAD(&queue->ready, QUEUE_ORDER_ACQUIRE);
+
+    while (ready)
+    {
+        size_t at  = QUEUE_CTZ(ready);
+        size_t bit = (size_t) 1 << at;
+
+        QUEUE_PRIORITY_RING* ring   = QUEUE_PRIORITY_FN(ring)(queue, at);
+        Queue_Result         result = QUEUE_PRIORITY_MPMC(try_dequeue)(ring, data);
+
+        if (result == Queue_Result_Empty)
+        {
+            // Clear it, then look again, so an item that went in as it was
+            // cleared sets it again or is found here.
+            QUEUE_ATOMIC_FETCH_AND(&queue->ready, ~bit, QUEUE_ORDER_RELAXED);
+            QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+            result = QUEUE_PRIORITY_MPMC(try_dequeue)(ring, data);
+
+            if (result != Queue_Result_Empty)
+            {
+                QUEUE_ATOMIC_FETCH_OR(&queue->ready, bit, QUEUE_ORDER_RELAXED);
+            }
+        }
+
+        if (result != Queue_Result_Empty)
+        {
+            if ((result == Queue_Result_Ok) && lane)
+            {
+                *lane = at;
+            }
+
+            return result;
+        }
+
+        ready &= ~bit;
+    }
+
+    return Queue_Result_Empty;
+}
+
+Queue_Result QUEUE_PRIORITY_FN(enqueue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , size_t                 lane
+    , QUEUE_TYPE const*      data
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_PRIORITY_FN(try_enqueue)(queue, lane, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_PRIORITY_FN(dequeue)
+(
+      QUEUE_PRIORITY_STRUCT* queue
+    , QUEUE_TYPE*            data
+    , size_t*                lane
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_PRIORITY_FN(try_dequeue)(queue, data, lane);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_TYPE
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_PRIORITY_FN
+#undef QUEUE_PRIORITY_STRUCT
+#undef QUEUE_PRIORITY_MPMC
+#undef QUEUE_PRIORITY_RING
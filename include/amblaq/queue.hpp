@@ -0,0 +1,566 @@
+// C++17 front end for the queues in queues.h.
+//
+// Same algorithms as queues.h: a head/tail ring for single producer, single
+// consumer, and the per cell sequence ring from
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// for everything else. Elements are constructed in place and moved out, so
+// non trivial types do not need to be boxed.
+
+#ifndef AMBLAQ_QUEUE_HPP
+#define AMBLAQ_QUEUE_HPP
+
+#if (__cplusplus < 201703L) && (!defined(_MSVC_LANG) || (_MSVC_LANG < 201703L))
+    #error C++17 is required for amblaq/queue.hpp
+#endif
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace amblaq
+{
+
+// -----------------------------------------------------------------------------
+
+enum class access
+{
+      single
+    , multi
+};
+
+enum class result
+{
+      ok
+    , full
+    , empty
+    , contention
+};
+
+inline constexpr std::size_t dynamic = 0;
+
+#if defined(QUEUE_CACHELINE_BYTES)
+    inline constexpr std::size_t cacheline_bytes = QUEUE_CACHELINE_BYTES;
+#else
+    inline constexpr std::size_t cacheline_bytes = 64;
+#endif
+
+inline constexpr std::size_t too_big = 1024ULL * 1024ULL * 256ULL;
+
+// -----------------------------------------------------------------------------
+
+namespace detail
+{
+    // Index owned by one side. Only atomic if that side has many threads.
+    template <access Side>
+    using index = std::conditional_t
+    <
+          Side == access::multi
+        , std::atomic<std::size_t>
+        , std::size_t
+    >;
+
+    template <access Side>
+    std::size_t load(index<Side> const& i)
+    {
+        if constexpr (Side == access::multi)
+        {
+            return i.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            return i;
+        }
+    }
+
+    // Replaces QUEUE_P_IF_CAS / QUEUE_C_IF_CAS.
+    template <access Side>
+    bool claim(index<Side>& i, std::size_t pos, std::size_t next)
+    {
+        if constexpr (Side == access::multi)
+        {
+            return i.compare_exchange_weak
+            (
+                  pos
+                , next
+                , std::memory_order_relaxed
+                , std::memory_order_relaxed
+            );
+        }
+        else
+        {
+            i = next;
+            return true;
+        }
+    }
+
+    template <typename T>
+    struct storage
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+
+        T* get()
+        {
+            return std::launder(reinterpret_cast<T*>(bytes));
+        }
+    };
+
+    template <typename T, bool Sequenced>
+    struct cell
+    {
+        std::atomic<std::size_t> sequence;
+        storage<T>               data;
+    };
+
+    template <typename T>
+    struct cell<T, false>
+    {
+        storage<T>               data;
+    };
+
+    template <typename Cell, std::size_t Capacity>
+    struct cells
+    {
+        static_assert(Capacity >= 2,                   "capacity too small");
+        static_assert(!(Capacity & (Capacity - 1)),    "capacity must be pow2");
+        static_assert(Capacity <= too_big,             "capacity too big");
+
+        explicit cells(std::size_t) {}
+
+        static constexpr std::size_t mask()     { return Capacity - 1; }
+        Cell&         operator[](std::size_t i) { return items[i]; }
+
+        Cell items[Capacity];
+    };
+
+    template <typename Cell>
+    struct cells<Cell, dynamic>
+    {
+        explicit cells(std::size_t capacity)
+            : cell_mask(capacity - 1)
+        {
+            if (capacity < 2)
+            {
+                throw std::invalid_argument("amblaq::queue: capacity too small");
+            }
+
+            if (capacity > too_big)
+            {
+                throw std::invalid_argument("amblaq::queue: capacity too big");
+            }
+
+            if (capacity & (capacity - 1))
+            {
+                throw std::invalid_argument("amblaq::queue: capacity not pow2");
+            }
+
+            items.reset(new Cell[capacity]);
+        }
+
+        std::size_t   mask() const              { return cell_mask; }
+        Cell&         operator[](std::size_t i) { return items[i]; }
+
+        std::size_t             cell_mask;
+        std::unique_ptr<Cell[]> items;
+    };
+}
+
+// -----------------------------------------------------------------------------
+
+template
+<
+      typename    T
+    , access      Producers
+    , access      Consumers
+    , std::size_t Capacity = dynamic
+>
+class queue
+{
+    static_assert
+    (
+          std::is_nothrow_move_constructible_v<T>
+        , "amblaq::queue needs a noexcept move constructor"
+    );
+
+    static_assert
+    (
+          std::is_nothrow_destructible_v<T>
+        , "amblaq::queue needs a noexcept destructor"
+    );
+
+    static constexpr bool spsc =
+           (Producers == access::single)
+        && (Consumers == access::single);
+
+    using cell_type = detail::cell<T, !spsc>;
+
+    // The spsc indices are shared with the other side, so always atomic.
+    using enqueue_index_type = std::conditional_t
+    <
+          spsc
+        , std::atomic<std::size_t>
+        , detail::index<Producers>
+    >;
+
+    using dequeue_index_type = std::conditional_t
+    <
+          spsc
+        , std::atomic<std::size_t>
+        , detail::index<Consumers>
+    >;
+
+public:
+    using value_type = T;
+
+    static constexpr access producers = Producers;
+    static constexpr access consumers = Consumers;
+
+    // Capacity must be a power of 2. Only pass a capacity for dynamic queues.
+    template <std::size_t C = Capacity, std::enable_if_t<C != dynamic, int> = 0>
+    queue()
+        : queue(make{}, Capacity)
+    {
+    }
+
+    template <std::size_t C = Capacity, std::enable_if_t<C == dynamic, int> = 0>
+    explicit queue(std::size_t capacity)
+        : queue(make{}, capacity)
+    {
+    }
+
+    queue(queue const&)            = delete;
+    queue& operator=(queue const&) = delete;
+
+    // Destroys whatever is still in the queue. Must not race with any other
+    // call on the queue.
+    ~queue()
+    {
+        std::size_t pos = load_dequeue();
+        std::size_t end = load_enqueue();
+
+        for (; pos != end; pos++)
+        {
+            cell_type& cell = items[pos & items.mask()];
+
+            if constexpr (!spsc)
+            {
+                std::size_t sequence =
+                    cell.sequence.load(std::memory_order_acquire);
+
+                if (sequence != pos + 1)
+                {
+                    continue;
+                }
+            }
+
+            cell.data.get()->~T();
+        }
+    }
+
+    std::size_t capacity() const
+    {
+        return items.mask() + 1;
+    }
+
+    // -------------------------------------------------------------------------
+
+    // Constructs the element in place. If that could throw it is constructed
+    // first and then moved in, so the queue is never left half written.
+    template <typename... Args>
+    result try_emplace(Args&&... args)
+    {
+        if constexpr (std::is_nothrow_constructible_v<T, Args...>)
+        {
+            return try_enqueue([&](void* p)
+            {
+                ::new (p) T(std::forward<Args>(args)...);
+            });
+        }
+        else
+        {
+            T item(std::forward<Args>(args)...);
+
+            return try_push(std::move(item));
+        }
+    }
+
+    result try_push(T&& item)
+    {
+        return try_enqueue([&](void* p)
+        {
+            ::new (p) T(std::move(item));
+        });
+    }
+
+    result try_push(T const& item)
+    {
+        return try_emplace(item);
+    }
+
+    // Moves the oldest element into item. If the move assignment throws the
+    // element is still removed from the queue.
+    result try_pop(T& item)
+    {
+        return try_dequeue([&](T& stored)
+        {
+            item = std::move(stored);
+        });
+    }
+
+    // -------------------------------------------------------------------------
+    // Same as the try_ versions, but retry while other threads are in the way.
+
+    // A throwing constructor runs once up front, forwarding args again on
+    // each retry would construct from already moved from values.
+    template <typename... Args>
+    result emplace(Args&&... args)
+    {
+        if constexpr (std::is_nothrow_constructible_v<T, Args...>)
+        {
+            return retry([&]
+            {
+                return try_emplace(std::forward<Args>(args)...);
+            });
+        }
+        else
+        {
+            T item(std::forward<Args>(args)...);
+
+            return retry([&] { return try_push(std::move(item)); });
+        }
+    }
+
+    result push(T&& item)
+    {
+        return retry([&] { return try_push(std::move(item)); });
+    }
+
+    result push(T const& item)
+    {
+        return retry([&] { return try_push(item); });
+    }
+
+    result pop(T& item)
+    {
+        return retry([&] { return try_pop(item); });
+    }
+
+private:
+    struct make {};
+
+    queue(make, std::size_t capacity)
+        : items(capacity)
+    {
+        if constexpr (!spsc)
+        {
+            for (std::size_t i = 0; i <= items.mask(); i++)
+            {
+                items[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        enqueue_index        = 0;
+        dequeue_index        = 0;
+        dequeue_index_cached = 0;
+        enqueue_index_cached = 0;
+    }
+
+    template <typename F>
+    static result retry(F&& f)
+    {
+        result r;
+
+        do
+        {
+            r = f();
+        }
+        while (r == result::contention);
+
+        return r;
+    }
+
+    std::size_t load_enqueue() const
+    {
+        if constexpr (spsc)
+        {
+            return enqueue_index.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            return detail::load<Producers>(enqueue_index);
+        }
+    }
+
+    std::size_t load_dequeue() const
+    {
+        if constexpr (spsc)
+        {
+            return dequeue_index.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            return detail::load<Consumers>(dequeue_index);
+        }
+    }
+
+    template <typename Construct>
+    result try_enqueue(Construct&& construct)
+    {
+        if constexpr (spsc)
+        {
+            std::size_t pos = enqueue_index.load(std::memory_order_relaxed);
+
+            if ((pos - dequeue_index_cached) > items.mask())
+            {
+                dequeue_index_cached =
+                    dequeue_index.load(std::memory_order_acquire);
+
+                if ((pos - dequeue_index_cached) > items.mask())
+                {
+                    return result::full;
+                }
+            }
+
+            construct(items[pos & items.mask()].data.bytes);
+
+            enqueue_index.store(pos + 1, std::memory_order_release);
+
+            return result::ok;
+        }
+        else
+        {
+            std::size_t pos = detail::load<Producers>(enqueue_index);
+
+            cell_type& cell = items[pos & items.mask()];
+
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+
+            std::intptr_t difference =
+                (std::intptr_t) sequence - (std::intptr_t) pos;
+
+            if (!difference)
+            {
+                if (detail::claim<Producers>(enqueue_index, pos, pos + 1))
+                {
+                    construct(cell.data.bytes);
+
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+
+                    return result::ok;
+                }
+            }
+
+            if (difference < 0)
+            {
+                return result::full;
+            }
+
+            return result::contention;
+        }
+    }
+
+    // Destroys the element and frees the cell even if consume throws.
+    struct release
+    {
+        queue*      self;
+        cell_type*  cell;
+        std::size_t pos;
+
+        ~release()
+        {
+            cell->data.get()->~T();
+
+            if constexpr (spsc)
+            {
+                self->dequeue_index.store(pos + 1, std::memory_order_release);
+            }
+            else
+            {
+                cell->sequence.store
+                (
+                      pos + self->items.mask() + 1
+                    , std::memory_order_release
+                );
+            }
+        }
+    };
+
+    template <typename Consume>
+    result try_dequeue(Consume&& consume)
+    {
+        if constexpr (spsc)
+        {
+            std::size_t pos = dequeue_index.load(std::memory_order_relaxed);
+
+            if (pos == enqueue_index_cached)
+            {
+                enqueue_index_cached =
+                    enqueue_index.load(std::memory_order_acquire);
+
+                if (pos == enqueue_index_cached)
+                {
+                    return result::empty;
+                }
+            }
+
+            cell_type& cell = items[pos & items.mask()];
+
+            release guard{this, &cell, pos};
+
+            consume(*cell.data.get());
+
+            return result::ok;
+        }
+        else
+        {
+            std::size_t pos = detail::load<Consumers>(dequeue_index);
+
+            cell_type& cell = items[pos & items.mask()];
+
+            std::size_t sequence =
+                cell.sequence.load(std::memory_order_acquire);
+
+            std::intptr_t difference =
+                (std::intptr_t) sequence - (std::intptr_t) (pos + 1);
+
+            if (!difference)
+            {
+                if (detail::claim<Consumers>(dequeue_index, pos, pos + 1))
+                {
+                    release guard{this, &cell, pos};
+
+                    consume(*cell.data.get());
+
+                    return result::ok;
+                }
+            }
+
+            if (difference < 0)
+            {
+                return result::empty;
+            }
+
+            return result::contention;
+        }
+    }
+
+    // -------------------------------------------------------------------------
+
+    alignas(cacheline_bytes) enqueue_index_type enqueue_index;
+    alignas(cacheline_bytes) dequeue_index_type dequeue_index;
+
+    // spsc only: each side's copy of the other side's index.
+    alignas(cacheline_bytes) std::size_t        dequeue_index_cached;
+    alignas(cacheline_bytes) std::size_t        enqueue_index_cached;
+
+    alignas(cacheline_bytes) detail::cells<cell_type, Capacity> items;
+};
+
+}
+
+#endif // AMBLAQ_QUEUE_HPP
@@ -10,272 +10,3196 @@
 
 // -----------------------------------------------------------------------------
 
-#if !defined(QUEUE_COMMON_DEFINED)
+#include "queues_common.h"
 
-    #define QUEUE_COMMON_DEFINED
+// -----------------------------------------------------------------------------
+// QUEUE_ERASED: the usual names, as inline wrappers over the one copy of the
+// code per flavour in amblaq/queues_any.h.
+// -----------------------------------------------------------------------------
 
-    #if !defined(__cplusplus)
+#if defined(QUEUE_ERASED)
 
-        #if !defined(__STDC__)
-            #error Standard C is required for the C version of this file
-        #endif
+#include "queues_any.h"
+
+#else
 
-        #if (__STDC_VERSION__ < 201112L)
-            #error C11 is required for the C version of this file
-        #endif
+// -----------------------------------------------------------------------------
+// Waiting: an eventcount per side of the queue. Waiters register themselves,
+// re-check the queue, then park on a futex. Notifiers only pay for a fence and
+// a load unless somebody is registered.
+// -----------------------------------------------------------------------------
 
-        #include <stdatomic.h>
+// Queue sets (QUEUE_SELECT) park on the same eventcount.
+#if (defined(QUEUE_WAIT) || defined(QUEUE_SELECT)) && !defined(QUEUE_WAIT_DEFINED)
 
-        #if defined(__STDC_NO_ATOMICS__)
-            #error Oh no, your C compiler does not support C11 atomics :-(
-        #endif
+    #define QUEUE_WAIT_DEFINED
 
-        #define QUEUE_ATOMIC_SIZE_T atomic_size_t
-        #define QUEUE_ORDER_RELAXED memory_order_relaxed
-        #define QUEUE_ORDER_RELEASE memory_order_release
-        #define QUEUE_ORDER_ACQUIRE memory_order_acquire
-        #define QUEUE_ATOMIC_STORE  atomic_store_explicit
-        #define QUEUE_ATOMIC_LOAD   atomic_load_explicit
+    #if defined(_WIN32)
+        #error QUEUE_WAIT and QUEUE_SELECT are not supported on windows
+    #endif
 
-    #else
-        #if (__cplusplus < 201103L)
-            #error C++11 is required for the C++ version of this file
-        #endif
+    // On linux with a strict C standard this needs _DEFAULT_SOURCE (or
+    // _GNU_SOURCE) defined before any system header is included.
+    #include <limits.h>
+    #include <sched.h>
+    #include <time.h>
 
-        #include <atomic>
+    #if defined(__linux__)
+        #include <linux/futex.h>
+        #include <sys/syscall.h>
+        #include <unistd.h>
+    #endif
 
-        #define QUEUE_ATOMIC_SIZE_T std::atomic_size_t
-        #define QUEUE_ORDER_RELAXED std::memory_order_relaxed
-        #define QUEUE_ORDER_RELEASE std::memory_order_release
-        #define QUEUE_ORDER_ACQUIRE std::memory_order_acquire
-        #define QUEUE_ATOMIC_STORE  std::atomic_store_explicit<size_t>
-        #define QUEUE_ATOMIC_LOAD   std::atomic_load_explicit
+    #if !defined(QUEUE_WAIT_SPINS)
+        #define QUEUE_WAIT_SPINS 128
+    #endif
 
+    #if !defined(QUEUE_WAIT_YIELDS)
+        #define QUEUE_WAIT_YIELDS 16
     #endif
 
-    #define QUEUE_MERGE_BASE(a, b) a ## b
-    #define QUEUE_MERGE(a, b)      QUEUE_MERGE_BASE(a, b)
+    #define QUEUE_WAIT_FOREVER UINT64_MAX
+
+    typedef struct Queue_Event
+    {
+        QUEUE_ATOMIC_U32 epoch;
+        QUEUE_ATOMIC_U32 waiters;
+    }
+    Queue_Event;
+
+    typedef struct Queue_Wait
+    {
+        unsigned spins;
+        uint64_t deadline;
+    }
+    Queue_Wait;
+
+    typedef enum Queue_Wait_Step
+    {
+          Queue_Wait_Step_Retry
+        , Queue_Wait_Step_Park
+        , Queue_Wait_Step_Timeout
+    }
+    Queue_Wait_Step;
+
+    static inline uint64_t queue_wait_now(void)
+    {
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        return ((uint64_t) now.tv_sec * 1000000000ULL) + (uint64_t) now.tv_nsec;
+    }
+
+    static inline void queue_wait_start(Queue_Wait* wait, uint64_t timeout_ns)
+    {
+        wait->spins    = 0;
+        wait->deadline = QUEUE_WAIT_FOREVER;
+
+        if (timeout_ns != QUEUE_WAIT_FOREVER)
+        {
+            uint64_t now = queue_wait_now();
+
+            if (timeout_ns < (QUEUE_WAIT_FOREVER - now))
+            {
+                wait->deadline = now + timeout_ns;
+            }
+        }
+    }
+
+    static inline Queue_Wait_Step queue_wait_backoff(Queue_Wait* wait)
+    {
+        if (wait->spins < QUEUE_WAIT_SPINS)
+        {
+            wait->spins++;
+            QUEUE_PAUSE();
+
+            return Queue_Wait_Step_Retry;
+        }
+
+        if
+        (
+               (wait->deadline != QUEUE_WAIT_FOREVER)
+            && (queue_wait_now() >= wait->deadline)
+        )
+        {
+            return Queue_Wait_Step_Timeout;
+        }
+
+        if (wait->spins < (QUEUE_WAIT_SPINS + QUEUE_WAIT_YIELDS))
+        {
+            wait->spins++;
+            sched_yield();
+
+            return Queue_Wait_Step_Retry;
+        }
+
+        return Queue_Wait_Step_Park;
+    }
+
+    // The fence pairs with the one before the notify, see
+    // QUEUE_SIGNAL_NOT_EMPTY: either the notify sees the waiter, or the
+    // waiter's re-check of the queue, which is a plain load, sees the item.
+    static inline uint32_t queue_event_prepare(Queue_Event* event)
+    {
+        QUEUE_ATOMIC_FETCH_ADD(&event->waiters, 1, QUEUE_ORDER_SEQ_CST);
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+        return QUEUE_ATOMIC_LOAD(&event->epoch, QUEUE_ORDER_SEQ_CST);
+    }
+
+    static inline void queue_event_cancel(Queue_Event* event)
+    {
+        QUEUE_ATOMIC_FETCH_SUB(&event->waiters, 1, QUEUE_ORDER_RELAXED);
+    }
+
+    static inline void queue_event_park
+    (
+          Queue_Event* event
+        , uint32_t     epoch
+        , Queue_Wait*  wait
+    )
+    {
+        struct timespec  timeout;
+        struct timespec* timeout_pointer = NULL;
+
+        if (wait->deadline != QUEUE_WAIT_FOREVER)
+        {
+            uint64_t now = queue_wait_now();
+
+            if (now >= wait->deadline)
+            {
+                return;
+            }
+
+            timeout.tv_sec  = (time_t) ((wait->deadline - now) / 1000000000ULL);
+            timeout.tv_nsec = (long)   ((wait->deadline - now) % 1000000000ULL);
+            timeout_pointer = &timeout;
+        }
+
+    #if defined(__linux__)
+        // Not FUTEX_PRIVATE_FLAG, so queues in shared memory work too.
+        syscall
+        (
+              SYS_futex
+            , (void*) &event->epoch
+            , FUTEX_WAIT
+            , epoch
+            , timeout_pointer
+            , NULL
+            , 0
+        );
+    #else
+        // No futex: poll the epoch with a short sleep.
+        struct timespec nap = {0, 50000};
+
+        (void) timeout_pointer;
 
-    #if !defined(QUEUE_CACHELINE_BYTES)
-        #define QUEUE_CACHELINE_BYTES 64
+        while (QUEUE_ATOMIC_LOAD(&event->epoch, QUEUE_ORDER_ACQUIRE) == epoch)
+        {
+            if
+            (
+                   (wait->deadline != QUEUE_WAIT_FOREVER)
+                && (queue_wait_now() >= wait->deadline)
+            )
+            {
+                break;
+            }
+
+            nanosleep(&nap, NULL);
+        }
     #endif
+    }
+
+    static inline void queue_event_wake(Queue_Event* event)
+    {
+        QUEUE_ATOMIC_FETCH_ADD(&event->epoch, 1, QUEUE_ORDER_RELEASE);
 
-    #if !defined(QUEUE_TOO_BIG)
-        #define QUEUE_TOO_BIG (1024ULL * 1024ULL * 256ULL)
+    #if defined(__linux__)
+        syscall
+        (
+              SYS_futex
+            , (void*) &event->epoch
+            , FUTEX_WAKE
+            , INT_MAX
+            , NULL
+            , NULL
+            , 0
+        );
     #endif
+    }
 
-    typedef enum Queue_Result
+    // Runs after every successful enqueue and dequeue of a QUEUE_WAIT queue,
+    // behind a seq_cst fence, so the fence is paid per item whether anyone
+    // waits or not: an mfence or locked instruction on x86, a dmb ish on arm.
+    // That is the price of QUEUE_WAIT, queues without it don't pay it.
+    // Without the fence the waiters load could be satisfied before the item
+    // is visible and a sleeper would miss it.
+    static inline void queue_event_notify_after_fence(Queue_Event* event)
     {
-          Queue_Result_Ok
-        , Queue_Result_Full
-        , Queue_Result_Empty
-        , Queue_Result_Contention
+        if (QUEUE_ATOMIC_LOAD(&event->waiters, QUEUE_ORDER_RELAXED))
+        {
+            queue_event_wake(event);
+        }
+    }
 
-        , Queue_Result_Error = 128
-        , Queue_Result_Error_Too_Small
-        , Queue_Result_Error_Too_Big
-        , Queue_Result_Error_Not_Pow2
-        , Queue_Result_Error_Not_Aligned_16_Bytes
-        , Queue_Result_Error_Null_Bytes
-        , Queue_Result_Error_Bytes_Smaller_Than_Needed
+    static inline void queue_event_notify(Queue_Event* event)
+    {
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+        queue_event_notify_after_fence(event);
     }
-    Queue_Result;
 #endif
+
+// -----------------------------------------------------------------------------
+// Notify: an eventfd per side of the queue, for event loops. A side arms its
+// notifier before it goes back to epoll, and only the first signal after that
+// writes to the eventfd, so a busy queue doesn't cost a syscall per item.
 // -----------------------------------------------------------------------------
 
-#if (QUEUE_MP)
-    #define QUEUE_P_NAME_FN        mp
-    #define QUEUE_P_NAME_TYPE      Mp
-    #define QUEUE_P_TYPE           QUEUE_ATOMIC_SIZE_T
-    #define QUEUE_P_SETUP(a, b, c) QUEUE_ATOMIC_STORE(&a, b, c)
-    #define QUEUE_P_LOAD(a, b)     QUEUE_ATOMIC_LOAD (&a, b)
+#if defined(QUEUE_NOTIFY) && !defined(QUEUE_NOTIFY_DEFINED)
 
-    #define QUEUE_P_IF_CAS(a, b, c, d, e)                                      \
-        if                                                                     \
-        (                                                                      \
-            atomic_compare_exchange_weak_explicit                              \
-            (                                                                  \
-                  &a                                                           \
-                , &b                                                           \
-                , c                                                            \
-                , d                                                            \
-                , e                                                            \
-            )                                                                  \
-        )
-#else
-    #define QUEUE_P_NAME_FN               sp
-    #define QUEUE_P_NAME_TYPE             Sp
-    #define QUEUE_P_TYPE                  size_t
-    #define QUEUE_P_SETUP(a, b, c)
-    #define QUEUE_P_LOAD(a, b)            a
-    #define QUEUE_P_IF_CAS(a, b, c, d, e) a = c;
-#endif
+    #define QUEUE_NOTIFY_DEFINED
 
-#if (QUEUE_MC)
-    #define QUEUE_C_NAME           mc
-    #define QUEUE_C_TYPE           QUEUE_ATOMIC_SIZE_T
-    #define QUEUE_C_SETUP(a, b, c) QUEUE_ATOMIC_STORE(&a, b, c)
-    #define QUEUE_C_LOAD(a, b)     QUEUE_ATOMIC_LOAD (&a, b)
+    #if !defined(__linux__)
+        #error QUEUE_NOTIFY needs eventfd, so is linux only
+    #endif
 
-    #define QUEUE_C_IF_CAS(a, b, c, d, e)                                      \
-        if                                                                     \
-        (                                                                      \
-            atomic_compare_exchange_weak_explicit                              \
-            (                                                                  \
-                  &a                                                           \
-                , &b                                                           \
-                , c                                                            \
-                , d                                                            \
-                , e                                                            \
-            )                                                                  \
-        )
-#else
-    #define QUEUE_C_NAME                  sc
-    #define QUEUE_C_TYPE                  size_t
-    #define QUEUE_C_SETUP(a, b, c)
-    #define QUEUE_C_LOAD(a, b)            a
-    #define QUEUE_C_IF_CAS(a, b, c, d, e) a = c;
-#endif
+    #include <sys/eventfd.h>
+    #include <errno.h>
+    #include <unistd.h>
 
-#define QUEUE_FN_A     QUEUE_MERGE(QUEUE_P_NAME_FN, QUEUE_C_NAME)
-#define QUEUE_FN_B     QUEUE_MERGE(QUEUE_FN_A, _)
-#define QUEUE_FN(name) QUEUE_MERGE(QUEUE_MERGE(QUEUE_FN_B, name##_), QUEUE_TYPE)
+    typedef enum Queue_Notify
+    {
+          Queue_Notify_Not_Empty
+        , Queue_Notify_Not_Full
+    }
+    Queue_Notify;
 
-#define QUEUE_STRUCT_A QUEUE_MERGE(QUEUE_P_NAME_TYPE, QUEUE_C_NAME)
-#define QUEUE_STRUCT_B QUEUE_MERGE(QUEUE_STRUCT_A, _)
-#define QUEUE_STRUCT_C QUEUE_MERGE(QUEUE_STRUCT_B, QUEUE_TYPE)
-#define QUEUE_STRUCT   QUEUE_MERGE(Queue_, QUEUE_STRUCT_C)
-#define QUEUE_CELL     QUEUE_MERGE(Cell_, QUEUE_STRUCT_C)
+    typedef struct Queue_Notifier
+    {
+        QUEUE_ATOMIC_U32 armed;
+        int              fd;
+    }
+    Queue_Notifier;
 
-// -----------------------------------------------------------------------------
+    static inline Queue_Result queue_notifier_open(Queue_Notifier* notifier)
+    {
+        notifier->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
-#ifdef __cplusplus
-extern "C" {
-#endif
+        if (notifier->fd < 0)
+        {
+            return Queue_Result_Error_System;
+        }
 
-// -----------------------------------------------------------------------------
+        // Armed to start with, so the first item wakes an idle loop.
+        QUEUE_ATOMIC_STORE_U32(&notifier->armed, 1, QUEUE_ORDER_RELAXED);
 
-typedef struct QUEUE_STRUCT QUEUE_STRUCT;
+        return Queue_Result_Ok;
+    }
 
-Queue_Result QUEUE_FN(make_queue)
-(
-      size_t        cell_count
-    , QUEUE_STRUCT* queue
-    , size_t*       bytes
-);
+    static inline void queue_notifier_close(Queue_Notifier* notifier)
+    {
+        if (notifier->fd >= 0)
+        {
+            close(notifier->fd);
+        }
 
-Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data);
-Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE*       data);
-Queue_Result QUEUE_FN(enqueue)    (QUEUE_STRUCT* queue, QUEUE_TYPE const* data);
-Queue_Result QUEUE_FN(dequeue)    (QUEUE_STRUCT* queue, QUEUE_TYPE*       data);
+        notifier->fd = -1;
+    }
+
+    // The fence pairs with the one before the signal, see
+    // QUEUE_SIGNAL_NOT_EMPTY: either the signalling side sees the flag, or
+    // the re-check after arming sees whatever it published.
+    static inline void queue_notifier_arm(Queue_Notifier* notifier)
+    {
+        QUEUE_ATOMIC_STORE_U32(&notifier->armed, 1, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+    }
+
+    static inline Queue_Result queue_notifier_clear(Queue_Notifier* notifier)
+    {
+        uint64_t value;
+
+        for (;;)
+        {
+            if (read(notifier->fd, &value, sizeof(value)) >= 0)
+            {
+                return Queue_Result_Ok;
+            }
+
+            if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+            {
+                // Nothing was signalled.
+                return Queue_Result_Ok;
+            }
+
+            if (errno != EINTR)
+            {
+                return Queue_Result_Error_System;
+            }
+        }
+    }
+
+    static inline void queue_notifier_signal_after_fence
+    (
+        Queue_Notifier* notifier
+    )
+    {
+        if (!QUEUE_ATOMIC_LOAD(&notifier->armed, QUEUE_ORDER_RELAXED))
+        {
+            return;
+        }
+
+        uint32_t armed = 1;
+
+        if
+        (
+            QUEUE_ATOMIC_CAS
+            (
+                  &notifier->armed
+                , &armed
+                , 0
+                , QUEUE_ORDER_RELAXED
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            uint64_t one = 1;
+
+            // Nothing to do about a failure from inside an enqueue. EAGAIN
+            // means the counter is full, so the fd is readable anyway, and
+            // EBADF only happens after notify_close.
+            ssize_t written = write(notifier->fd, &one, sizeof(one));
+
+            (void) written;
+        }
+    }
+#endif
 
+// -----------------------------------------------------------------------------
+// Select: one consumer waiting on many queues. Each queue in a set has a bit,
+// which its producers set when they publish an item, and the consumer parks on
+// the set's eventcount until some bit is set. Producers only pay for a fence
+// and a load while their bit is still set from the last item.
 // -----------------------------------------------------------------------------
 
-#if defined(QUEUE_IMPLEMENTATION)
+#if defined(QUEUE_SELECT) && !defined(QUEUE_SELECT_DEFINED)
 
-#undef QUEUE_IMPLEMENTATION
+    #define QUEUE_SELECT_DEFINED
 
-typedef struct QUEUE_CELL
-{
-    QUEUE_ATOMIC_SIZE_T sequence;
-    QUEUE_TYPE          data;
-}
-QUEUE_CELL;
+    #define QUEUE_SET_MAX 64
 
-typedef struct QUEUE_STRUCT
-{
-    uint8_t        pad0[QUEUE_CACHELINE_BYTES];
+    typedef struct Queue_Set
+    {
+        uint8_t          pad0[QUEUE_CACHELINE_BYTES];
 
-    QUEUE_P_TYPE   enqueue_index;
-    uint8_t        pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_P_TYPE)];
+        // Written by the producers of every queue in the set.
+        QUEUE_ATOMIC_U64 ready;
+        Queue_Event      event;
+        uint8_t          pad1[QUEUE_CACHELINE_BYTES - (2 * sizeof(uint64_t))];
 
-    QUEUE_C_TYPE   dequeue_index;
-    uint8_t        pad3[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_C_TYPE)];
+        // Consumer only.
+        uint64_t         used;
+        uint8_t          pad2[QUEUE_CACHELINE_BYTES - sizeof(uint64_t)];
+    }
+    Queue_Set;
 
-    size_t         cell_mask;
-    uint8_t        pad4[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+    // In each queue, the set it belongs to (0 for none) and its bit there.
+    typedef struct Queue_Set_Link
+    {
+        QUEUE_ATOMIC_SIZE_T set;
+        uint64_t            bit;
+    }
+    Queue_Set_Link;
 
-    QUEUE_CELL     cells[];
-}
-QUEUE_STRUCT;
+    static inline void queue_set_init(Queue_Set* set)
+    {
+        memset((void*) set, 0, sizeof(Queue_Set));
 
-Queue_Result QUEUE_FN(make_queue)
-(
-      size_t        cell_count
-    , QUEUE_STRUCT* queue
-    , size_t*       bytes
-)
-{
-    if (!bytes)
+        QUEUE_ATOMIC_STORE_U64(&set->ready, 0, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_STORE_U32(&set->event.epoch,   0, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_STORE_U32(&set->event.waiters, 0, QUEUE_ORDER_RELAXED);
+    }
+
+    // Sets bits as ready, eg for queues the consumer stopped draining before
+    // they were empty. The fence pairs with the exchange in queue_set_poll:
+    // either the consumer sees the bits, or this sees them still set from
+    // before, and the consumer's drain after the exchange sees the item.
+    static inline void queue_set_mark_after_fence(Queue_Set* set, uint64_t bits)
     {
-        return Queue_Result_Error_Null_Bytes;
+        uint64_t ready = QUEUE_ATOMIC_LOAD(&set->ready, QUEUE_ORDER_RELAXED);
+
+        if ((ready & bits) == bits)
+        {
+            return;
+        }
+
+        QUEUE_ATOMIC_FETCH_OR(&set->ready, bits, QUEUE_ORDER_SEQ_CST);
+
+        if (QUEUE_ATOMIC_LOAD(&set->event.waiters, QUEUE_ORDER_SEQ_CST))
+        {
+            queue_event_wake(&set->event);
+        }
     }
 
-    if (cell_count < 2)
+    static inline void queue_set_mark(Queue_Set* set, uint64_t bits)
     {
-        return Queue_Result_Error_Too_Small;
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+        queue_set_mark_after_fence(set, bits);
     }
 
-    if (cell_count > QUEUE_TOO_BIG)
+    static inline void queue_set_signal_after_fence(Queue_Set_Link* link)
     {
-        return Queue_Result_Error_Too_Big;
+        size_t set = QUEUE_ATOMIC_LOAD(&link->set, QUEUE_ORDER_ACQUIRE);
+
+        if (set)
+        {
+            queue_set_mark_after_fence((Queue_Set*) (uintptr_t) set, link->bit);
+        }
     }
 
-    if (cell_count & (cell_count - 1))
+    // Consumer only. index is the queue's bit in the ready mask. Starts out
+    // ready, in case the queue already has items. Queue_Result_Error if the
+    // queue is in a set already, Queue_Result_Error_Too_Big if this one has
+    // QUEUE_SET_MAX queues.
+    static inline Queue_Result queue_set_add
+    (
+          Queue_Set*      set
+        , Queue_Set_Link* link
+        , unsigned*       index
+    )
     {
-        return Queue_Result_Error_Not_Pow2;
+        if (QUEUE_ATOMIC_LOAD(&link->set, QUEUE_ORDER_RELAXED))
+        {
+            return Queue_Result_Error;
+        }
+
+        if (set->used == UINT64_MAX)
+        {
+            return Queue_Result_Error_Too_Big;
+        }
+
+        unsigned free_index = 0;
+
+        while (set->used & (1ULL << free_index))
+        {
+            free_index++;
+        }
+
+        set->used |= 1ULL << free_index;
+        *index     = free_index;
+        link->bit  = 1ULL << free_index;
+
+        QUEUE_ATOMIC_STORE
+        (
+              &link->set
+            , (size_t) (uintptr_t) set
+            , QUEUE_ORDER_RELEASE
+        );
+
+        queue_set_mark(set, link->bit);
+
+        return Queue_Result_Ok;
+    }
+
+    // Consumer only. Producers still in the middle of an enqueue can set the
+    // bit once more afterwards, so a reused bit can be ready with nothing in
+    // its queue.
+    static inline void queue_set_remove(Queue_Set* set, Queue_Set_Link* link)
+    {
+        size_t set_value = QUEUE_ATOMIC_LOAD(&link->set, QUEUE_ORDER_RELAXED);
+
+        if (set_value != (size_t) (uintptr_t) set)
+        {
+            return;
+        }
+
+        QUEUE_ATOMIC_STORE(&link->set, 0, QUEUE_ORDER_RELAXED);
+
+        set->used &= ~link->bit;
+    }
+
+    // Consumer only. Takes the ready bits, 0 if none. Each queue whose bit is
+    // returned has to be drained until empty, or marked again, as its bit is
+    // only set by the next enqueue.
+    static inline uint64_t queue_set_poll(Queue_Set* set)
+    {
+        if (!QUEUE_ATOMIC_LOAD(&set->ready, QUEUE_ORDER_RELAXED))
+        {
+            return 0;
+        }
+
+        uint64_t ready =
+            QUEUE_ATOMIC_EXCHANGE(&set->ready, 0, QUEUE_ORDER_SEQ_CST);
+
+        QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+        return ready;
+    }
+
+    // Consumer only. Like queue_set_poll, but spins, yields, then sleeps
+    // until a bit is set. Queue_Result_Timeout after timeout_ns nanoseconds,
+    // QUEUE_WAIT_FOREVER for no limit.
+    static inline Queue_Result queue_set_wait
+    (
+          Queue_Set* set
+        , uint64_t   timeout_ns
+        , uint64_t*  ready
+    )
+    {
+        Queue_Wait wait;
+
+        queue_wait_start(&wait, timeout_ns);
+
+        for (;;)
+        {
+            *ready = queue_set_poll(set);
+
+            if (*ready)
+            {
+                return Queue_Result_Ok;
+            }
+
+            Queue_Wait_Step step = queue_wait_backoff(&wait);
+
+            if (step == Queue_Wait_Step_Timeout)
+            {
+                return Queue_Result_Timeout;
+            }
+
+            if (step == Queue_Wait_Step_Park)
+            {
+                uint32_t epoch = queue_event_prepare(&set->event);
+
+                *ready =
+                    QUEUE_ATOMIC_EXCHANGE(&set->ready, 0, QUEUE_ORDER_SEQ_CST);
+
+                if (!*ready)
+                {
+                    queue_event_park(&set->event, epoch, &wait);
+                }
+
+                queue_event_cancel(&set->event);
+
+                if (*ready)
+                {
+                    QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST);
+
+                    return Queue_Result_Ok;
+                }
+            }
+        }
+    }
+#endif
+
+// -----------------------------------------------------------------------------
+// Stats: relaxed counters kept per side of the queue, so producers and
+// consumers only ever write their own cache line.
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_STATS) && !defined(QUEUE_STATS_DEFINED)
+
+    #define QUEUE_STATS_DEFINED
+
+    typedef struct Queue_Stats_Counters
+    {
+        QUEUE_ATOMIC_U64 ok;
+        QUEUE_ATOMIC_U64 blocked; // Full for producers, Empty for consumers.
+        QUEUE_ATOMIC_U64 contention;
+        QUEUE_ATOMIC_U64 retries;
+        QUEUE_ATOMIC_U64 peak;
+    }
+    Queue_Stats_Counters;
+
+    // ok counts items, the rest count calls. retries counts failed CAS or
+    // skipped tickets. peak_occupancy is the most items seen in the queue.
+    typedef struct Queue_Stats
+    {
+        uint64_t enqueue_ok;
+        uint64_t enqueue_full;
+        uint64_t enqueue_contention;
+        uint64_t enqueue_retries;
+
+        uint64_t dequeue_ok;
+        uint64_t dequeue_empty;
+        uint64_t dequeue_contention;
+        uint64_t dequeue_retries;
+
+        uint64_t peak_occupancy;
+    }
+    Queue_Stats;
+
+    // Counters written by many threads need an atomic add, counters owned by
+    // a single thread get away with a load and a store.
+    static inline void queue_stats_add_shared(QUEUE_ATOMIC_U64* counter, uint64_t n)
+    {
+        QUEUE_ATOMIC_FETCH_ADD(counter, n, QUEUE_ORDER_RELAXED);
+    }
+
+    static inline void queue_stats_add_owned(QUEUE_ATOMIC_U64* counter, uint64_t n)
+    {
+        uint64_t value = QUEUE_ATOMIC_LOAD(counter, QUEUE_ORDER_RELAXED);
+
+        QUEUE_ATOMIC_STORE_U64(counter, value + n, QUEUE_ORDER_RELAXED);
+    }
+
+    static inline uint64_t queue_stats_load(QUEUE_ATOMIC_U64* counter)
+    {
+        return QUEUE_ATOMIC_LOAD(counter, QUEUE_ORDER_RELAXED);
+    }
+
+    static inline void queue_stats_peak
+    (
+          QUEUE_ATOMIC_U64* peak
+        , intptr_t          occupancy
+        , size_t            cell_count
+    )
+    {
+        // Racing index loads can give nonsense, so clamp to what is possible.
+        if (occupancy <= 0)
+        {
+            return;
+        }
+
+        uint64_t value = ((size_t) occupancy < cell_count)
+            ? (uint64_t) occupancy
+            : (uint64_t) cell_count;
+
+        uint64_t current = QUEUE_ATOMIC_LOAD(peak, QUEUE_ORDER_RELAXED);
+
+        while (value > current)
+        {
+            if
+            (
+                QUEUE_ATOMIC_CAS
+                (
+                      peak
+                    , &current
+                    , value
+                    , QUEUE_ORDER_RELAXED
+                    , QUEUE_ORDER_RELAXED
+                )
+            )
+            {
+                break;
+            }
+        }
+    }
+#endif
+
+// -----------------------------------------------------------------------------
+// Shared memory: the queue struct holds no pointers, so it works from a
+// mapping shared between processes, at a different address in each. A header
+// in front of the queue describes it, so attaching to a queue of another
+// flavour, type or layout fails instead of corrupting it.
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_SHM) && !defined(QUEUE_SHM_DEFINED)
+
+    #define QUEUE_SHM_DEFINED
+
+    #if defined(_WIN32)
+        #error QUEUE_SHM is not supported on windows
+    #endif
+
+    // Atomics that are not lock free hide a lock in the process, where the
+    // other process can't see it. Lock free atomics are also address free.
+    #if    (ATOMIC_INT_LOCK_FREE   != 2)                                       \
+        || (ATOMIC_LONG_LOCK_FREE  != 2)                                       \
+        || (ATOMIC_LLONG_LOCK_FREE != 2)
+        #error QUEUE_SHM needs lock free atomics
+    #endif
+
+    #include <errno.h>
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+
+    #define QUEUE_SHM_MAGIC   0x51414c424d41ULL // "AMBLAQ"
+    #define QUEUE_SHM_VERSION 1
+
+    typedef struct Queue_Shm_Header
+    {
+        uint64_t            magic;
+        uint32_t            version;
+        uint32_t            flavour;
+        uint64_t            type_size;
+        uint64_t            cell_count;
+        uint64_t            bytes; // The whole mapping, header included.
+        QUEUE_ATOMIC_SIZE_T ready;
+    }
+    Queue_Shm_Header;
+
+    // A whole number of cache lines, so the queue stays aligned.
+    #define QUEUE_SHM_HEADER_BYTES                                             \
+        (                                                                      \
+              (sizeof(Queue_Shm_Header) + QUEUE_CACHELINE_BYTES - 1)           \
+            & ~((size_t) QUEUE_CACHELINE_BYTES - 1)                            \
+        )
+
+    static inline Queue_Result queue_shm_map
+    (
+          int    fd
+        , size_t bytes
+        , void** mapping
+    )
+    {
+        void* result =
+            mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (result == MAP_FAILED)
+        {
+            return Queue_Result_Error_System;
+        }
+
+        *mapping = result;
+
+        return Queue_Result_Ok;
+    }
+
+    // Maps a queue that has been created, the caller checks the header.
+    static inline Queue_Result queue_shm_map_existing
+    (
+          int                fd
+        , Queue_Shm_Header** header
+        , size_t*            bytes
+    )
+    {
+        struct stat info;
+
+        if (fstat(fd, &info) != 0)
+        {
+            return Queue_Result_Error_System;
+        }
+
+        if ((size_t) info.st_size < QUEUE_SHM_HEADER_BYTES)
+        {
+            return Queue_Result_Error_Not_Ready;
+        }
+
+        void* mapping;
+
+        Queue_Result result =
+            queue_shm_map(fd, (size_t) info.st_size, &mapping);
+
+        if (result != Queue_Result_Ok)
+        {
+            return result;
+        }
+
+        Queue_Shm_Header* mapped = (Queue_Shm_Header*) mapping;
+
+        if (!QUEUE_ATOMIC_LOAD(&mapped->ready, QUEUE_ORDER_ACQUIRE))
+        {
+            munmap(mapping, (size_t) info.st_size);
+
+            return Queue_Result_Error_Not_Ready;
+        }
+
+        *header = mapped;
+        *bytes  = (size_t) info.st_size;
+
+        return Queue_Result_Ok;
+    }
+#endif
+
+// -----------------------------------------------------------------------------
+
+#if (QUEUE_MP)
+    #define QUEUE_P_NAME_FN        mp
+    #define QUEUE_P_NAME_TYPE      Mp
+    #define QUEUE_P_TYPE           QUEUE_ATOMIC_SIZE_T
+    #define QUEUE_P_SETUP(a, b, c) QUEUE_ATOMIC_STORE(&a, b, c)
+    #define QUEUE_P_LOAD(a, b)     QUEUE_ATOMIC_LOAD (&a, b)
+
+    #define QUEUE_P_IF_CAS(a, b, c, d, e)                                      \
+        if                                                                     \
+        (                                                                      \
+            atomic_compare_exchange_weak_explicit                              \
+            (                                                                  \
+                  &a                                                           \
+                , &b                                                           \
+                , c                                                            \
+                , d                                                            \
+                , e                                                            \
+            )                                                                  \
+        )
+#else
+    #define QUEUE_P_NAME_FN               sp
+    #define QUEUE_P_NAME_TYPE             Sp
+    #define QUEUE_P_IF_CAS(a, b, c, d, e) a = c;
+
+    // Lapped consumers read the producer's index to find the oldest item.
+    #if defined(QUEUE_OVERWRITE)
+        #define QUEUE_P_TYPE           QUEUE_ATOMIC_SIZE_T
+        #define QUEUE_P_SETUP(a, b, c) QUEUE_ATOMIC_STORE(&a, b, c)
+        #define QUEUE_P_LOAD(a, b)     QUEUE_ATOMIC_LOAD (&a, b)
+    #else
+        #define QUEUE_P_TYPE           size_t
+        #define QUEUE_P_SETUP(a, b, c)
+        #define QUEUE_P_LOAD(a, b)     a
+    #endif
+#endif
+
+#if (QUEUE_MC)
+    #define QUEUE_C_NAME           mc
+    #define QUEUE_C_TYPE           QUEUE_ATOMIC_SIZE_T
+    #define QUEUE_C_SETUP(a, b, c) QUEUE_ATOMIC_STORE(&a, b, c)
+    #define QUEUE_C_LOAD(a, b)     QUEUE_ATOMIC_LOAD (&a, b)
+
+    #define QUEUE_C_IF_CAS(a, b, c, d, e)                                      \
+        if                                                                     \
+        (                                                                      \
+            atomic_compare_exchange_weak_explicit                              \
+            (                                                                  \
+                  &a                                                           \
+                , &b                                                           \
+                , c                                                            \
+                , d                                                            \
+                , e                                                            \
+            )                                                                  \
+        )
+#else
+    #define QUEUE_C_NAME                  sc
+    #define QUEUE_C_TYPE                  size_t
+    #define QUEUE_C_SETUP(a, b, c)
+    #define QUEUE_C_LOAD(a, b)            a
+    #define QUEUE_C_IF_CAS(a, b, c, d, e) a = c;
+#endif
+
+// The overwrite mode needs the per cell sequence, so spsc uses it too.
+#if defined(QUEUE_OVERWRITE)
+    #if (QUEUE_MP)
+        #error QUEUE_OVERWRITE needs a single producer, set QUEUE_MP to 0
+    #endif
+
+    #define QUEUE_SPSC 0
+#else
+    #define QUEUE_SPSC (!(QUEUE_MP) && !(QUEUE_MC))
+#endif
+
+#if defined(QUEUE_MPMC_ENGINE_FAA)
+    #if !(QUEUE_MP) || !(QUEUE_MC)
+        #error QUEUE_MPMC_ENGINE_FAA needs QUEUE_MP and QUEUE_MC set to 1
+    #endif
+
+    #define QUEUE_FAA 1
+
+    // How many tickets consumers can set aside at once, see faa_park.
+    #define QUEUE_FAA_PARKED 3
+#else
+    #define QUEUE_FAA 0
+#endif
+
+// QUEUE_CAPACITY must be a literal number as it becomes part of the names,
+// eg: spsc_try_enqueue_My_Struct_256.
+#if defined(QUEUE_CAPACITY)
+    #if (QUEUE_CAPACITY < 2) || (QUEUE_CAPACITY & (QUEUE_CAPACITY - 1))
+        #error QUEUE_CAPACITY must be a power of 2, and at least 2
+    #endif
+
+    #if (QUEUE_CAPACITY > QUEUE_TOO_BIG)
+        #error QUEUE_CAPACITY is bigger than QUEUE_TOO_BIG
+    #endif
+
+    #define QUEUE_NAME QUEUE_MERGE(QUEUE_MERGE(QUEUE_TYPE, _), QUEUE_CAPACITY)
+#else
+    #define QUEUE_NAME QUEUE_TYPE
+#endif
+
+#define QUEUE_FN_A     QUEUE_MERGE(QUEUE_P_NAME_FN, QUEUE_C_NAME)
+#define QUEUE_FN_B     QUEUE_MERGE(QUEUE_FN_A, _)
+#define QUEUE_FN(name) QUEUE_MERGE(QUEUE_MERGE(QUEUE_FN_B, name##_), QUEUE_NAME)
+
+#define QUEUE_STRUCT_A QUEUE_MERGE(QUEUE_P_NAME_TYPE, QUEUE_C_NAME)
+#define QUEUE_STRUCT_B QUEUE_MERGE(QUEUE_STRUCT_A, _)
+#define QUEUE_STRUCT_C QUEUE_MERGE(QUEUE_STRUCT_B, QUEUE_NAME)
+#define QUEUE_STRUCT   QUEUE_MERGE(Queue_, QUEUE_STRUCT_C)
+#define QUEUE_CELL     QUEUE_MERGE(Cell_, QUEUE_STRUCT_C)
+
+#if defined(QUEUE_CAPACITY)
+    #define QUEUE_CELL_MASK(q) ((size_t) (QUEUE_CAPACITY - 1))
+#else
+    #define QUEUE_CELL_MASK(q) ((q)->cell_mask)
+#endif
+
+#if defined(QUEUE_CELL_LAYOUT_SPREAD) && !QUEUE_SPSC
+    #define QUEUE_CELL_INDEX(q, pos) QUEUE_FN(cell_index)(q, pos)
+#else
+    #define QUEUE_CELL_INDEX(q, pos) ((pos) & QUEUE_CELL_MASK(q))
+#endif
+
+// Only the side whose other index is atomic can measure occupancy: producers
+// unless there is a single consumer (then consumers), spsc uses producers.
+#if defined(QUEUE_STATS)
+    #if (QUEUE_MP)
+        #define QUEUE_STATS_P(q, field, n) \
+            queue_stats_add_shared(&(q)->enqueue_stats.field, n)
+    #else
+        #define QUEUE_STATS_P(q, field, n) \
+            queue_stats_add_owned(&(q)->enqueue_stats.field, n)
+    #endif
+
+    #if (QUEUE_MC)
+        #define QUEUE_STATS_C(q, field, n) \
+            queue_stats_add_shared(&(q)->dequeue_stats.field, n)
+    #else
+        #define QUEUE_STATS_C(q, field, n) \
+            queue_stats_add_owned(&(q)->dequeue_stats.field, n)
+    #endif
+
+    #if (QUEUE_MC) || QUEUE_SPSC
+        #define QUEUE_STATS_PEAK_P(q, end)                                     \
+            queue_stats_peak                                                   \
+            (                                                                  \
+                  &(q)->enqueue_stats.peak                                     \
+                , (intptr_t) ((end) - QUEUE_ATOMIC_LOAD                        \
+                  (                                                            \
+                        &(q)->dequeue_index                                    \
+                      , QUEUE_ORDER_RELAXED                                    \
+                  ))                                                           \
+                , QUEUE_CELL_MASK(q) + 1                                       \
+            )
+        #define QUEUE_STATS_PEAK_C(q, pos)
+    #else
+        #define QUEUE_STATS_PEAK_P(q, end)
+        #define QUEUE_STATS_PEAK_C(q, pos)                                     \
+            queue_stats_peak                                                   \
+            (                                                                  \
+                  &(q)->dequeue_stats.peak                                     \
+                , (intptr_t) (QUEUE_ATOMIC_LOAD                                \
+                  (                                                            \
+                        &(q)->enqueue_index                                    \
+                      , QUEUE_ORDER_RELAXED                                    \
+                  ) - (pos))                                                   \
+                , QUEUE_CELL_MASK(q) + 1                                       \
+            )
+    #endif
+#else
+    #define QUEUE_STATS_P(q, field, n)
+    #define QUEUE_STATS_C(q, field, n)
+    #define QUEUE_STATS_PEAK_P(q, end)
+    #define QUEUE_STATS_PEAK_C(q, pos)
+#endif
+
+#if defined(QUEUE_WAIT)
+    #define QUEUE_WAKE_NOT_EMPTY(q) \
+        queue_event_notify_after_fence(&(q)->not_empty)
+    #define QUEUE_WAKE_NOT_FULL(q) \
+        queue_event_notify_after_fence(&(q)->not_full)
+#else
+    #define QUEUE_WAKE_NOT_EMPTY(q)
+    #define QUEUE_WAKE_NOT_FULL(q)
+#endif
+
+#if defined(QUEUE_NOTIFY)
+    #if defined(QUEUE_SHM)
+        #error QUEUE_NOTIFY does not work with QUEUE_SHM, eventfds are local
+    #endif
+
+    #define QUEUE_NOTIFY_NOT_EMPTY(q) \
+        queue_notifier_signal_after_fence(&(q)->notify_not_empty)
+    #define QUEUE_NOTIFY_NOT_FULL(q) \
+        queue_notifier_signal_after_fence(&(q)->notify_not_full)
+#else
+    #define QUEUE_NOTIFY_NOT_EMPTY(q)
+    #define QUEUE_NOTIFY_NOT_FULL(q)
+#endif
+
+#if defined(QUEUE_SELECT)
+    #if defined(QUEUE_SHM)
+        #error QUEUE_SELECT does not work with QUEUE_SHM, sets are local
+    #endif
+
+    #define QUEUE_SELECT_NOT_EMPTY(q) \
+        queue_set_signal_after_fence(&(q)->set_link)
+#else
+    #define QUEUE_SELECT_NOT_EMPTY(q)
+#endif
+
+#if defined(QUEUE_CLOSE)
+    #define QUEUE_CLOSED_CHECK(q)                                              \
+        do                                                                     \
+        {                                                                      \
+            if (QUEUE_ATOMIC_LOAD(&(q)->closed, QUEUE_ORDER_RELAXED))          \
+            {                                                                  \
+                return Queue_Result_Closed;                                    \
+            }                                                                  \
+        }                                                                      \
+        while (0)
+
+    #define QUEUE_CLOSED_CHECK_BULK(q, moved)                                  \
+        do                                                                     \
+        {                                                                      \
+            if (QUEUE_ATOMIC_LOAD(&(q)->closed, QUEUE_ORDER_RELAXED))          \
+            {                                                                  \
+                *(moved) = 0;                                                  \
+                return Queue_Result_Closed;                                    \
+            }                                                                  \
+        }                                                                      \
+        while (0)
+
+    #define QUEUE_EMPTY(q, pos) QUEUE_FN(empty_or_closed)(q, pos)
+#else
+    #define QUEUE_CLOSED_CHECK(q)
+    #define QUEUE_CLOSED_CHECK_BULK(q, moved)
+    #define QUEUE_EMPTY(q, pos) Queue_Result_Empty
+#endif
+
+// Waiters, notifiers and sets all pair a seq_cst fence after the item is
+// published with their own fence, so one fence covers all of them.
+#if defined(QUEUE_WAIT) || defined(QUEUE_NOTIFY) || defined(QUEUE_SELECT)
+    #define QUEUE_SIGNAL_FENCE_NOT_EMPTY() QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST)
+#else
+    #define QUEUE_SIGNAL_FENCE_NOT_EMPTY()
+#endif
+
+#if defined(QUEUE_WAIT) || defined(QUEUE_NOTIFY)
+    #define QUEUE_SIGNAL_FENCE_NOT_FULL() QUEUE_ATOMIC_FENCE(QUEUE_ORDER_SEQ_CST)
+#else
+    #define QUEUE_SIGNAL_FENCE_NOT_FULL()
+#endif
+
+#define QUEUE_SIGNAL_NOT_EMPTY(q)                                              \
+    do                                                                         \
+    {                                                                          \
+        QUEUE_SIGNAL_FENCE_NOT_EMPTY();                                        \
+        QUEUE_WAKE_NOT_EMPTY(q);                                               \
+        QUEUE_NOTIFY_NOT_EMPTY(q);                                             \
+        QUEUE_SELECT_NOT_EMPTY(q);                                             \
+    }                                                                          \
+    while (0)
+
+#define QUEUE_SIGNAL_NOT_FULL(q)                                               \
+    do                                                                         \
+    {                                                                          \
+        QUEUE_SIGNAL_FENCE_NOT_FULL();                                         \
+        QUEUE_WAKE_NOT_FULL(q);                                                \
+        QUEUE_NOTIFY_NOT_FULL(q);                                              \
+    }                                                                          \
+    while (0)
+
+// -----------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_STRUCT QUEUE_STRUCT;
+
+#if defined(QUEUE_CAPACITY)
+// Fixed capacity queues are plain structs that can be static, on the stack or
+// embedded in other structs. They still need init_queue before first use.
+void QUEUE_FN(init_queue)(QUEUE_STRUCT* queue);
+#else
+Queue_Result QUEUE_FN(make_queue)
+(
+      size_t        cell_count
+    , QUEUE_STRUCT* queue
+    , size_t*       bytes
+);
+#endif
+
+#if defined(QUEUE_SHM)
+// Queues in shared memory. create sizes fd, builds the queue in it and maps
+// it, attach maps a queue somebody else created after checking it has the
+// same flavour, type and layout as this one. fd can be closed afterwards.
+// The _name versions open fd with shm_open, and create fails if name is
+// taken. Queue_Result_Error_System leaves errno set,
+// Queue_Result_Error_Not_Ready means the queue isn't created yet.
+#if defined(QUEUE_CAPACITY)
+Queue_Result QUEUE_FN(shm_create)     (int fd,           QUEUE_STRUCT** queue);
+Queue_Result QUEUE_FN(shm_create_name)(char const* name, QUEUE_STRUCT** queue);
+#else
+Queue_Result QUEUE_FN(shm_create)
+(
+      int            fd
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+);
+
+Queue_Result QUEUE_FN(shm_create_name)
+(
+      char const*    name
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+);
+#endif
+
+Queue_Result QUEUE_FN(shm_attach)     (int fd,           QUEUE_STRUCT** queue);
+Queue_Result QUEUE_FN(shm_attach_name)(char const* name, QUEUE_STRUCT** queue);
+
+// Unmaps the queue. The memory itself goes once every process has detached
+// and the fd is closed, or the name is shm_unlink'd.
+void QUEUE_FN(shm_detach)(QUEUE_STRUCT* queue);
+#endif
+
+Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data);
+Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE*       data);
+Queue_Result QUEUE_FN(enqueue)    (QUEUE_STRUCT* queue, QUEUE_TYPE const* data);
+Queue_Result QUEUE_FN(dequeue)    (QUEUE_STRUCT* queue, QUEUE_TYPE*       data);
+
+// Moves up to count items with a single index update. written / read is set to
+// the number of items moved; the result is Ok if at least one item was moved.
+Queue_Result QUEUE_FN(try_enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+);
+
+Queue_Result QUEUE_FN(try_dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+);
+
+Queue_Result QUEUE_FN(enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+);
+
+Queue_Result QUEUE_FN(dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+);
+
+// Zero copy access. enqueue_reserve hands out the storage of the next cell,
+// which is published by enqueue_commit. dequeue_peek hands out the storage of
+// the oldest cell, which is given back by dequeue_release. The spsc queue only
+// allows one outstanding reserve and one outstanding peek at a time.
+Queue_Result QUEUE_FN(try_enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data);
+Queue_Result QUEUE_FN(enqueue_reserve)    (QUEUE_STRUCT* queue, QUEUE_TYPE** data);
+#if !defined(QUEUE_OVERWRITE)
+Queue_Result QUEUE_FN(try_dequeue_peek)   (QUEUE_STRUCT* queue, QUEUE_TYPE** data);
+Queue_Result QUEUE_FN(dequeue_peek)       (QUEUE_STRUCT* queue, QUEUE_TYPE** data);
+#endif
+void         QUEUE_FN(enqueue_commit)     (QUEUE_STRUCT* queue, QUEUE_TYPE*  data);
+#if !defined(QUEUE_OVERWRITE)
+void         QUEUE_FN(dequeue_release)    (QUEUE_STRUCT* queue, QUEUE_TYPE*  data);
+#endif
+
+#if defined(QUEUE_OVERWRITE)
+// Overwrite mode: the producer never sees a full queue, it overwrites the
+// oldest item instead. Consumers that were lapped skip to the oldest item still
+// in the queue, and take_dropped returns how many items were skipped since the
+// last call. There is no dequeue_peek, as the producer could overwrite the
+// cell while it is being read. With a single consumer, only call take_dropped
+// from the consumer thread.
+size_t QUEUE_FN(take_dropped)(QUEUE_STRUCT* queue);
+#endif
+
+#if defined(QUEUE_STATS)
+// A snapshot of the counters. Each counter is read on its own, so the values
+// can be slightly out of step with each other while the queue is in use.
+void QUEUE_FN(get_stats)(QUEUE_STRUCT* queue, Queue_Stats* stats);
+#endif
+
+#if defined(QUEUE_NOTIFY)
+// Event loop integration. notify_open creates an eventfd for each side, which
+// get_fd hands out for epoll. Not_Empty is for consumers and is signalled when
+// an item is enqueued, Not_Full is for producers and is signalled when an item
+// is dequeued, but only if the notifier was armed since the last signal. So
+// before going back to epoll, arm, then try once more, and only wait if that
+// still fails:
+//
+//     notify_clear(queue, Queue_Notify_Not_Empty);
+//     while (try_dequeue(queue, &item) == Queue_Result_Ok) use(&item);
+//     notify_arm(queue, Queue_Notify_Not_Empty);
+//     if (try_dequeue(queue, &item) == Queue_Result_Ok) ... keep going
+//
+// Both notifiers start armed. Each fd is meant for one waiting thread or event
+// loop, as clearing it also eats the wakeup of anyone else polling it.
+// notify_clear returns Queue_Result_Error_System, with errno set, if reading
+// the eventfd fails for any reason but there being nothing to read.
+// notify_close closes the eventfds.
+Queue_Result QUEUE_FN(notify_open) (QUEUE_STRUCT* queue);
+void         QUEUE_FN(notify_close)(QUEUE_STRUCT* queue);
+int          QUEUE_FN(get_fd)      (QUEUE_STRUCT* queue, Queue_Notify which);
+void         QUEUE_FN(notify_arm)  (QUEUE_STRUCT* queue, Queue_Notify which);
+Queue_Result QUEUE_FN(notify_clear)(QUEUE_STRUCT* queue, Queue_Notify which);
+#endif
+
+#if defined(QUEUE_CLOSE)
+// Ends the queue. Enqueues after it return Queue_Result_Closed, and dequeues
+// return the items still in the queue, then Queue_Result_Closed instead of
+// Queue_Result_Empty. Waiting threads are woken. Call it once the producers
+// are done: from the producer's thread, or after the producers have been
+// joined or otherwise synchronised with. An enqueue racing with close can
+// still succeed, and its item can come after a consumer has seen Closed.
+void QUEUE_FN(close)    (QUEUE_STRUCT* queue);
+int  QUEUE_FN(is_closed)(QUEUE_STRUCT* queue);
+#endif
+
+#if defined(QUEUE_SELECT)
+// For queue_set_add and queue_set_remove, the same for every QUEUE_TYPE:
+//
+//     queue_set_add(&set, spsc_set_link_My_Struct(queue), &index);
+Queue_Set_Link* QUEUE_FN(set_link)(QUEUE_STRUCT* queue);
+#endif
+
+#if defined(QUEUE_WAIT)
+// Blocking versions that wait while the queue is full or empty. They spin,
+// then yield, then sleep until the other side signals. The timed versions
+// return Queue_Result_Timeout once timeout_ns nanoseconds have passed.
+Queue_Result QUEUE_FN(enqueue_wait)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data);
+Queue_Result QUEUE_FN(dequeue_wait)(QUEUE_STRUCT* queue, QUEUE_TYPE*       data);
+
+Queue_Result QUEUE_FN(enqueue_wait_timed)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , uint64_t          timeout_ns
+);
+
+Queue_Result QUEUE_FN(dequeue_wait_timed)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , uint64_t          timeout_ns
+);
+#endif
+
+// -----------------------------------------------------------------------------
+// The queue structs are only visible to the implementation, unless the queue
+// has a fixed capacity, in which case users need the size too.
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_CAPACITY) || defined(QUEUE_IMPLEMENTATION)
+
+#if defined(QUEUE_CAPACITY)
+    #define QUEUE_PAD0 \
+        QUEUE_ALIGNAS(QUEUE_CACHELINE_BYTES) uint8_t pad0[QUEUE_CACHELINE_BYTES]
+    #define QUEUE_CELLS QUEUE_CAPACITY
+#else
+    #define QUEUE_PAD0  uint8_t pad0[QUEUE_CACHELINE_BYTES]
+    #define QUEUE_CELLS
+#endif
+
+#if QUEUE_SPSC
+
+// Single producer, single consumer: no per cell sequence. Each side owns its
+// index and keeps a cached copy of the other side's index, so the shared
+// cache lines are only touched when the cached copy says full or empty.
+
+typedef struct QUEUE_CELL
+{
+    QUEUE_TYPE          data;
+}
+QUEUE_CELL;
+
+typedef struct QUEUE_STRUCT
+{
+    QUEUE_PAD0;
+
+    QUEUE_ATOMIC_SIZE_T enqueue_index;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    QUEUE_ATOMIC_SIZE_T dequeue_index;
+    uint8_t             pad3[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    size_t              dequeue_index_cached;
+    uint8_t             pad4[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    size_t              enqueue_index_cached;
+    uint8_t             pad5[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+#if !defined(QUEUE_CAPACITY)
+    size_t              cell_mask;
+    uint8_t             pad6[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+#endif
+
+#if defined(QUEUE_WAIT)
+    Queue_Event         not_empty;
+    uint8_t             pad7[QUEUE_CACHELINE_BYTES - sizeof(Queue_Event)];
+
+    Queue_Event         not_full;
+    uint8_t             pad8[QUEUE_CACHELINE_BYTES - sizeof(Queue_Event)];
+#endif
+
+#if defined(QUEUE_NOTIFY)
+    Queue_Notifier      notify_not_empty;
+    uint8_t pad11[QUEUE_CACHELINE_BYTES - sizeof(Queue_Notifier)];
+
+    Queue_Notifier      notify_not_full;
+    uint8_t pad12[QUEUE_CACHELINE_BYTES - sizeof(Queue_Notifier)];
+#endif
+
+#if defined(QUEUE_SELECT)
+    Queue_Set_Link      set_link;
+    uint8_t pad13[QUEUE_CACHELINE_BYTES - sizeof(Queue_Set_Link)];
+#endif
+
+#if defined(QUEUE_CLOSE)
+    QUEUE_ATOMIC_SIZE_T closed;
+    QUEUE_ATOMIC_SIZE_T closed_at;
+    uint8_t pad14[QUEUE_CACHELINE_BYTES - (2 * sizeof(QUEUE_ATOMIC_SIZE_T))];
+#endif
+
+#if defined(QUEUE_STATS)
+    Queue_Stats_Counters enqueue_stats;
+    uint8_t pad9 [QUEUE_CACHELINE_BYTES - sizeof(Queue_Stats_Counters)];
+
+    Queue_Stats_Counters dequeue_stats;
+    uint8_t pad10[QUEUE_CACHELINE_BYTES - sizeof(Queue_Stats_Counters)];
+#endif
+
+    QUEUE_CELL          cells[QUEUE_CELLS];
+}
+QUEUE_STRUCT;
+
+#else
+
+#if defined(QUEUE_CELL_LAYOUT_SPREAD)
+
+// The spread layout wants a power of 2 cells per cache line, so cells smaller
+// than a line are padded up to a power of 2 and never straddle lines. The
+// stride member only sets the size, data is still where it would be.
+
+#define QUEUE_CELL_DATA_AT                                                     \
+    (                                                                          \
+          (sizeof(QUEUE_ATOMIC_SIZE_T) + QUEUE_ALIGNOF(QUEUE_TYPE) - 1)        \
+        & ~(QUEUE_ALIGNOF(QUEUE_TYPE) - 1)                                     \
+    )
+
+#define QUEUE_CELL_PACKED (QUEUE_CELL_DATA_AT + sizeof(QUEUE_TYPE))
+
+#define QUEUE_CELL_STRIDE                                                      \
+    (                                                                          \
+        (QUEUE_CELL_PACKED >= QUEUE_CACHELINE_BYTES)                           \
+            ? QUEUE_CELL_PACKED                                                \
+            : ((size_t) 1 << QUEUE_LOG2_SMALL((2 * QUEUE_CELL_PACKED) - 1))    \
+    )
+
+typedef struct QUEUE_CELL
+{
+    QUEUE_ATOMIC_SIZE_T sequence;
+
+    union
+    {
+        QUEUE_TYPE      data;
+        uint8_t         stride[QUEUE_CELL_STRIDE - QUEUE_CELL_DATA_AT];
+    };
+}
+QUEUE_CELL;
+
+#else
+
+typedef struct QUEUE_CELL
+{
+    QUEUE_ATOMIC_SIZE_T sequence;
+    QUEUE_TYPE          data;
+}
+QUEUE_CELL;
+
+#endif
+
+typedef struct QUEUE_STRUCT
+{
+    QUEUE_PAD0;
+
+    QUEUE_P_TYPE   enqueue_index;
+    uint8_t        pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_P_TYPE)];
+
+    QUEUE_C_TYPE   dequeue_index;
+    uint8_t        pad3[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_C_TYPE)];
+
+#if defined(QUEUE_OVERWRITE)
+    QUEUE_C_TYPE   dropped;
+    uint8_t        pad9[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_C_TYPE)];
+#endif
+
+#if QUEUE_FAA
+    QUEUE_ATOMIC_SIZE_T parked_count;
+    QUEUE_ATOMIC_SIZE_T parked[QUEUE_FAA_PARKED];
+    uint8_t pad14[QUEUE_CACHELINE_BYTES - ((QUEUE_FAA_PARKED + 1) * sizeof(QUEUE_ATOMIC_SIZE_T))];
+#endif
+
+#if !defined(QUEUE_CAPACITY)
+    size_t         cell_mask;
+#if defined(QUEUE_CELL_LAYOUT_SPREAD)
+    size_t         spread_mask;
+    uint8_t        pad4[QUEUE_CACHELINE_BYTES - (2 * sizeof(size_t))];
+#else
+    uint8_t        pad4[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+#endif
+#endif
+
+#if defined(QUEUE_WAIT)
+    Queue_Event    not_empty;
+    uint8_t        pad5[QUEUE_CACHELINE_BYTES - sizeof(Queue_Event)];
+
+    Queue_Event    not_full;
+    uint8_t        pad6[QUEUE_CACHELINE_BYTES - sizeof(Queue_Event)];
+#endif
+
+#if defined(QUEUE_NOTIFY)
+    Queue_Notifier notify_not_empty;
+    uint8_t pad10[QUEUE_CACHELINE_BYTES - sizeof(Queue_Notifier)];
+
+    Queue_Notifier notify_not_full;
+    uint8_t pad11[QUEUE_CACHELINE_BYTES - sizeof(Queue_Notifier)];
+#endif
+
+#if defined(QUEUE_SELECT)
+    Queue_Set_Link set_link;
+    uint8_t pad12[QUEUE_CACHELINE_BYTES - sizeof(Queue_Set_Link)];
+#endif
+
+#if defined(QUEUE_CLOSE)
+    QUEUE_ATOMIC_SIZE_T closed;
+    QUEUE_ATOMIC_SIZE_T closed_at;
+    uint8_t pad13[QUEUE_CACHELINE_BYTES - (2 * sizeof(QUEUE_ATOMIC_SIZE_T))];
+#endif
+
+#if defined(QUEUE_STATS)
+    Queue_Stats_Counters enqueue_stats;
+    uint8_t pad7[QUEUE_CACHELINE_BYTES - sizeof(Queue_Stats_Counters)];
+
+    Queue_Stats_Counters dequeue_stats;
+    uint8_t pad8[QUEUE_CACHELINE_BYTES - sizeof(Queue_Stats_Counters)];
+#endif
+
+    QUEUE_CELL     cells[QUEUE_CELLS];
+}
+QUEUE_STRUCT;
+
+#endif
+
+#endif
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+#undef QUEUE_IMPLEMENTATION
+
+#if defined(QUEUE_CELL_LAYOUT_SPREAD) && !QUEUE_SPSC
+
+// Consecutive positions are spread over different cache lines by swapping the
+// low bits of the index (the cell within a cache line) with the bits above
+// them (the cache line), so neighbouring producers and consumers do not share
+// a line. The spread mask is 0, so no swap, if the queue is too small for it.
+// The cell size is a power of 2 here, see QUEUE_CELL_STRIDE, so the swap
+// moves each neighbour a whole line away.
+
+#define QUEUE_SPREAD_BITS \
+    QUEUE_LOG2_SMALL(QUEUE_CACHELINE_BYTES / sizeof(QUEUE_CELL))
+
+#define QUEUE_SPREAD_MASK_FOR(cell_count)                                      \
+    (                                                                          \
+        ((cell_count) >= ((size_t) 1 << (2 * QUEUE_SPREAD_BITS)))              \
+            ? (((size_t) 1 << QUEUE_SPREAD_BITS) - 1)                          \
+            : 0                                                                \
+    )
+
+#if defined(QUEUE_CAPACITY)
+    #define QUEUE_SPREAD_MASK(q) QUEUE_SPREAD_MASK_FOR(QUEUE_CAPACITY)
+#else
+    #define QUEUE_SPREAD_MASK(q) ((q)->spread_mask)
+#endif
+
+static inline size_t QUEUE_FN(cell_index)(QUEUE_STRUCT const* queue, size_t pos)
+{
+    (void) queue;
+
+    size_t index = pos & QUEUE_CELL_MASK(queue);
+    size_t mix   = (index ^ (index >> QUEUE_SPREAD_BITS));
+
+    mix &= QUEUE_SPREAD_MASK(queue);
+
+    return index ^ mix ^ (mix << QUEUE_SPREAD_BITS);
+}
+
+#endif
+
+// Expects zeroed memory, and for dynamic queues the masks already set.
+static void QUEUE_FN(init_indices)(QUEUE_STRUCT* queue)
+{
+#if QUEUE_SPSC
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, 0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, 0, QUEUE_ORDER_RELAXED);
+#else
+    for (size_t i = 0; i <= QUEUE_CELL_MASK(queue); i++)
+    {
+        QUEUE_ATOMIC_STORE
+        (
+              &queue->cells[QUEUE_CELL_INDEX(queue, i)].sequence
+            , i
+            , QUEUE_ORDER_RELAXED
+        );
+    }
+
+    QUEUE_P_SETUP(queue->enqueue_index, 0, QUEUE_ORDER_RELAXED);
+    QUEUE_C_SETUP(queue->dequeue_index, 0, QUEUE_ORDER_RELAXED);
+
+#if defined(QUEUE_OVERWRITE)
+    QUEUE_C_SETUP(queue->dropped, 0, QUEUE_ORDER_RELAXED);
+#endif
+#endif
+
+#if defined(QUEUE_NOTIFY)
+    queue->notify_not_empty.fd = -1;
+    queue->notify_not_full.fd  = -1;
+#endif
+}
+
+#if defined(QUEUE_CAPACITY)
+
+void QUEUE_FN(init_queue)(QUEUE_STRUCT* queue)
+{
+    memset(queue, 0, sizeof(QUEUE_STRUCT));
+
+    QUEUE_FN(init_indices)(queue);
+}
+
+#else
+
+Queue_Result QUEUE_FN(make_queue)
+(
+      size_t        cell_count
+    , QUEUE_STRUCT* queue
+    , size_t*       bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (cell_count < 2)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if (cell_count > QUEUE_TOO_BIG)
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    if (cell_count & (cell_count - 1))
+    {
+        return Queue_Result_Error_Not_Pow2;
     }
 
     size_t bytes_local =
           sizeof(QUEUE_STRUCT)
         + (sizeof(QUEUE_CELL) * cell_count);
 
-    if (!queue)
-    {
-        *bytes = bytes_local;
-        return Queue_Result_Ok;
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset(queue, 0, bytes_local);
+
+    queue->cell_mask = cell_count - 1;
+
+#if defined(QUEUE_CELL_LAYOUT_SPREAD) && !QUEUE_SPSC
+    queue->spread_mask = QUEUE_SPREAD_MASK_FOR(cell_count);
+#endif
+
+    QUEUE_FN(init_indices)(queue);
+
+    return Queue_Result_Ok;
+}
+
+#endif
+
+#if defined(QUEUE_SHM)
+
+// Anything that changes the struct layout has to match on both sides.
+static inline uint32_t QUEUE_FN(shm_flavour)(void)
+{
+    uint32_t flavour = (QUEUE_MP ? 1u : 0u) | (QUEUE_MC ? 2u : 0u);
+
+#if defined(QUEUE_MPMC_ENGINE_FAA)
+    flavour |= 4u;
+#endif
+#if defined(QUEUE_CELL_LAYOUT_SPREAD)
+    flavour |= 8u;
+#endif
+#if defined(QUEUE_WAIT)
+    flavour |= 16u;
+#endif
+#if defined(QUEUE_STATS)
+    flavour |= 32u;
+#endif
+#if defined(QUEUE_CAPACITY)
+    flavour |= 64u;
+#endif
+#if defined(QUEUE_OVERWRITE)
+    flavour |= 128u;
+#endif
+#if defined(QUEUE_CLOSE)
+    flavour |= 256u;
+#endif
+
+    return flavour;
+}
+
+static Queue_Result QUEUE_FN(shm_create_sized)
+(
+      int            fd
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+)
+{
+    size_t queue_bytes = 0;
+
+#if defined(QUEUE_CAPACITY)
+    queue_bytes = sizeof(QUEUE_STRUCT);
+#else
+    Queue_Result made = QUEUE_FN(make_queue)(cell_count, NULL, &queue_bytes);
+
+    if (made != Queue_Result_Ok)
+    {
+        return made;
+    }
+#endif
+
+    size_t bytes = QUEUE_SHM_HEADER_BYTES + queue_bytes;
+
+    if (ftruncate(fd, (off_t) bytes) != 0)
+    {
+        return Queue_Result_Error_System;
+    }
+
+    void* mapping;
+
+    Queue_Result result = queue_shm_map(fd, bytes, &mapping);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    Queue_Shm_Header* header  = (Queue_Shm_Header*) mapping;
+    QUEUE_STRUCT*     created =
+        (QUEUE_STRUCT*) ((uint8_t*) mapping + QUEUE_SHM_HEADER_BYTES);
+
+#if defined(QUEUE_CAPACITY)
+    QUEUE_FN(init_queue)(created);
+#else
+    QUEUE_FN(make_queue)(cell_count, created, &queue_bytes);
+#endif
+
+    header->magic      = QUEUE_SHM_MAGIC;
+    header->version    = QUEUE_SHM_VERSION;
+    header->flavour    = QUEUE_FN(shm_flavour)();
+    header->type_size  = sizeof(QUEUE_TYPE);
+    header->cell_count = cell_count;
+    header->bytes      = bytes;
+
+    QUEUE_ATOMIC_STORE(&header->ready, 1, QUEUE_ORDER_RELEASE);
+
+    *queue = created;
+
+    return Queue_Result_Ok;
+}
+
+static Queue_Result QUEUE_FN(shm_create_named)
+(
+      char const*    name
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+)
+{
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+
+    if (fd < 0)
+    {
+        return Queue_Result_Error_System;
+    }
+
+    Queue_Result result = QUEUE_FN(shm_create_sized)(fd, cell_count, queue);
+
+    // Keep errno from the failure, not from the clean up.
+    int error = errno;
+
+    if (result != Queue_Result_Ok)
+    {
+        shm_unlink(name);
+    }
+
+    close(fd);
+
+    errno = error;
+
+    return result;
+}
+
+#if defined(QUEUE_CAPACITY)
+
+Queue_Result QUEUE_FN(shm_create)(int fd, QUEUE_STRUCT** queue)
+{
+    return QUEUE_FN(shm_create_sized)(fd, QUEUE_CAPACITY, queue);
+}
+
+Queue_Result QUEUE_FN(shm_create_name)(char const* name, QUEUE_STRUCT** queue)
+{
+    return QUEUE_FN(shm_create_named)(name, QUEUE_CAPACITY, queue);
+}
+
+#else
+
+Queue_Result QUEUE_FN(shm_create)
+(
+      int            fd
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+)
+{
+    return QUEUE_FN(shm_create_sized)(fd, cell_count, queue);
+}
+
+Queue_Result QUEUE_FN(shm_create_name)
+(
+      char const*    name
+    , size_t         cell_count
+    , QUEUE_STRUCT** queue
+)
+{
+    return QUEUE_FN(shm_create_named)(name, cell_count, queue);
+}
+
+#endif
+
+Queue_Result QUEUE_FN(shm_attach)(int fd, QUEUE_STRUCT** queue)
+{
+    Queue_Shm_Header* header;
+    size_t            bytes;
+
+    Queue_Result result = queue_shm_map_existing(fd, &header, &bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    size_t queue_bytes = 0;
+
+#if defined(QUEUE_CAPACITY)
+    queue_bytes = sizeof(QUEUE_STRUCT);
+
+    int sized = (header->cell_count == QUEUE_CAPACITY);
+#else
+    int sized =
+           (header->cell_count <= QUEUE_TOO_BIG)
+        && (QUEUE_FN(make_queue)
+           (
+                 (size_t) header->cell_count
+               , NULL
+               , &queue_bytes
+           ) == Queue_Result_Ok);
+#endif
+
+    if
+    (
+           (header->magic     != QUEUE_SHM_MAGIC)
+        || (header->version   != QUEUE_SHM_VERSION)
+        || (header->flavour   != QUEUE_FN(shm_flavour)())
+        || (header->type_size != sizeof(QUEUE_TYPE))
+        || (header->bytes     != bytes)
+        || !sized
+        || (bytes != (QUEUE_SHM_HEADER_BYTES + queue_bytes))
+    )
+    {
+        munmap(header, bytes);
+
+        return Queue_Result_Error_Header_Mismatch;
+    }
+
+    *queue = (QUEUE_STRUCT*) ((uint8_t*) header + QUEUE_SHM_HEADER_BYTES);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(shm_attach_name)(char const* name, QUEUE_STRUCT** queue)
+{
+    int fd = shm_open(name, O_RDWR, 0);
+
+    if (fd < 0)
+    {
+        return (errno == ENOENT)
+            ? Queue_Result_Error_Not_Ready
+            : Queue_Result_Error_System;
+    }
+
+    Queue_Result result = QUEUE_FN(shm_attach)(fd, queue);
+
+    int error = errno;
+
+    close(fd);
+
+    errno = error;
+
+    return result;
+}
+
+void QUEUE_FN(shm_detach)(QUEUE_STRUCT* queue)
+{
+    Queue_Shm_Header* header =
+        (Queue_Shm_Header*) ((uint8_t*) queue - QUEUE_SHM_HEADER_BYTES);
+
+    munmap(header, (size_t) header->bytes);
+}
+
+#endif
+
+#if defined(QUEUE_CLOSE)
+// The consumer at pos found nothing. Once closed, and with everything up to
+// closed_at dequeued, that is for good.
+static inline Queue_Result QUEUE_FN(empty_or_closed)
+(
+      QUEUE_STRUCT* queue
+    , size_t        pos
+)
+{
+    if (!QUEUE_ATOMIC_LOAD(&queue->closed, QUEUE_ORDER_ACQUIRE))
+    {
+        return Queue_Result_Empty;
+    }
+
+    size_t end = QUEUE_ATOMIC_LOAD(&queue->closed_at, QUEUE_ORDER_RELAXED);
+
+    // Past closed_at counts too: faa consumers racing for the last item each
+    // take a ticket, so the dequeue index can overshoot it.
+    if ((intptr_t) (pos - end) >= 0)
+    {
+        return Queue_Result_Closed;
+    }
+
+    return Queue_Result_Empty;
+}
+#endif
+
+#if defined(QUEUE_OVERWRITE)
+
+// The producer never looks at the consumers. A cell's sequence is pos while
+// the producer writes item pos into it and pos + 1 once it is done, like a
+// seqlock: a consumer copies the data, then checks that the sequence hasn't
+// moved. A sequence past pos + 1 means the consumer has been lapped.
+
+static inline void QUEUE_FN(overwrite_begin)(QUEUE_CELL* cell, size_t pos)
+{
+    QUEUE_ATOMIC_STORE(&cell->sequence, pos, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_FENCE(QUEUE_ORDER_RELEASE);
+}
+
+// The consumer's copy races with the producer's plain write of the same cell.
+// By the letter of C11 that is undefined behaviour. It is deliberate: the
+// copy is only used if overwrite_intact finds the sequence unchanged, the
+// usual seqlock read, and atomic copies can't cover enqueue_reserve, where
+// the caller writes the cell. The thread sanitizer is told to skip it, which
+// holds for items the compiler copies inline rather than with a memcpy call.
+static QUEUE_NO_SANITIZE_THREAD void QUEUE_FN(overwrite_read)
+(
+      QUEUE_TYPE*       data
+    , QUEUE_CELL const* cell
+)
+{
+    *data = cell->data;
+}
+
+static inline int QUEUE_FN(overwrite_intact)(QUEUE_CELL* cell, size_t sequence)
+{
+    QUEUE_ATOMIC_FENCE(QUEUE_ORDER_ACQUIRE);
+
+    return QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED) == sequence;
+}
+
+Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+    QUEUE_FN(overwrite_begin)(cell, pos);
+
+    cell->data = *data;
+
+    QUEUE_ATOMIC_STORE(&cell->sequence, pos + 1, QUEUE_ORDER_RELEASE);
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    size_t pos =
+        QUEUE_C_LOAD(queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    for (;;)
+    {
+        QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+        size_t sequence =
+            QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+        intptr_t difference = (intptr_t) sequence - (intptr_t)(pos + 1);
+
+        if (difference < 0)
+        {
+            QUEUE_STATS_C(queue, blocked, 1);
+            return QUEUE_EMPTY(queue, pos);
+        }
+
+        if (!difference)
+        {
+            QUEUE_FN(overwrite_read)(data, cell);
+
+            if (QUEUE_FN(overwrite_intact)(cell, sequence))
+            {
+                QUEUE_C_IF_CAS
+                (
+                      queue->dequeue_index
+                    , pos
+                    , pos + 1
+                    , QUEUE_ORDER_RELAXED
+                    , QUEUE_ORDER_RELAXED
+                )
+                {
+                    QUEUE_STATS_C(queue, ok, 1);
+                    QUEUE_STATS_PEAK_C(queue, pos);
+
+                    return Queue_Result_Ok;
+                }
+
+                QUEUE_STATS_C(queue, contention, 1);
+                QUEUE_STATS_C(queue, retries, 1);
+                return Queue_Result_Contention;
+            }
+        }
+
+        // Lapped, skip to the oldest item the producer hasn't overwritten.
+        // The producer's index can lag the cell it is writing, and if it
+        // doesn't take us forward yet the producer is mid write, maybe
+        // preempted, so don't wait on it here.
+        size_t oldest =
+              QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE)
+            - (QUEUE_CELL_MASK(queue) + 1);
+
+        if ((intptr_t) (oldest - pos) <= 0)
+        {
+            QUEUE_STATS_C(queue, contention, 1);
+            return Queue_Result_Contention;
+        }
+
+        QUEUE_C_IF_CAS
+        (
+              queue->dequeue_index
+            , pos
+            , oldest
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+        {
+#if (QUEUE_MC)
+            QUEUE_ATOMIC_FETCH_ADD
+            (
+                  &queue->dropped
+                , oldest - pos
+                , QUEUE_ORDER_RELAXED
+            );
+#else
+            queue->dropped += oldest - pos;
+#endif
+
+            pos = oldest;
+            continue;
+        }
+
+        QUEUE_STATS_C(queue, contention, 1);
+        return Queue_Result_Contention;
+    }
+}
+
+// Bulk enqueue writes every item, even more than fit, and publishes the index
+// once. Bulk dequeue is item by item, as any item can be overwritten.
+Queue_Result QUEUE_FN(try_enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+)
+{
+    QUEUE_CLOSED_CHECK_BULK(queue, written);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos + i)];
+
+        QUEUE_FN(overwrite_begin)(cell, pos + i);
+
+        cell->data = data[i];
+
+        QUEUE_ATOMIC_STORE(&cell->sequence, pos + i + 1, QUEUE_ORDER_RELEASE);
+    }
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + count, QUEUE_ORDER_RELEASE);
+
+    *written = count;
+
+    QUEUE_STATS_P(queue, ok, count);
+    QUEUE_STATS_PEAK_P(queue, pos + count);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+)
+{
+    Queue_Result result = Queue_Result_Ok;
+
+    *read = 0;
+
+    while (*read < count)
+    {
+        result = QUEUE_FN(try_dequeue)(queue, &data[*read]);
+
+        if (result != Queue_Result_Ok)
+        {
+            break;
+        }
+
+        (*read)++;
+    }
+
+    return *read ? Queue_Result_Ok : result;
+}
+
+Queue_Result QUEUE_FN(try_enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+    QUEUE_FN(overwrite_begin)(cell, pos);
+
+    *data = &cell->data;
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_FN(enqueue_commit)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) data;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+    QUEUE_ATOMIC_STORE(&cell->sequence, pos + 1, QUEUE_ORDER_RELEASE);
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+}
+
+size_t QUEUE_FN(take_dropped)(QUEUE_STRUCT* queue)
+{
+#if (QUEUE_MC)
+    size_t dropped = QUEUE_ATOMIC_LOAD(&queue->dropped, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_FETCH_SUB(&queue->dropped, dropped, QUEUE_ORDER_RELAXED);
+#else
+    size_t dropped = queue->dropped;
+
+    queue->dropped = 0;
+#endif
+
+    return dropped;
+}
+
+#elif QUEUE_SPSC
+
+Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    if ((pos - queue->dequeue_index_cached) > QUEUE_CELL_MASK(queue))
+    {
+        queue->dequeue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        if ((pos - queue->dequeue_index_cached) > QUEUE_CELL_MASK(queue))
+        {
+            QUEUE_STATS_P(queue, blocked, 1);
+            return Queue_Result_Full;
+        }
+    }
+
+    queue->cells[QUEUE_CELL_INDEX(queue, pos)].data = *data;
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    if (pos == queue->enqueue_index_cached)
+    {
+        queue->enqueue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+        if (pos == queue->enqueue_index_cached)
+        {
+            QUEUE_STATS_C(queue, blocked, 1);
+            return QUEUE_EMPTY(queue, pos);
+        }
+    }
+
+    *data = queue->cells[QUEUE_CELL_INDEX(queue, pos)].data;
+
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_C(queue, ok, 1);
+    QUEUE_STATS_PEAK_C(queue, pos);
+
+    QUEUE_SIGNAL_NOT_FULL(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+)
+{
+    QUEUE_CLOSED_CHECK_BULK(queue, written);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    size_t free_cells =
+        QUEUE_CELL_MASK(queue) + 1 - (pos - queue->dequeue_index_cached);
+
+    if (free_cells < count)
+    {
+        queue->dequeue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        free_cells =
+            QUEUE_CELL_MASK(queue) + 1 - (pos - queue->dequeue_index_cached);
+    }
+
+    size_t to_write = (free_cells < count) ? free_cells : count;
+
+    *written = to_write;
+
+    if (!to_write && count)
+    {
+        QUEUE_STATS_P(queue, blocked, 1);
+        return Queue_Result_Full;
+    }
+
+    for (size_t i = 0; i < to_write; i++)
+    {
+        queue->cells[QUEUE_CELL_INDEX(queue, pos + i)].data = data[i];
+    }
+
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->enqueue_index
+        , pos + to_write
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_P(queue, ok, to_write);
+    QUEUE_STATS_PEAK_P(queue, pos + to_write);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    size_t used_cells = queue->enqueue_index_cached - pos;
+
+    if (used_cells < count)
+    {
+        queue->enqueue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+        used_cells = queue->enqueue_index_cached - pos;
+    }
+
+    size_t to_read = (used_cells < count) ? used_cells : count;
+
+    *read = to_read;
+
+    if (!to_read && count)
+    {
+        QUEUE_STATS_C(queue, blocked, 1);
+        return QUEUE_EMPTY(queue, pos);
+    }
+
+    for (size_t i = 0; i < to_read; i++)
+    {
+        data[i] = queue->cells[QUEUE_CELL_INDEX(queue, pos + i)].data;
+    }
+
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->dequeue_index
+        , pos + to_read
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_C(queue, ok, to_read);
+    QUEUE_STATS_PEAK_C(queue, pos);
+
+    QUEUE_SIGNAL_NOT_FULL(queue);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    if ((pos - queue->dequeue_index_cached) > QUEUE_CELL_MASK(queue))
+    {
+        queue->dequeue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        if ((pos - queue->dequeue_index_cached) > QUEUE_CELL_MASK(queue))
+        {
+            QUEUE_STATS_P(queue, blocked, 1);
+            return Queue_Result_Full;
+        }
+    }
+
+    *data = &queue->cells[QUEUE_CELL_INDEX(queue, pos)].data;
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_FN(enqueue_commit)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) data;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+}
+
+Queue_Result QUEUE_FN(try_dequeue_peek)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    if (pos == queue->enqueue_index_cached)
+    {
+        queue->enqueue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+        if (pos == queue->enqueue_index_cached)
+        {
+            QUEUE_STATS_C(queue, blocked, 1);
+            return QUEUE_EMPTY(queue, pos);
+        }
+    }
+
+    *data = &queue->cells[QUEUE_CELL_INDEX(queue, pos)].data;
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_FN(dequeue_release)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) data;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    QUEUE_STATS_C(queue, ok, 1);
+    QUEUE_STATS_PEAK_C(queue, pos);
+
+    QUEUE_SIGNAL_NOT_FULL(queue);
+}
+
+#elif QUEUE_FAA
+
+// Fetch and add engine: each side takes a ticket with fetch_add instead of a
+// CAS on the shared index, so a busy queue does not fail and retry. Ticket t
+// owns the cell at t, with the same sequences as below (t free for the
+// producer, t + 1 ready for the consumer, t + cells free for the next lap).
+// A producer marks its cell busy with a CAS before writing. A consumer that
+// gets to a cell before its producer skips it by moving the sequence to the
+// next lap, and the producer retries with a new ticket. A producer that finds
+// the queue full, or the last lap's item still in its cell, gives its ticket
+// up the same way: it never writes the cell and the consumer with that ticket
+// skips it. A consumer whose cell stays
+// busy, reserved or still holding the last lap, parks the ticket for a later
+// dequeue to pick up rather than waiting on it.
+
+#define QUEUE_FAA_BUSY ((size_t) 1 << ((sizeof(size_t) * 8) - 1))
+
+#if !defined(QUEUE_FAA_SPINS)
+    #define QUEUE_FAA_SPINS 64
+#endif
+
+static inline Queue_Result QUEUE_FN(faa_claim_enqueue)
+(
+      QUEUE_STRUCT* queue
+    , QUEUE_CELL**  claimed
+)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t cells = QUEUE_CELL_MASK(queue) + 1;
+
+    for (;;)
+    {
+        size_t enqueue =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+        size_t dequeue =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+        if ((intptr_t) (enqueue - dequeue) >= (intptr_t) cells)
+        {
+            QUEUE_STATS_P(queue, blocked, 1);
+            return Queue_Result_Full;
+        }
+
+        size_t pos = QUEUE_ATOMIC_FETCH_ADD
+        (
+              &queue->enqueue_index
+            , 1
+            , QUEUE_ORDER_RELAXED
+        );
+
+        QUEUE_CELL* cell  = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+        unsigned    spins = 0;
+
+        for (;;)
+        {
+            size_t sequence =
+                QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+            intptr_t difference =
+                (intptr_t) (sequence & ~QUEUE_FAA_BUSY) - (intptr_t) pos;
+
+            if (!difference)
+            {
+                if
+                (
+                    QUEUE_ATOMIC_CAS
+                    (
+                          &cell->sequence
+                        , &sequence
+                        , pos | QUEUE_FAA_BUSY
+                        , QUEUE_ORDER_ACQUIRE
+                        , QUEUE_ORDER_ACQUIRE
+                    )
+                )
+                {
+                    *claimed = cell;
+
+                    return Queue_Result_Ok;
+                }
+
+                // The consumer skipped this ticket.
+                QUEUE_STATS_P(queue, retries, 1);
+                break;
+            }
+
+            if (difference > 0)
+            {
+                QUEUE_STATS_P(queue, retries, 1);
+                break;
+            }
+
+            // The last lap's item is still there. Wait a moment if its
+            // consumer has a ticket, otherwise the queue is full. That ticket
+            // may be parked until some later dequeue, so after the wait give
+            // this ticket up and leave the retrying to the caller.
+            dequeue =
+                QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+            if ((intptr_t) (pos - dequeue) >= (intptr_t) cells)
+            {
+                QUEUE_STATS_P(queue, blocked, 1);
+                return Queue_Result_Full;
+            }
+
+            if (spins == QUEUE_FAA_SPINS)
+            {
+                QUEUE_STATS_P(queue, contention, 1);
+                return Queue_Result_Contention;
+            }
+
+            spins++;
+            QUEUE_PAUSE();
+        }
+    }
+}
+
+// Sets ticket pos aside in a free parked slot. Zero if they are all taken.
+static inline int QUEUE_FN(faa_park)(QUEUE_STRUCT* queue, size_t pos)
+{
+    // Counted first, so the count never reads less than the slots in use.
+    QUEUE_ATOMIC_FETCH_ADD(&queue->parked_count, 1, QUEUE_ORDER_RELAXED);
+
+    for (unsigned i = 0; i < QUEUE_FAA_PARKED; i++)
+    {
+        size_t free = 0;
+
+        if
+        (
+            QUEUE_ATOMIC_CAS
+            (
+                  &queue->parked[i]
+                , &free
+                , pos + 1
+                , QUEUE_ORDER_RELEASE
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            return 1;
+        }
+    }
+
+    QUEUE_ATOMIC_FETCH_SUB(&queue->parked_count, 1, QUEUE_ORDER_RELAXED);
+
+    return 0;
+}
+
+// Takes back a parked ticket whose cell is ready, or whose producer gave it up.
+static inline int QUEUE_FN(faa_unpark)(QUEUE_STRUCT* queue, size_t* pos)
+{
+    for (unsigned i = 0; i < QUEUE_FAA_PARKED; i++)
+    {
+        size_t parked =
+            QUEUE_ATOMIC_LOAD(&queue->parked[i], QUEUE_ORDER_RELAXED);
+
+        if (!parked)
+        {
+            continue;
+        }
+
+        QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, parked - 1)];
+
+        size_t sequence =
+            QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED);
+
+        if ((sequence != parked) && (sequence != (parked - 1)))
+        {
+            continue;
+        }
+
+        if
+        (
+            QUEUE_ATOMIC_CAS
+            (
+                  &queue->parked[i]
+                , &parked
+                , 0
+                , QUEUE_ORDER_ACQUIRE
+                , QUEUE_ORDER_RELAXED
+            )
+        )
+        {
+            QUEUE_ATOMIC_FETCH_SUB(&queue->parked_count, 1, QUEUE_ORDER_RELAXED);
+
+            *pos = parked - 1;
+
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Ok with the cell of ticket pos, or Contention once the ticket is skipped or
+// parked.
+static inline Queue_Result QUEUE_FN(faa_take)
+(
+      QUEUE_STRUCT* queue
+    , size_t        pos
+    , QUEUE_CELL**  claimed
+)
+{
+    size_t      cells = QUEUE_CELL_MASK(queue) + 1;
+    QUEUE_CELL* cell  = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+    unsigned    spins = 0;
+
+    for (;;)
+    {
+        size_t sequence =
+            QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+        if (sequence == (pos + 1))
+        {
+            *claimed = cell;
+
+            return Queue_Result_Ok;
+        }
+
+        if (sequence == pos)
+        {
+            // No producer yet. Give it a moment if it has a ticket, then
+            // skip the ticket so neither side waits on the other.
+            size_t enqueue =
+                QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+            if (((intptr_t) (enqueue - pos) > 0) && (spins < QUEUE_FAA_SPINS))
+            {
+                spins++;
+                QUEUE_PAUSE();
+
+                continue;
+            }
+
+            if
+            (
+                QUEUE_ATOMIC_CAS
+                (
+                      &cell->sequence
+                    , &sequence
+                    , pos + cells
+                    , QUEUE_ORDER_RELAXED
+                    , QUEUE_ORDER_RELAXED
+                )
+            )
+            {
+                QUEUE_STATS_C(queue, retries, 1);
+                return Queue_Result_Contention;
+            }
+
+            continue;
+        }
+
+        // The producer is writing, or the last lap is not done yet. The item
+        // can't be skipped, so after the same wait as above it is left to a
+        // later dequeue. With every parked slot taken there is nowhere to
+        // leave it and this keeps waiting.
+        if (spins < QUEUE_FAA_SPINS)
+        {
+            spins++;
+        }
+        else if (QUEUE_FN(faa_park)(queue, pos))
+        {
+            QUEUE_STATS_C(queue, contention, 1);
+            return Queue_Result_Contention;
+        }
+
+        QUEUE_PAUSE();
+    }
+}
+
+static inline Queue_Result QUEUE_FN(faa_claim_dequeue)
+(
+      QUEUE_STRUCT* queue
+    , QUEUE_CELL**  claimed
+)
+{
+    for (;;)
+    {
+        size_t pos;
+        size_t parked =
+            QUEUE_ATOMIC_LOAD(&queue->parked_count, QUEUE_ORDER_RELAXED);
+
+        if (parked && QUEUE_FN(faa_unpark)(queue, &pos))
+        {
+            if (QUEUE_FN(faa_take)(queue, pos, claimed) == Queue_Result_Ok)
+            {
+                return Queue_Result_Ok;
+            }
+
+            continue;
+        }
+
+        size_t dequeue =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+        size_t enqueue =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+        if ((intptr_t) (enqueue - dequeue) <= 0)
+        {
+            // Nothing new, but a parked ticket still has an item to come.
+            if (parked)
+            {
+                QUEUE_STATS_C(queue, contention, 1);
+                return Queue_Result_Contention;
+            }
+
+            QUEUE_STATS_C(queue, blocked, 1);
+            return QUEUE_EMPTY(queue, dequeue);
+        }
+
+        pos = QUEUE_ATOMIC_FETCH_ADD
+        (
+              &queue->dequeue_index
+            , 1
+            , QUEUE_ORDER_RELAXED
+        );
+
+        if (QUEUE_FN(faa_take)(queue, pos, claimed) == Queue_Result_Ok)
+        {
+            return Queue_Result_Ok;
+        }
+    }
+}
+
+Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+{
+    QUEUE_CELL* cell;
+
+    Queue_Result result = QUEUE_FN(faa_claim_enqueue)(queue, &cell);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    cell->data = *data;
+
+    QUEUE_FN(enqueue_commit)(queue, &cell->data);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    QUEUE_CELL* cell;
+
+    Queue_Result result = QUEUE_FN(faa_claim_dequeue)(queue, &cell);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    *data = cell->data;
+
+    QUEUE_FN(dequeue_release)(queue, &cell->data);
+
+    return Queue_Result_Ok;
+}
+
+// Every ticket is claimed on its own, so bulk calls are a loop.
+Queue_Result QUEUE_FN(try_enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+)
+{
+    Queue_Result result = Queue_Result_Ok;
+
+    *written = 0;
+
+    while (*written < count)
+    {
+        result = QUEUE_FN(try_enqueue)(queue, &data[*written]);
+
+        if (result != Queue_Result_Ok)
+        {
+            break;
+        }
+
+        (*written)++;
+    }
+
+    return *written ? Queue_Result_Ok : result;
+}
+
+Queue_Result QUEUE_FN(try_dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+)
+{
+    Queue_Result result = Queue_Result_Ok;
+
+    *read = 0;
+
+    while (*read < count)
+    {
+        result = QUEUE_FN(try_dequeue)(queue, &data[*read]);
+
+        if (result != Queue_Result_Ok)
+        {
+            break;
+        }
+
+        (*read)++;
+    }
+
+    return *read ? Queue_Result_Ok : result;
+}
+
+// A consumer that draws the ticket of a reserved or peeked cell parks it, and
+// the item waits for a later dequeue, so keep them short.
+Queue_Result QUEUE_FN(try_enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    QUEUE_CELL* cell;
+
+    Queue_Result result = QUEUE_FN(faa_claim_enqueue)(queue, &cell);
+
+    if (result == Queue_Result_Ok)
+    {
+        *data = &cell->data;
+    }
+
+    return result;
+}
+
+void QUEUE_FN(enqueue_commit)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) queue;
+
+    QUEUE_CELL* cell =
+        (QUEUE_CELL*) ((uint8_t*) data - offsetof(QUEUE_CELL, data));
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE
+    (
+          &cell->sequence
+        , (sequence & ~QUEUE_FAA_BUSY) + 1
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, (sequence & ~QUEUE_FAA_BUSY) + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+}
+
+Queue_Result QUEUE_FN(try_dequeue_peek)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    QUEUE_CELL* cell;
+
+    Queue_Result result = QUEUE_FN(faa_claim_dequeue)(queue, &cell);
+
+    if (result == Queue_Result_Ok)
+    {
+        *data = &cell->data;
+    }
+
+    return result;
+}
+
+void QUEUE_FN(dequeue_release)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) queue;
+
+    QUEUE_CELL* cell =
+        (QUEUE_CELL*) ((uint8_t*) data - offsetof(QUEUE_CELL, data));
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE
+    (
+          &cell->sequence
+        , sequence + QUEUE_CELL_MASK(queue)
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_C(queue, ok, 1);
+    QUEUE_STATS_PEAK_C(queue, sequence - 1);
+
+    QUEUE_SIGNAL_NOT_FULL(queue);
+}
+
+#else
+
+Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+{
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =    
+        QUEUE_P_LOAD(queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+    intptr_t difference = (intptr_t) sequence - (intptr_t) pos;
+
+    if (!difference)
+    {
+        QUEUE_P_IF_CAS
+        (
+              queue->enqueue_index
+            , pos
+            , pos + 1
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+        {
+            cell->data = *data;
+
+            QUEUE_ATOMIC_STORE
+            (
+                  &cell->sequence
+                , pos + 1
+                , QUEUE_ORDER_RELEASE
+            );
+
+            QUEUE_STATS_P(queue, ok, 1);
+            QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+            QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+            return Queue_Result_Ok;
+        }
+    }
+
+    if (difference < 0)
+    {
+        QUEUE_STATS_P(queue, blocked, 1);
+        return Queue_Result_Full;
+    }
+
+    QUEUE_STATS_P(queue, contention, 1);
+    QUEUE_STATS_P(queue, retries, !difference);
+    return Queue_Result_Contention;
+}
+
+Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    size_t pos =
+        QUEUE_C_LOAD(queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+    intptr_t difference = (intptr_t) sequence - (intptr_t)(pos + 1);
+
+    if (!difference)
+    {
+        QUEUE_C_IF_CAS
+        (
+              queue->dequeue_index
+            , pos
+            , pos + 1
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+        {
+            *data = cell->data;
+
+            QUEUE_ATOMIC_STORE
+            (
+                  &cell->sequence
+                , pos + QUEUE_CELL_MASK(queue) + 1
+                , QUEUE_ORDER_RELEASE
+            );
+
+            QUEUE_STATS_C(queue, ok, 1);
+            QUEUE_STATS_PEAK_C(queue, pos);
+
+            QUEUE_SIGNAL_NOT_FULL(queue);
+
+            return Queue_Result_Ok;
+        }
+    }
+
+    if (difference < 0)
+    {
+        QUEUE_STATS_C(queue, blocked, 1);
+        return QUEUE_EMPTY(queue, pos);
+    }
+
+    QUEUE_STATS_C(queue, contention, 1);
+    QUEUE_STATS_C(queue, retries, !difference);
+    return Queue_Result_Contention;
+}
+
+Queue_Result QUEUE_FN(try_enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+)
+{
+    QUEUE_CLOSED_CHECK_BULK(queue, written);
+
+    size_t pos =
+        QUEUE_P_LOAD(queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    size_t   to_write   = 0;
+    intptr_t difference = 0;
+
+    *written = 0;
+
+    while (to_write < count)
+    {
+        QUEUE_CELL* cell =
+            &queue->cells[QUEUE_CELL_INDEX(queue, pos + to_write)];
+
+        size_t sequence =
+            QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+        difference = (intptr_t) sequence - (intptr_t)(pos + to_write);
+
+        if (difference)
+        {
+            break;
+        }
+
+        to_write++;
+    }
+
+    if (!count)
+    {
+        return Queue_Result_Ok;
+    }
+
+    if (to_write)
+    {
+        QUEUE_P_IF_CAS
+        (
+              queue->enqueue_index
+            , pos
+            , pos + to_write
+            , QUEUE_ORDER_RELAXED
+            , QUEUE_ORDER_RELAXED
+        )
+        {
+            for (size_t i = 0; i < to_write; i++)
+            {
+                QUEUE_CELL* cell =
+                    &queue->cells[QUEUE_CELL_INDEX(queue, pos + i)];
+
+                cell->data = data[i];
+
+                QUEUE_ATOMIC_STORE
+                (
+                      &cell->sequence
+                    , pos + i + 1
+                    , QUEUE_ORDER_RELEASE
+                );
+            }
+
+            *written = to_write;
+
+            QUEUE_STATS_P(queue, ok, to_write);
+            QUEUE_STATS_PEAK_P(queue, pos + to_write);
+
+            QUEUE_SIGNAL_NOT_EMPTY(queue);
+
+            return Queue_Result_Ok;
+        }
+
+        QUEUE_STATS_P(queue, contention, 1);
+        QUEUE_STATS_P(queue, retries, 1);
+        return Queue_Result_Contention;
     }
 
-    if (*bytes < bytes_local)
+    if (difference < 0)
     {
-        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+        QUEUE_STATS_P(queue, blocked, 1);
+        return Queue_Result_Full;
     }
 
+    QUEUE_STATS_P(queue, contention, 1);
+    return Queue_Result_Contention;
+}
+
+Queue_Result QUEUE_FN(try_dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+)
+{
+    size_t pos =
+        QUEUE_C_LOAD(queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    size_t   to_read    = 0;
+    intptr_t difference = 0;
+
+    *read = 0;
+
+    while (to_read < count)
     {
-        intptr_t queue_value = (intptr_t) queue;
+        QUEUE_CELL* cell =
+            &queue->cells[QUEUE_CELL_INDEX(queue, pos + to_read)];
 
-        if (queue_value & 0x0F)
+        size_t sequence =
+            QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
+
+        difference = (intptr_t) sequence - (intptr_t)(pos + to_read + 1);
+
+        if (difference)
         {
-            return Queue_Result_Error_Not_Aligned_16_Bytes;
+            break;
         }
-    }
 
-    memset(queue, 0, bytes_local);
+        to_read++;
+    }
 
-    queue->cell_mask = cell_count - 1;
+    if (!count)
+    {
+        return Queue_Result_Ok;
+    }
 
-    for (size_t i = 0; i < cell_count; i++)
+    if (to_read)
     {
-        QUEUE_ATOMIC_STORE
+        QUEUE_C_IF_CAS
         (
-              &queue->cells[i].sequence
-            , i
+              queue->dequeue_index
+            , pos
+            , pos + to_read
             , QUEUE_ORDER_RELAXED
-        );
+            , QUEUE_ORDER_RELAXED
+        )
+        {
+            for (size_t i = 0; i < to_read; i++)
+            {
+                QUEUE_CELL* cell =
+                    &queue->cells[QUEUE_CELL_INDEX(queue, pos + i)];
+
+                data[i] = cell->data;
+
+                QUEUE_ATOMIC_STORE
+                (
+                      &cell->sequence
+                    , pos + i + QUEUE_CELL_MASK(queue) + 1
+                    , QUEUE_ORDER_RELEASE
+                );
+            }
+
+            *read = to_read;
+
+            QUEUE_STATS_C(queue, ok, to_read);
+            QUEUE_STATS_PEAK_C(queue, pos);
+
+            QUEUE_SIGNAL_NOT_FULL(queue);
+
+            return Queue_Result_Ok;
+        }
+
+        QUEUE_STATS_C(queue, contention, 1);
+        QUEUE_STATS_C(queue, retries, 1);
+        return Queue_Result_Contention;
     }
 
-    QUEUE_P_SETUP(queue->enqueue_index, 0, QUEUE_ORDER_RELAXED);
-    QUEUE_C_SETUP(queue->dequeue_index, 0, QUEUE_ORDER_RELAXED);
+    if (difference < 0)
+    {
+        QUEUE_STATS_C(queue, blocked, 1);
+        return QUEUE_EMPTY(queue, pos);
+    }
 
-    return Queue_Result_Ok;
+    QUEUE_STATS_C(queue, contention, 1);
+    return Queue_Result_Contention;
 }
 
-Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+Queue_Result QUEUE_FN(try_enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
 {
-    size_t pos =    
+    QUEUE_CLOSED_CHECK(queue);
+
+    size_t pos =
         QUEUE_P_LOAD(queue->enqueue_index, QUEUE_ORDER_RELAXED);
 
-    QUEUE_CELL* cell = &queue->cells[pos & queue->cell_mask];
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
 
     size_t sequence =
         QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
@@ -293,14 +3217,7 @@ Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
             , QUEUE_ORDER_RELAXED
         )
         {
-            cell->data = *data;
-
-            QUEUE_ATOMIC_STORE
-            (
-                  &cell->sequence
-                , pos + 1
-                , QUEUE_ORDER_RELEASE
-            );
+            *data = &cell->data;
 
             return Queue_Result_Ok;
         }
@@ -308,18 +3225,45 @@ Queue_Result QUEUE_FN(try_enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
 
     if (difference < 0)
     {
+        QUEUE_STATS_P(queue, blocked, 1);
         return Queue_Result_Full;
     }
 
+    QUEUE_STATS_P(queue, contention, 1);
+    QUEUE_STATS_P(queue, retries, !difference);
     return Queue_Result_Contention;
 }
 
-Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+void QUEUE_FN(enqueue_commit)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) queue;
+
+    // Until it is committed the cell's sequence is still the claimed position.
+    QUEUE_CELL* cell =
+        (QUEUE_CELL*) ((uint8_t*) data - offsetof(QUEUE_CELL, data));
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE
+    (
+          &cell->sequence
+        , pos + 1
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_P(queue, ok, 1);
+    QUEUE_STATS_PEAK_P(queue, pos + 1);
+
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+}
+
+Queue_Result QUEUE_FN(try_dequeue_peek)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
 {
     size_t pos =
         QUEUE_C_LOAD(queue->dequeue_index, QUEUE_ORDER_RELAXED);
 
-    QUEUE_CELL* cell = &queue->cells[pos & queue->cell_mask];
+    QUEUE_CELL* cell = &queue->cells[QUEUE_CELL_INDEX(queue, pos)];
 
     size_t sequence =
         QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_ACQUIRE);
@@ -337,14 +3281,7 @@ Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
             , QUEUE_ORDER_RELAXED
         )
         {
-            *data = cell->data;
-
-            QUEUE_ATOMIC_STORE
-            (
-                  &cell->sequence
-                , pos + queue->cell_mask + 1
-                , QUEUE_ORDER_RELEASE
-            );
+            *data = &cell->data;
 
             return Queue_Result_Ok;
         }
@@ -352,12 +3289,42 @@ Queue_Result QUEUE_FN(try_dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
 
     if (difference < 0)
     {
-        return Queue_Result_Empty;
+        QUEUE_STATS_C(queue, blocked, 1);
+        return QUEUE_EMPTY(queue, pos);
     }
 
+    QUEUE_STATS_C(queue, contention, 1);
+    QUEUE_STATS_C(queue, retries, !difference);
     return Queue_Result_Contention;
 }
 
+void QUEUE_FN(dequeue_release)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    (void) queue;
+
+    // Until it is released the cell's sequence is still the claimed position
+    // plus one.
+    QUEUE_CELL* cell =
+        (QUEUE_CELL*) ((uint8_t*) data - offsetof(QUEUE_CELL, data));
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(&cell->sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE
+    (
+          &cell->sequence
+        , sequence + QUEUE_CELL_MASK(queue)
+        , QUEUE_ORDER_RELEASE
+    );
+
+    QUEUE_STATS_C(queue, ok, 1);
+    QUEUE_STATS_PEAK_C(queue, sequence - 1);
+
+    QUEUE_SIGNAL_NOT_FULL(queue);
+}
+
+#endif
+
 Queue_Result QUEUE_FN(enqueue)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
 {
     Queue_Result result;
@@ -383,6 +3350,293 @@ Queue_Result QUEUE_FN(dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
 
     return result;
 }
+
+Queue_Result QUEUE_FN(enqueue_reserve)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_FN(try_enqueue_reserve)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+#if !defined(QUEUE_OVERWRITE)
+Queue_Result QUEUE_FN(dequeue_peek)(QUEUE_STRUCT* queue, QUEUE_TYPE** data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_FN(try_dequeue_peek)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+#endif
+
+Queue_Result QUEUE_FN(enqueue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , size_t            count
+    , size_t*           written
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_FN(try_enqueue_bulk)(queue, data, count, written);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_FN(dequeue_bulk)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , size_t            count
+    , size_t*           read
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_FN(try_dequeue_bulk)(queue, data, count, read);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+#if defined(QUEUE_NOTIFY)
+static inline Queue_Notifier* QUEUE_FN(notifier)
+(
+      QUEUE_STRUCT* queue
+    , Queue_Notify  which
+)
+{
+    return (which == Queue_Notify_Not_Full)
+        ? &queue->notify_not_full
+        : &queue->notify_not_empty;
+}
+
+Queue_Result QUEUE_FN(notify_open)(QUEUE_STRUCT* queue)
+{
+    Queue_Result result = queue_notifier_open(&queue->notify_not_empty);
+
+    if (result == Queue_Result_Ok)
+    {
+        result = queue_notifier_open(&queue->notify_not_full);
+
+        if (result != Queue_Result_Ok)
+        {
+            queue_notifier_close(&queue->notify_not_empty);
+        }
+    }
+
+    return result;
+}
+
+void QUEUE_FN(notify_close)(QUEUE_STRUCT* queue)
+{
+    queue_notifier_close(&queue->notify_not_empty);
+    queue_notifier_close(&queue->notify_not_full);
+}
+
+int QUEUE_FN(get_fd)(QUEUE_STRUCT* queue, Queue_Notify which)
+{
+    return QUEUE_FN(notifier)(queue, which)->fd;
+}
+
+void QUEUE_FN(notify_arm)(QUEUE_STRUCT* queue, Queue_Notify which)
+{
+    queue_notifier_arm(QUEUE_FN(notifier)(queue, which));
+}
+
+Queue_Result QUEUE_FN(notify_clear)(QUEUE_STRUCT* queue, Queue_Notify which)
+{
+    return queue_notifier_clear(QUEUE_FN(notifier)(queue, which));
+}
+#endif
+
+#if defined(QUEUE_CLOSE)
+void QUEUE_FN(close)(QUEUE_STRUCT* queue)
+{
+    if (QUEUE_ATOMIC_LOAD(&queue->closed, QUEUE_ORDER_RELAXED))
+    {
+        return;
+    }
+
+#if QUEUE_SPSC
+    size_t end = QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+#else
+    size_t end = QUEUE_P_LOAD(queue->enqueue_index, QUEUE_ORDER_RELAXED);
+#endif
+
+    QUEUE_ATOMIC_STORE(&queue->closed_at, end, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->closed,    1,   QUEUE_ORDER_RELEASE);
+
+    // Both sides, so blocked producers see Closed too.
+    QUEUE_SIGNAL_NOT_EMPTY(queue);
+    QUEUE_SIGNAL_NOT_FULL(queue);
+}
+
+int QUEUE_FN(is_closed)(QUEUE_STRUCT* queue)
+{
+    return QUEUE_ATOMIC_LOAD(&queue->closed, QUEUE_ORDER_ACQUIRE) != 0;
+}
+#endif
+
+#if defined(QUEUE_SELECT)
+Queue_Set_Link* QUEUE_FN(set_link)(QUEUE_STRUCT* queue)
+{
+    return &queue->set_link;
+}
+#endif
+
+#if defined(QUEUE_STATS)
+void QUEUE_FN(get_stats)(QUEUE_STRUCT* queue, Queue_Stats* stats)
+{
+    Queue_Stats_Counters* p = &queue->enqueue_stats;
+    Queue_Stats_Counters* c = &queue->dequeue_stats;
+
+    stats->enqueue_ok         = queue_stats_load(&p->ok);
+    stats->enqueue_full       = queue_stats_load(&p->blocked);
+    stats->enqueue_contention = queue_stats_load(&p->contention);
+    stats->enqueue_retries    = queue_stats_load(&p->retries);
+
+    stats->dequeue_ok         = queue_stats_load(&c->ok);
+    stats->dequeue_empty      = queue_stats_load(&c->blocked);
+    stats->dequeue_contention = queue_stats_load(&c->contention);
+    stats->dequeue_retries    = queue_stats_load(&c->retries);
+
+    uint64_t peak_p = queue_stats_load(&p->peak);
+    uint64_t peak_c = queue_stats_load(&c->peak);
+
+    stats->peak_occupancy = (peak_p > peak_c) ? peak_p : peak_c;
+}
+#endif
+
+#if defined(QUEUE_WAIT)
+Queue_Result QUEUE_FN(enqueue_wait_timed)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE const* data
+    , uint64_t          timeout_ns
+)
+{
+    Queue_Wait wait;
+
+    queue_wait_start(&wait, timeout_ns);
+
+    for (;;)
+    {
+        Queue_Result result = QUEUE_FN(try_enqueue)(queue, data);
+
+        if (result == Queue_Result_Full)
+        {
+            Queue_Wait_Step step = queue_wait_backoff(&wait);
+
+            if (step == Queue_Wait_Step_Timeout)
+            {
+                return Queue_Result_Timeout;
+            }
+
+            if (step == Queue_Wait_Step_Park)
+            {
+                uint32_t epoch = queue_event_prepare(&queue->not_full);
+
+                result = QUEUE_FN(try_enqueue)(queue, data);
+
+                if (result == Queue_Result_Full)
+                {
+                    queue_event_park(&queue->not_full, epoch, &wait);
+                }
+
+                queue_event_cancel(&queue->not_full);
+            }
+        }
+
+        if
+        (
+               (result != Queue_Result_Full)
+            && (result != Queue_Result_Contention)
+        )
+        {
+            return result;
+        }
+    }
+}
+
+Queue_Result QUEUE_FN(dequeue_wait_timed)
+(
+      QUEUE_STRUCT*     queue
+    , QUEUE_TYPE*       data
+    , uint64_t          timeout_ns
+)
+{
+    Queue_Wait wait;
+
+    queue_wait_start(&wait, timeout_ns);
+
+    for (;;)
+    {
+        Queue_Result result = QUEUE_FN(try_dequeue)(queue, data);
+
+        if (result == Queue_Result_Empty)
+        {
+            Queue_Wait_Step step = queue_wait_backoff(&wait);
+
+            if (step == Queue_Wait_Step_Timeout)
+            {
+                return Queue_Result_Timeout;
+            }
+
+            if (step == Queue_Wait_Step_Park)
+            {
+                uint32_t epoch = queue_event_prepare(&queue->not_empty);
+
+                result = QUEUE_FN(try_dequeue)(queue, data);
+
+                if (result == Queue_Result_Empty)
+                {
+                    queue_event_park(&queue->not_empty, epoch, &wait);
+                }
+
+                queue_event_cancel(&queue->not_empty);
+            }
+        }
+
+        if
+        (
+               (result != Queue_Result_Empty)
+            && (result != Queue_Result_Contention)
+        )
+        {
+            return result;
+        }
+    }
+}
+
+Queue_Result QUEUE_FN(enqueue_wait)(QUEUE_STRUCT* queue, QUEUE_TYPE const* data)
+{
+    return QUEUE_FN(enqueue_wait_timed)(queue, data, QUEUE_WAIT_FOREVER);
+}
+
+Queue_Result QUEUE_FN(dequeue_wait)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
+{
+    return QUEUE_FN(dequeue_wait_timed)(queue, data, QUEUE_WAIT_FOREVER);
+}
+#endif
 #endif
 
 #ifdef __cplusplus
@@ -392,6 +3646,16 @@ Queue_Result QUEUE_FN(dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
 #undef QUEUE_TYPE
 #undef QUEUE_MP
 #undef QUEUE_MC
+#undef QUEUE_WAIT
+#undef QUEUE_CELL_LAYOUT_SPREAD
+#undef QUEUE_CAPACITY
+#undef QUEUE_MPMC_ENGINE_FAA
+#undef QUEUE_STATS
+#undef QUEUE_SHM
+#undef QUEUE_OVERWRITE
+#undef QUEUE_NOTIFY
+#undef QUEUE_SELECT
+#undef QUEUE_CLOSE
 
 #undef QUEUE_P_NAME_FN
 #undef QUEUE_P_NAME_TYPE
@@ -407,10 +3671,45 @@ Queue_Result QUEUE_FN(dequeue)(QUEUE_STRUCT* queue, QUEUE_TYPE* data)
 #undef QUEUE_C_LOAD
 #undef QUEUE_C_IF_CAS
 
+#undef QUEUE_SPSC
+#undef QUEUE_FAA
+#undef QUEUE_FAA_BUSY
+#undef QUEUE_FAA_PARKED
+#undef QUEUE_SIGNAL_NOT_EMPTY
+#undef QUEUE_SIGNAL_NOT_FULL
+#undef QUEUE_SIGNAL_FENCE_NOT_EMPTY
+#undef QUEUE_SIGNAL_FENCE_NOT_FULL
+#undef QUEUE_WAKE_NOT_EMPTY
+#undef QUEUE_WAKE_NOT_FULL
+#undef QUEUE_NOTIFY_NOT_EMPTY
+#undef QUEUE_NOTIFY_NOT_FULL
+#undef QUEUE_SELECT_NOT_EMPTY
+#undef QUEUE_CLOSED_CHECK
+#undef QUEUE_CLOSED_CHECK_BULK
+#undef QUEUE_EMPTY
+#undef QUEUE_STATS_P
+#undef QUEUE_STATS_C
+#undef QUEUE_STATS_PEAK_P
+#undef QUEUE_STATS_PEAK_C
+#undef QUEUE_CELL_INDEX
+#undef QUEUE_CELL_DATA_AT
+#undef QUEUE_CELL_PACKED
+#undef QUEUE_CELL_STRIDE
+#undef QUEUE_SPREAD_BITS
+#undef QUEUE_SPREAD_MASK_FOR
+#undef QUEUE_SPREAD_MASK
+#undef QUEUE_CELL_MASK
+#undef QUEUE_PAD0
+#undef QUEUE_CELLS
+#undef QUEUE_NAME
+
 #undef QUEUE_FN_A
+#undef QUEUE_FN_B
 #undef QUEUE_FN
 #undef QUEUE_STRUCT_A
 #undef QUEUE_STRUCT_B
 #undef QUEUE_STRUCT_C
 #undef QUEUE_STRUCT
 #undef QUEUE_CELL
+
+#endif // QUEUE_ERASED
@@ -0,0 +1,1145 @@
+// One compiled copy of the queue per flavour for items of any type, with the
+// item size and alignment given to make_queue. For programs with many item
+// types, where a copy of the code per QUEUE_TYPE costs instruction cache.
+//
+// Define QUEUE_MP, QUEUE_MC and optionally QUEUE_IMPLEMENTATION, then include.
+// Names end in _Any, eg: mpsc_try_enqueue_Any. Items are copied in and out
+// with a memcpy of the item size.
+//
+// amblaq/queues.h with QUEUE_ERASED defined includes this too, to get the
+// usual typed names as inline wrappers over the _Any functions. Those still
+// need QUEUE_IMPLEMENTATION here, once per flavour, in one c file.
+
+#if !defined(QUEUE_MP) || !defined(QUEUE_MC)
+    #error Please define QUEUE_MP and QUEUE_MC
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_ANY_DEFINED)
+
+    #define QUEUE_ANY_DEFINED
+
+    // Queues are only 16 byte aligned, so items can't ask for more.
+    #define QUEUE_ANY_ALIGN_MAX 16
+#endif
+
+#if (QUEUE_MP) && (QUEUE_MC)
+    #define QUEUE_ANY_PREFIX      mpmc_
+    #define QUEUE_ANY_STRUCT_BASE Queue_Mpmc_
+#elif (QUEUE_MP)
+    #define QUEUE_ANY_PREFIX      mpsc_
+    #define QUEUE_ANY_STRUCT_BASE Queue_Mpsc_
+#elif (QUEUE_MC)
+    #define QUEUE_ANY_PREFIX      spmc_
+    #define QUEUE_ANY_STRUCT_BASE Queue_Spmc_
+#else
+    #define QUEUE_ANY_PREFIX      spsc_
+    #define QUEUE_ANY_STRUCT_BASE Queue_Spsc_
+#endif
+
+#define QUEUE_ANY_FN(name) QUEUE_MERGE(QUEUE_ANY_PREFIX, QUEUE_MERGE(name, _Any))
+#define QUEUE_ANY_STRUCT   QUEUE_MERGE(QUEUE_ANY_STRUCT_BASE, Any)
+#define QUEUE_ANY_SPSC     (!(QUEUE_MP) && !(QUEUE_MC))
+
+#if (QUEUE_MP)
+    #define QUEUE_ANY_P_IF_CAS(a, b, c)                                        \
+        if                                                                     \
+        (                                                                      \
+            atomic_compare_exchange_weak_explicit                              \
+            (                                                                  \
+                  &a                                                           \
+                , &b                                                           \
+                , c                                                            \
+                , QUEUE_ORDER_RELAXED                                          \
+                , QUEUE_ORDER_RELAXED                                          \
+            )                                                                  \
+        )
+#else
+    #define QUEUE_ANY_P_IF_CAS(a, b, c)                                        \
+        QUEUE_ATOMIC_STORE(&a, c, QUEUE_ORDER_RELAXED);
+#endif
+
+#if (QUEUE_MC)
+    #define QUEUE_ANY_C_IF_CAS(a, b, c)                                        \
+        if                                                                     \
+        (                                                                      \
+            atomic_compare_exchange_weak_explicit                              \
+            (                                                                  \
+                  &a                                                           \
+                , &b                                                           \
+                , c                                                            \
+                , QUEUE_ORDER_RELAXED                                          \
+                , QUEUE_ORDER_RELAXED                                          \
+            )                                                                  \
+        )
+#else
+    #define QUEUE_ANY_C_IF_CAS(a, b, c)                                        \
+        QUEUE_ATOMIC_STORE(&a, c, QUEUE_ORDER_RELAXED);
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_ANY_STRUCT QUEUE_ANY_STRUCT;
+
+// As make_queue in queues.h, plus the item's size and alignment (sizeof and
+// alignof). The alignment is a power of 2 and at most QUEUE_ANY_ALIGN_MAX,
+// otherwise Queue_Result_Error_Not_Pow2 or Queue_Result_Error_Too_Big.
+Queue_Result QUEUE_ANY_FN(make_queue)
+(
+      size_t            item_bytes
+    , size_t            item_align
+    , size_t            cell_count
+    , QUEUE_ANY_STRUCT* queue
+    , size_t*           bytes
+);
+
+// The rest work like their typed versions in queues.h, with items item_bytes
+// long and bulk data a packed array of them.
+Queue_Result QUEUE_ANY_FN(try_enqueue)(QUEUE_ANY_STRUCT* queue, void const* data);
+Queue_Result QUEUE_ANY_FN(try_dequeue)(QUEUE_ANY_STRUCT* queue, void*       data);
+Queue_Result QUEUE_ANY_FN(enqueue)    (QUEUE_ANY_STRUCT* queue, void const* data);
+Queue_Result QUEUE_ANY_FN(dequeue)    (QUEUE_ANY_STRUCT* queue, void*       data);
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void const*       data
+    , size_t            count
+    , size_t*           written
+);
+
+Queue_Result QUEUE_ANY_FN(try_dequeue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void*             data
+    , size_t            count
+    , size_t*           read
+);
+
+Queue_Result QUEUE_ANY_FN(enqueue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void const*       data
+    , size_t            count
+    , size_t*           written
+);
+
+Queue_Result QUEUE_ANY_FN(dequeue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void*             data
+    , size_t            count
+    , size_t*           read
+);
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_reserve)(QUEUE_ANY_STRUCT* queue, void** data);
+Queue_Result QUEUE_ANY_FN(enqueue_reserve)    (QUEUE_ANY_STRUCT* queue, void** data);
+Queue_Result QUEUE_ANY_FN(try_dequeue_peek)   (QUEUE_ANY_STRUCT* queue, void** data);
+Queue_Result QUEUE_ANY_FN(dequeue_peek)       (QUEUE_ANY_STRUCT* queue, void** data);
+
+void QUEUE_ANY_FN(enqueue_commit) (QUEUE_ANY_STRUCT* queue, void* data);
+void QUEUE_ANY_FN(dequeue_release)(QUEUE_ANY_STRUCT* queue, void* data);
+
+size_t QUEUE_ANY_FN(item_bytes)(QUEUE_ANY_STRUCT* queue);
+
+// -----------------------------------------------------------------------------
+// Typed wrappers, for amblaq/queues.h with QUEUE_ERASED
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_ERASED)
+
+#if !defined(QUEUE_TYPE)
+    #error QUEUE_ERASED is for amblaq/queues.h, which needs QUEUE_TYPE
+#endif
+
+#if    defined(QUEUE_WAIT)                                                     \
+    || defined(QUEUE_CELL_LAYOUT_SPREAD)                                       \
+    || defined(QUEUE_CAPACITY)                                                 \
+    || defined(QUEUE_MPMC_ENGINE_FAA)                                          \
+    || defined(QUEUE_STATS)                                                    \
+    || defined(QUEUE_SHM)                                                      \
+    || defined(QUEUE_OVERWRITE)                                                \
+    || defined(QUEUE_NOTIFY)                                                   \
+    || defined(QUEUE_SELECT)                                                   \
+    || defined(QUEUE_CLOSE)
+    #error QUEUE_ERASED does not work with any other QUEUE_ option
+#endif
+
+#define QUEUE_ANY_TYPED_FN(name)                                               \
+    QUEUE_MERGE(QUEUE_ANY_PREFIX, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_ANY_TYPED_STRUCT QUEUE_MERGE(QUEUE_ANY_STRUCT_BASE, QUEUE_TYPE)
+
+#define QUEUE_ANY_CAST(q) ((QUEUE_ANY_STRUCT*) (void*) (q))
+
+// Only ever a pointer to the _Any queue.
+typedef struct QUEUE_ANY_TYPED_STRUCT QUEUE_ANY_TYPED_STRUCT;
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(make_queue)
+(
+      size_t                  cell_count
+    , QUEUE_ANY_TYPED_STRUCT* queue
+    , size_t*                 bytes
+)
+{
+    return QUEUE_ANY_FN(make_queue)
+    (
+          sizeof(QUEUE_TYPE)
+        , QUEUE_ALIGNOF(QUEUE_TYPE)
+        , cell_count
+        , QUEUE_ANY_CAST(queue)
+        , bytes
+    );
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_enqueue)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+)
+{
+    return QUEUE_ANY_FN(try_enqueue)(QUEUE_ANY_CAST(queue), data);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_dequeue)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+)
+{
+    return QUEUE_ANY_FN(try_dequeue)(QUEUE_ANY_CAST(queue), data);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(enqueue)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+)
+{
+    return QUEUE_ANY_FN(enqueue)(QUEUE_ANY_CAST(queue), data);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(dequeue)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+)
+{
+    return QUEUE_ANY_FN(dequeue)(QUEUE_ANY_CAST(queue), data);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_enqueue_bulk)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+    , size_t                  count
+    , size_t*                 written
+)
+{
+    return QUEUE_ANY_FN(try_enqueue_bulk)
+    (
+          QUEUE_ANY_CAST(queue)
+        , data
+        , count
+        , written
+    );
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_dequeue_bulk)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+    , size_t                  count
+    , size_t*                 read
+)
+{
+    return QUEUE_ANY_FN(try_dequeue_bulk)(QUEUE_ANY_CAST(queue), data, count, read);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(enqueue_bulk)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+    , size_t                  count
+    , size_t*                 written
+)
+{
+    return QUEUE_ANY_FN(enqueue_bulk)(QUEUE_ANY_CAST(queue), data, count, written);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(dequeue_bulk)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+    , size_t                  count
+    , size_t*                 read
+)
+{
+    return QUEUE_ANY_FN(dequeue_bulk)(QUEUE_ANY_CAST(queue), data, count, read);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_enqueue_reserve)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE**            data
+)
+{
+    void* cell = NULL;
+
+    Queue_Result result =
+        QUEUE_ANY_FN(try_enqueue_reserve)(QUEUE_ANY_CAST(queue), &cell);
+
+    *data = (QUEUE_TYPE*) cell;
+
+    return result;
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(enqueue_reserve)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE**            data
+)
+{
+    void* cell = NULL;
+
+    Queue_Result result =
+        QUEUE_ANY_FN(enqueue_reserve)(QUEUE_ANY_CAST(queue), &cell);
+
+    *data = (QUEUE_TYPE*) cell;
+
+    return result;
+}
+
+static inline void QUEUE_ANY_TYPED_FN(enqueue_commit)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+)
+{
+    QUEUE_ANY_FN(enqueue_commit)(QUEUE_ANY_CAST(queue), data);
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(try_dequeue_peek)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE**            data
+)
+{
+    void* cell = NULL;
+
+    Queue_Result result =
+        QUEUE_ANY_FN(try_dequeue_peek)(QUEUE_ANY_CAST(queue), &cell);
+
+    *data = (QUEUE_TYPE*) cell;
+
+    return result;
+}
+
+static inline Queue_Result QUEUE_ANY_TYPED_FN(dequeue_peek)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE**            data
+)
+{
+    void* cell = NULL;
+
+    Queue_Result result =
+        QUEUE_ANY_FN(dequeue_peek)(QUEUE_ANY_CAST(queue), &cell);
+
+    *data = (QUEUE_TYPE*) cell;
+
+    return result;
+}
+
+static inline void QUEUE_ANY_TYPED_FN(dequeue_release)
+(
+      QUEUE_ANY_TYPED_STRUCT* queue
+    , QUEUE_TYPE*             data
+)
+{
+    QUEUE_ANY_FN(dequeue_release)(QUEUE_ANY_CAST(queue), data);
+}
+
+#undef QUEUE_ANY_TYPED_FN
+#undef QUEUE_ANY_TYPED_STRUCT
+#undef QUEUE_ANY_CAST
+
+#endif // QUEUE_ERASED
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION) && !defined(QUEUE_ERASED)
+
+// Items sit at item_offset in cells cell_bytes apart, after the cell's
+// sequence when there is one. The same layout the typed queues get from the
+// compiler for their cell structs.
+typedef struct QUEUE_ANY_STRUCT
+{
+    uint8_t             pad0[QUEUE_CACHELINE_BYTES];
+
+    QUEUE_ATOMIC_SIZE_T enqueue_index;
+    uint8_t             pad1[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    QUEUE_ATOMIC_SIZE_T dequeue_index;
+    uint8_t             pad2[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+#if QUEUE_ANY_SPSC
+    size_t              dequeue_index_cached;
+    uint8_t             pad3[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    size_t              enqueue_index_cached;
+    uint8_t             pad4[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+#endif
+
+    size_t              cell_mask;
+    size_t              cell_bytes;
+    size_t              item_offset;
+    size_t              item_bytes;
+    uint8_t             pad5[QUEUE_CACHELINE_BYTES - (4 * sizeof(size_t))];
+
+    uint8_t             cells[];
+}
+QUEUE_ANY_STRUCT;
+
+static inline uint8_t* QUEUE_ANY_FN(cell)(QUEUE_ANY_STRUCT* queue, size_t pos)
+{
+    return &queue->cells[(pos & queue->cell_mask) * queue->cell_bytes];
+}
+
+static inline void* QUEUE_ANY_FN(item)(QUEUE_ANY_STRUCT* queue, size_t pos)
+{
+    return QUEUE_ANY_FN(cell)(queue, pos) + queue->item_offset;
+}
+
+#if !QUEUE_ANY_SPSC
+static inline QUEUE_ATOMIC_SIZE_T* QUEUE_ANY_FN(sequence)(uint8_t* cell)
+{
+    return (QUEUE_ATOMIC_SIZE_T*) (void*) cell;
+}
+#endif
+
+Queue_Result QUEUE_ANY_FN(make_queue)
+(
+      size_t            item_bytes
+    , size_t            item_align
+    , size_t            cell_count
+    , QUEUE_ANY_STRUCT* queue
+    , size_t*           bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (!item_bytes || (cell_count < 2))
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    if
+    (
+           (item_bytes > QUEUE_TOO_BIG)
+        || (cell_count > QUEUE_TOO_BIG)
+        || (item_align > QUEUE_ANY_ALIGN_MAX)
+    )
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    if
+    (
+           !item_align
+        || (item_align & (item_align - 1))
+        || (cell_count & (cell_count - 1))
+    )
+    {
+        return Queue_Result_Error_Not_Pow2;
+    }
+
+#if QUEUE_ANY_SPSC
+    size_t cell_align  = item_align;
+    size_t item_offset = 0;
+#else
+    size_t cell_align  =
+        (item_align > sizeof(QUEUE_ATOMIC_SIZE_T))
+            ? item_align
+            : sizeof(QUEUE_ATOMIC_SIZE_T);
+
+    size_t item_offset =
+          (sizeof(QUEUE_ATOMIC_SIZE_T) + item_align - 1)
+        & ~(item_align - 1);
+#endif
+
+    size_t cell_bytes =
+          (item_offset + item_bytes + cell_align - 1)
+        & ~(cell_align - 1);
+
+    if (cell_count > ((SIZE_MAX - sizeof(QUEUE_ANY_STRUCT)) / cell_bytes))
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t bytes_local =
+          sizeof(QUEUE_ANY_STRUCT)
+        + (cell_bytes * cell_count);
+
+    if (!queue)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, bytes_local);
+
+    queue->cell_mask   = cell_count - 1;
+    queue->cell_bytes  = cell_bytes;
+    queue->item_offset = item_offset;
+    queue->item_bytes  = item_bytes;
+
+#if !QUEUE_ANY_SPSC
+    for (size_t i = 0; i < cell_count; i++)
+    {
+        QUEUE_ATOMIC_STORE
+        (
+              QUEUE_ANY_FN(sequence)(QUEUE_ANY_FN(cell)(queue, i))
+            , i
+            , QUEUE_ORDER_RELAXED
+        );
+    }
+#endif
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, 0, QUEUE_ORDER_RELAXED);
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, 0, QUEUE_ORDER_RELAXED);
+
+    return Queue_Result_Ok;
+}
+
+size_t QUEUE_ANY_FN(item_bytes)(QUEUE_ANY_STRUCT* queue)
+{
+    return queue->item_bytes;
+}
+
+#if QUEUE_ANY_SPSC
+
+// As the typed spsc queue: each side keeps a copy of the other's index and
+// only reads the shared one when the copy says full or empty.
+
+static inline size_t QUEUE_ANY_FN(free_cells)(QUEUE_ANY_STRUCT* queue, size_t pos, size_t count)
+{
+    size_t free_cells =
+        queue->cell_mask + 1 - (pos - queue->dequeue_index_cached);
+
+    if (free_cells < count)
+    {
+        queue->dequeue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_ACQUIRE);
+
+        free_cells =
+            queue->cell_mask + 1 - (pos - queue->dequeue_index_cached);
+    }
+
+    return free_cells;
+}
+
+static inline size_t QUEUE_ANY_FN(used_cells)(QUEUE_ANY_STRUCT* queue, size_t pos, size_t count)
+{
+    size_t used_cells = queue->enqueue_index_cached - pos;
+
+    if (used_cells < count)
+    {
+        queue->enqueue_index_cached =
+            QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_ACQUIRE);
+
+        used_cells = queue->enqueue_index_cached - pos;
+    }
+
+    return used_cells;
+}
+
+Queue_Result QUEUE_ANY_FN(try_enqueue)(QUEUE_ANY_STRUCT* queue, void const* data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_ANY_FN(free_cells)(queue, pos, 1))
+    {
+        return Queue_Result_Full;
+    }
+
+    memcpy(QUEUE_ANY_FN(item)(queue, pos), data, queue->item_bytes);
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_ANY_FN(used_cells)(queue, pos, 1))
+    {
+        return Queue_Result_Empty;
+    }
+
+    memcpy(data, QUEUE_ANY_FN(item)(queue, pos), queue->item_bytes);
+
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELEASE);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void const*       data
+    , size_t            count
+    , size_t*           written
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    size_t free_cells = QUEUE_ANY_FN(free_cells)(queue, pos, count);
+    size_t to_write   = (free_cells < count) ? free_cells : count;
+
+    *written = to_write;
+
+    if (!to_write && count)
+    {
+        return Queue_Result_Full;
+    }
+
+    uint8_t const* from = (uint8_t const*) data;
+
+    for (size_t i = 0; i < to_write; i++)
+    {
+        memcpy
+        (
+              QUEUE_ANY_FN(item)(queue, pos + i)
+            , from + (i * queue->item_bytes)
+            , queue->item_bytes
+        );
+    }
+
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->enqueue_index
+        , pos + to_write
+        , QUEUE_ORDER_RELEASE
+    );
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void*             data
+    , size_t            count
+    , size_t*           read
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    size_t used_cells = QUEUE_ANY_FN(used_cells)(queue, pos, count);
+    size_t to_read    = (used_cells < count) ? used_cells : count;
+
+    *read = to_read;
+
+    if (!to_read && count)
+    {
+        return Queue_Result_Empty;
+    }
+
+    uint8_t* to = (uint8_t*) data;
+
+    for (size_t i = 0; i < to_read; i++)
+    {
+        memcpy
+        (
+              to + (i * queue->item_bytes)
+            , QUEUE_ANY_FN(item)(queue, pos + i)
+            , queue->item_bytes
+        );
+    }
+
+    QUEUE_ATOMIC_STORE
+    (
+          &queue->dequeue_index
+        , pos + to_read
+        , QUEUE_ORDER_RELEASE
+    );
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_reserve)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_ANY_FN(free_cells)(queue, pos, 1))
+    {
+        return Queue_Result_Full;
+    }
+
+    *data = QUEUE_ANY_FN(item)(queue, pos);
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_ANY_FN(enqueue_commit)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    (void) data;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&queue->enqueue_index, pos + 1, QUEUE_ORDER_RELEASE);
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue_peek)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    if (!QUEUE_ANY_FN(used_cells)(queue, pos, 1))
+    {
+        return Queue_Result_Empty;
+    }
+
+    *data = QUEUE_ANY_FN(item)(queue, pos);
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_ANY_FN(dequeue_release)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    (void) data;
+
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(&queue->dequeue_index, pos + 1, QUEUE_ORDER_RELEASE);
+}
+
+#else
+
+// As the typed queues: a sequence per cell says whose turn it is, and the
+// side(s) with more than one thread claim positions with a compare and swap.
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_reserve)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    uint8_t* cell = QUEUE_ANY_FN(cell)(queue, pos);
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(QUEUE_ANY_FN(sequence)(cell), QUEUE_ORDER_ACQUIRE);
+
+    intptr_t difference = (intptr_t) sequence - (intptr_t) pos;
+
+    if (!difference)
+    {
+        QUEUE_ANY_P_IF_CAS(queue->enqueue_index, pos, pos + 1)
+        {
+            *data = cell + queue->item_offset;
+
+            return Queue_Result_Ok;
+        }
+    }
+
+    if (difference < 0)
+    {
+        return Queue_Result_Full;
+    }
+
+    return Queue_Result_Contention;
+}
+
+void QUEUE_ANY_FN(enqueue_commit)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    // Until it is committed the cell's sequence is still the claimed position.
+    QUEUE_ATOMIC_SIZE_T* sequence =
+        QUEUE_ANY_FN(sequence)((uint8_t*) data - queue->item_offset);
+
+    size_t pos = QUEUE_ATOMIC_LOAD(sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(sequence, pos + 1, QUEUE_ORDER_RELEASE);
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue_peek)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    uint8_t* cell = QUEUE_ANY_FN(cell)(queue, pos);
+
+    size_t sequence =
+        QUEUE_ATOMIC_LOAD(QUEUE_ANY_FN(sequence)(cell), QUEUE_ORDER_ACQUIRE);
+
+    intptr_t difference = (intptr_t) sequence - (intptr_t)(pos + 1);
+
+    if (!difference)
+    {
+        QUEUE_ANY_C_IF_CAS(queue->dequeue_index, pos, pos + 1)
+        {
+            *data = cell + queue->item_offset;
+
+            return Queue_Result_Ok;
+        }
+    }
+
+    if (difference < 0)
+    {
+        return Queue_Result_Empty;
+    }
+
+    return Queue_Result_Contention;
+}
+
+void QUEUE_ANY_FN(dequeue_release)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    // Until it is released the cell's sequence is still the claimed position
+    // plus one.
+    QUEUE_ATOMIC_SIZE_T* sequence =
+        QUEUE_ANY_FN(sequence)((uint8_t*) data - queue->item_offset);
+
+    size_t pos = QUEUE_ATOMIC_LOAD(sequence, QUEUE_ORDER_RELAXED);
+
+    QUEUE_ATOMIC_STORE(sequence, pos + queue->cell_mask, QUEUE_ORDER_RELEASE);
+}
+
+Queue_Result QUEUE_ANY_FN(try_enqueue)(QUEUE_ANY_STRUCT* queue, void const* data)
+{
+    void* cell;
+
+    Queue_Result result = QUEUE_ANY_FN(try_enqueue_reserve)(queue, &cell);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    memcpy(cell, data, queue->item_bytes);
+
+    QUEUE_ANY_FN(enqueue_commit)(queue, cell);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    void* cell;
+
+    Queue_Result result = QUEUE_ANY_FN(try_dequeue_peek)(queue, &cell);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    memcpy(data, cell, queue->item_bytes);
+
+    QUEUE_ANY_FN(dequeue_release)(queue, cell);
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_ANY_FN(try_enqueue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void const*       data
+    , size_t            count
+    , size_t*           written
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->enqueue_index, QUEUE_ORDER_RELAXED);
+
+    size_t   to_write   = 0;
+    intptr_t difference = 0;
+
+    *written = 0;
+
+    while (to_write < count)
+    {
+        size_t sequence = QUEUE_ATOMIC_LOAD
+        (
+              QUEUE_ANY_FN(sequence)(QUEUE_ANY_FN(cell)(queue, pos + to_write))
+            , QUEUE_ORDER_ACQUIRE
+        );
+
+        difference = (intptr_t) sequence - (intptr_t)(pos + to_write);
+
+        if (difference)
+        {
+            break;
+        }
+
+        to_write++;
+    }
+
+    if (!count)
+    {
+        return Queue_Result_Ok;
+    }
+
+    if (to_write)
+    {
+        QUEUE_ANY_P_IF_CAS(queue->enqueue_index, pos, pos + to_write)
+        {
+            uint8_t const* from = (uint8_t const*) data;
+
+            for (size_t i = 0; i < to_write; i++)
+            {
+                uint8_t* cell = QUEUE_ANY_FN(cell)(queue, pos + i);
+
+                memcpy
+                (
+                      cell + queue->item_offset
+                    , from + (i * queue->item_bytes)
+                    , queue->item_bytes
+                );
+
+                QUEUE_ATOMIC_STORE
+                (
+                      QUEUE_ANY_FN(sequence)(cell)
+                    , pos + i + 1
+                    , QUEUE_ORDER_RELEASE
+                );
+            }
+
+            *written = to_write;
+
+            return Queue_Result_Ok;
+        }
+
+        return Queue_Result_Contention;
+    }
+
+    if (difference < 0)
+    {
+        return Queue_Result_Full;
+    }
+
+    return Queue_Result_Contention;
+}
+
+Queue_Result QUEUE_ANY_FN(try_dequeue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void*             data
+    , size_t            count
+    , size_t*           read
+)
+{
+    size_t pos =
+        QUEUE_ATOMIC_LOAD(&queue->dequeue_index, QUEUE_ORDER_RELAXED);
+
+    size_t   to_read    = 0;
+    intptr_t difference = 0;
+
+    *read = 0;
+
+    while (to_read < count)
+    {
+        size_t sequence = QUEUE_ATOMIC_LOAD
+        (
+              QUEUE_ANY_FN(sequence)(QUEUE_ANY_FN(cell)(queue, pos + to_read))
+            , QUEUE_ORDER_ACQUIRE
+        );
+
+        difference = (intptr_t) sequence - (intptr_t)(pos + to_read + 1);
+
+        if (difference)
+        {
+            break;
+        }
+
+        to_read++;
+    }
+
+    if (!count)
+    {
+        return Queue_Result_Ok;
+    }
+
+    if (to_read)
+    {
+        QUEUE_ANY_C_IF_CAS(queue->dequeue_index, pos, pos + to_read)
+        {
+            uint8_t* to = (uint8_t*) data;
+
+            for (size_t i = 0; i < to_read; i++)
+            {
+                uint8_t* cell = QUEUE_ANY_FN(cell)(queue, pos + i);
+
+                memcpy
+                (
+                      to + (i * queue->item_bytes)
+                    , cell + queue->item_offset
+                    , queue->item_bytes
+                );
+
+                QUEUE_ATOMIC_STORE
+                (
+                      QUEUE_ANY_FN(sequence)(cell)
+                    , pos + i + queue->cell_mask + 1
+                    , QUEUE_ORDER_RELEASE
+                );
+            }
+
+            *read = to_read;
+
+            return Queue_Result_Ok;
+        }
+
+        return Queue_Result_Contention;
+    }
+
+    if (difference < 0)
+    {
+        return Queue_Result_Empty;
+    }
+
+    return Queue_Result_Contention;
+}
+
+#endif
+
+Queue_Result QUEUE_ANY_FN(enqueue)(QUEUE_ANY_STRUCT* queue, void const* data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_enqueue)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_ANY_FN(dequeue)(QUEUE_ANY_STRUCT* queue, void* data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_dequeue)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_ANY_FN(enqueue_reserve)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_enqueue_reserve)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_ANY_FN(dequeue_peek)(QUEUE_ANY_STRUCT* queue, void** data)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_dequeue_peek)(queue, data);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_ANY_FN(enqueue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void const*       data
+    , size_t            count
+    , size_t*           written
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_enqueue_bulk)(queue, data, count, written);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+Queue_Result QUEUE_ANY_FN(dequeue_bulk)
+(
+      QUEUE_ANY_STRUCT* queue
+    , void*             data
+    , size_t            count
+    , size_t*           read
+)
+{
+    Queue_Result result;
+
+    do
+    {
+        result = QUEUE_ANY_FN(try_dequeue_bulk)(queue, data, count, read);
+    }
+    while (result == Queue_Result_Contention);
+
+    return result;
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_TYPE
+#undef QUEUE_MP
+#undef QUEUE_MC
+#undef QUEUE_IMPLEMENTATION
+#undef QUEUE_ERASED
+
+#undef QUEUE_ANY_PREFIX
+#undef QUEUE_ANY_STRUCT_BASE
+#undef QUEUE_ANY_FN
+#undef QUEUE_ANY_STRUCT
+#undef QUEUE_ANY_SPSC
+#undef QUEUE_ANY_P_IF_CAS
+#undef QUEUE_ANY_C_IF_CAS
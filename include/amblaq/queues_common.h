@@ -0,0 +1,179 @@
+// Atomics, helpers and Queue_Result shared by every queue header. Included by
+// them, there's no need to include it yourself.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#if !defined(QUEUE_COMMON_DEFINED)
+
+    #define QUEUE_COMMON_DEFINED
+
+    #if !defined(__cplusplus)
+
+        #if !defined(__STDC__)
+            #error Standard C is required for the C version of this file
+        #endif
+
+        #if (__STDC_VERSION__ < 201112L)
+            #error C11 is required for the C version of this file
+        #endif
+
+        #include <stdatomic.h>
+
+        #if defined(__STDC_NO_ATOMICS__)
+            #error Oh no, your C compiler does not support C11 atomics :-(
+        #endif
+
+        #define QUEUE_ATOMIC_SIZE_T    atomic_size_t
+        #define QUEUE_ATOMIC_U32       _Atomic(uint32_t)
+        #define QUEUE_ATOMIC_U64       _Atomic(uint64_t)
+        #define QUEUE_ORDER_RELAXED    memory_order_relaxed
+        #define QUEUE_ORDER_RELEASE    memory_order_release
+        #define QUEUE_ORDER_ACQUIRE    memory_order_acquire
+        #define QUEUE_ORDER_SEQ_CST    memory_order_seq_cst
+        #define QUEUE_ATOMIC_STORE     atomic_store_explicit
+        #define QUEUE_ATOMIC_LOAD      atomic_load_explicit
+        #define QUEUE_ATOMIC_FETCH_ADD atomic_fetch_add_explicit
+        #define QUEUE_ATOMIC_FETCH_SUB atomic_fetch_sub_explicit
+        #define QUEUE_ATOMIC_EXCHANGE  atomic_exchange_explicit
+        #define QUEUE_ATOMIC_FETCH_OR  atomic_fetch_or_explicit
+        #define QUEUE_ATOMIC_FETCH_AND atomic_fetch_and_explicit
+        #define QUEUE_ATOMIC_CAS       atomic_compare_exchange_strong_explicit
+        #define QUEUE_ATOMIC_STORE_U32 atomic_store_explicit
+        #define QUEUE_ATOMIC_STORE_U64 atomic_store_explicit
+        #define QUEUE_ATOMIC_FENCE     atomic_thread_fence
+        #define QUEUE_ALIGNAS(x)       _Alignas(x)
+        #define QUEUE_ALIGNOF(x)       _Alignof(x)
+
+    #else
+        #if (__cplusplus < 201103L)
+            #error C++11 is required for the C++ version of this file
+        #endif
+
+        #include <atomic>
+
+        #define QUEUE_ATOMIC_SIZE_T    std::atomic_size_t
+        #define QUEUE_ATOMIC_U32       std::atomic<uint32_t>
+        #define QUEUE_ATOMIC_U64       std::atomic<uint64_t>
+        #define QUEUE_ORDER_RELAXED    std::memory_order_relaxed
+        #define QUEUE_ORDER_RELEASE    std::memory_order_release
+        #define QUEUE_ORDER_ACQUIRE    std::memory_order_acquire
+        #define QUEUE_ORDER_SEQ_CST    std::memory_order_seq_cst
+        #define QUEUE_ATOMIC_STORE     std::atomic_store_explicit<size_t>
+        #define QUEUE_ATOMIC_LOAD      std::atomic_load_explicit
+        #define QUEUE_ATOMIC_FETCH_ADD(a, b, c) (a)->fetch_add(b, c)
+        #define QUEUE_ATOMIC_FETCH_SUB(a, b, c) (a)->fetch_sub(b, c)
+        #define QUEUE_ATOMIC_EXCHANGE(a, b, c)  (a)->exchange(b, c)
+        #define QUEUE_ATOMIC_FETCH_OR(a, b, c)  (a)->fetch_or(b, c)
+        #define QUEUE_ATOMIC_FETCH_AND(a, b, c) (a)->fetch_and(b, c)
+        #define QUEUE_ATOMIC_CAS       std::atomic_compare_exchange_strong_explicit
+        #define QUEUE_ATOMIC_STORE_U32(a, b, c) (a)->store(b, c)
+        #define QUEUE_ATOMIC_STORE_U64(a, b, c) (a)->store(b, c)
+        #define QUEUE_ATOMIC_FENCE     std::atomic_thread_fence
+        #define QUEUE_ALIGNAS(x)       alignas(x)
+        #define QUEUE_ALIGNOF(x)       alignof(x)
+
+    #endif
+
+    #define QUEUE_MERGE_BASE(a, b) a ## b
+    #define QUEUE_MERGE(a, b)      QUEUE_MERGE_BASE(a, b)
+
+    #if !defined(QUEUE_CACHELINE_BYTES)
+        #define QUEUE_CACHELINE_BYTES 64
+    #endif
+
+    #if !defined(QUEUE_TOO_BIG)
+        #define QUEUE_TOO_BIG (1024ULL * 1024ULL * 256ULL)
+    #endif
+
+    #define QUEUE_LOG2_SMALL(x)                                                \
+        (                                                                      \
+              ((x) >= 128) ? 7                                                 \
+            : ((x) >=  64) ? 6                                                 \
+            : ((x) >=  32) ? 5                                                 \
+            : ((x) >=  16) ? 4                                                 \
+            : ((x) >=   8) ? 3                                                 \
+            : ((x) >=   4) ? 2                                                 \
+            : ((x) >=   2) ? 1                                                 \
+            :                0                                                 \
+        )
+
+    // Leaves a function out of the thread sanitizer's checks. Only for reads
+    // that race on purpose and are checked afterwards, see overwrite_read.
+    #if defined(__clang__) || (defined(__GNUC__) && (__GNUC__ >= 8))
+        #define QUEUE_NO_SANITIZE_THREAD __attribute__((no_sanitize("thread")))
+    #else
+        #define QUEUE_NO_SANITIZE_THREAD
+    #endif
+
+    #if defined(__i386__) || defined(__x86_64__)
+        #define QUEUE_PAUSE() __builtin_ia32_pause()
+    #elif defined(_M_IX86) || defined(_M_X64)
+        #include <intrin.h>
+        #define QUEUE_PAUSE() _mm_pause()
+    #elif defined(__aarch64__) || defined(__arm__)
+        #define QUEUE_PAUSE() __asm__ __volatile__("yield")
+    #else
+        #define QUEUE_PAUSE()
+    #endif
+
+    // Index of the lowest set bit of a size_t, which mustn't be 0.
+    #if defined(__GNUC__) || defined(__clang__)
+        #define QUEUE_CTZ(x) ((size_t) __builtin_ctzll((unsigned long long) (x)))
+    #elif defined(_MSC_VER)
+        #include <intrin.h>
+
+        static inline size_t queue_ctz(size_t x)
+        {
+            unsigned long index = 0;
+
+            #if defined(_WIN64)
+                _BitScanForward64(&index, x);
+            #else
+                _BitScanForward(&index, x);
+            #endif
+
+            return index;
+        }
+
+        #define QUEUE_CTZ(x) queue_ctz(x)
+    #else
+        static inline size_t queue_ctz(size_t x)
+        {
+            size_t index = 0;
+
+            while (!(x & 1))
+            {
+                x >>= 1;
+                index++;
+            }
+
+            return index;
+        }
+
+        #define QUEUE_CTZ(x) queue_ctz(x)
+    #endif
+
+    typedef enum Queue_Result
+    {
+          Queue_Result_Ok
+        , Queue_Result_Full
+        , Queue_Result_Empty
+        , Queue_Result_Contention
+        , Queue_Result_Timeout
+        , Queue_Result_Closed
+
+        , Queue_Result_Error = 128
+        , Queue_Result_Error_Too_Small
+        , Queue_Result_Error_Too_Big
+        , Queue_Result_Error_Not_Pow2
+        , Queue_Result_Error_Not_Aligned_16_Bytes
+        , Queue_Result_Error_Null_Bytes
+        , Queue_Result_Error_Bytes_Smaller_Than_Needed
+        , Queue_Result_Error_System
+        , Queue_Result_Error_Header_Mismatch
+        , Queue_Result_Error_Not_Ready
+    }
+    Queue_Result;
+#endif
@@ -0,0 +1,376 @@
+// A small work stealing task scheduler. Each worker has its own deque
+// (amblaq/deque.h) that it pushes and pops at one end and other workers steal
+// from at the other, so spawned tasks spread out without every worker hitting
+// one queue. Tasks from outside the workers go in through an mpmc queue.
+//
+// Tasks are intrusive: put a Queue_Task in your struct, set run, and get back
+// to your struct from the pointer run is called with. The scheduler never
+// copies or frees them. It doesn't start threads either: run each worker's
+// loop on a thread of your own, calling try_run with its index, eg:
+//
+//     while (!done)
+//     {
+//         if (queue_scheduler_try_run(scheduler, worker) == Queue_Result_Empty)
+//         {
+//             idle();
+//         }
+//     }
+//
+// Define QUEUE_IMPLEMENTATION in one c file before including.
+
+// Kept aside, the queues.h include below would use it up.
+#if defined(QUEUE_IMPLEMENTATION)
+    #define QUEUE_SCHEDULER_IMPLEMENTATION
+    #undef QUEUE_IMPLEMENTATION
+#endif
+
+#if !defined(QUEUE_SCHEDULER_DEFINED)
+
+#define QUEUE_SCHEDULER_DEFINED
+
+#include "queues_common.h"
+#include "deque.h"
+
+typedef struct Queue_Task Queue_Task;
+
+// worker is the index of the worker running the task, for spawn.
+typedef void (*Queue_Task_Fn)(Queue_Task* task, size_t worker);
+
+struct Queue_Task
+{
+    Queue_Task_Fn run;
+};
+
+// The submission queue, a plain mpmc queue of task pointers.
+typedef Queue_Task* Queue_Task_Pointer;
+
+#define QUEUE_TYPE Queue_Task_Pointer
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#include "queues.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct Queue_Scheduler Queue_Scheduler;
+
+// worker_count deques of deque_cells each, plus a submission queue of
+// submit_cells. Both cell counts are powers of 2. Works like make_queue in
+// queues.h: call with a NULL scheduler to get the bytes needed.
+Queue_Result queue_scheduler_make
+(
+      size_t           worker_count
+    , size_t           deque_cells
+    , size_t           submit_cells
+    , Queue_Scheduler* scheduler
+    , size_t*          bytes
+);
+
+// From any thread. Queue_Result_Full if the submission queue is.
+Queue_Result queue_scheduler_submit(Queue_Scheduler* scheduler, Queue_Task* task);
+
+// From worker's thread, usually from a running task. Onto the worker's own
+// deque, or the submission queue if that is full.
+Queue_Result queue_scheduler_spawn
+(
+      Queue_Scheduler* scheduler
+    , size_t           worker
+    , Queue_Task*      task
+);
+
+// From worker's thread. Runs one task: the newest on its own deque, or else
+// the oldest submitted, or else the oldest on another worker's deque.
+// Queue_Result_Empty if there was none to run, Queue_Result_Contention if
+// there was nothing but another thread took something first.
+Queue_Result queue_scheduler_try_run(Queue_Scheduler* scheduler, size_t worker);
+
+// -----------------------------------------------------------------------------
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUEUE_SCHEDULER_DEFINED
+
+#if defined(QUEUE_SCHEDULER_IMPLEMENTATION) && !defined(QUEUE_SCHEDULER_IMPLEMENTED)
+
+#define QUEUE_SCHEDULER_IMPLEMENTED
+
+#define QUEUE_TYPE Queue_Task_Pointer
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_IMPLEMENTATION
+#include "queues.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Followed by the submission queue, then a Queue_Scheduler_Worker per worker,
+// all on their own cache lines.
+typedef struct Queue_Scheduler
+{
+    uint8_t pad0[QUEUE_CACHELINE_BYTES];
+
+    size_t  worker_count;
+    size_t  submit_bytes;
+    size_t  worker_bytes;
+    uint8_t pad1[QUEUE_CACHELINE_BYTES - (3 * sizeof(size_t))];
+
+    uint8_t data[];
+}
+Queue_Scheduler;
+
+typedef struct Queue_Scheduler_Worker
+{
+    // Owner only, where to start looking for something to steal.
+    size_t  victim;
+    uint8_t pad0[QUEUE_CACHELINE_BYTES - sizeof(size_t)];
+
+    // The worker's Queue_Deque.
+    uint8_t deque[];
+}
+Queue_Scheduler_Worker;
+
+static inline size_t queue_scheduler_round_up(size_t bytes)
+{
+    return
+          (bytes + QUEUE_CACHELINE_BYTES - 1)
+        & ~((size_t) QUEUE_CACHELINE_BYTES - 1);
+}
+
+static inline Queue_Deque* queue_scheduler_deque(Queue_Scheduler_Worker* worker)
+{
+    return (Queue_Deque*) (void*) worker->deque;
+}
+
+static inline Queue_Mpmc_Queue_Task_Pointer* queue_scheduler_submitted
+(
+    Queue_Scheduler* scheduler
+)
+{
+    return (Queue_Mpmc_Queue_Task_Pointer*) (void*) scheduler->data;
+}
+
+static inline Queue_Scheduler_Worker* queue_scheduler_worker
+(
+      Queue_Scheduler* scheduler
+    , size_t           worker
+)
+{
+    return (Queue_Scheduler_Worker*) (void*)
+    &scheduler->data
+    [
+          scheduler->submit_bytes
+        + (worker * scheduler->worker_bytes)
+    ];
+}
+
+Queue_Result queue_scheduler_make
+(
+      size_t           worker_count
+    , size_t           deque_cells
+    , size_t           submit_cells
+    , Queue_Scheduler* scheduler
+    , size_t*          bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    if (!worker_count)
+    {
+        return Queue_Result_Error_Too_Small;
+    }
+
+    size_t       deque_bytes  = 0;
+    size_t       submit_bytes = 0;
+    Queue_Result result       = queue_deque_make(deque_cells, NULL, &deque_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    result = mpmc_make_queue_Queue_Task_Pointer(submit_cells, NULL, &submit_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    submit_bytes = queue_scheduler_round_up(submit_bytes);
+
+    size_t worker_bytes = queue_scheduler_round_up
+    (
+          sizeof(Queue_Scheduler_Worker)
+        + deque_bytes
+    );
+
+    if
+    (
+        worker_count
+        > ((SIZE_MAX - sizeof(Queue_Scheduler) - submit_bytes) / worker_bytes)
+    )
+    {
+        return Queue_Result_Error_Too_Big;
+    }
+
+    size_t bytes_local =
+          sizeof(Queue_Scheduler)
+        + submit_bytes
+        + (worker_bytes * worker_count);
+
+    if (!scheduler)
+    {
+        *bytes = bytes_local;
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < bytes_local)
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t scheduler_value = (intptr_t) scheduler;
+
+        if (scheduler_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) scheduler, 0, sizeof(Queue_Scheduler));
+
+    scheduler->worker_count = worker_count;
+    scheduler->submit_bytes = submit_bytes;
+    scheduler->worker_bytes = worker_bytes;
+
+    mpmc_make_queue_Queue_Task_Pointer
+    (
+          submit_cells
+        , queue_scheduler_submitted(scheduler)
+        , &submit_bytes
+    );
+
+    for (size_t i = 0; i < worker_count; i++)
+    {
+        Queue_Scheduler_Worker* worker = queue_scheduler_worker(scheduler, i);
+        size_t                  deque_bytes_local = deque_bytes;
+
+        worker->victim = i + 1;
+
+        queue_deque_make
+        (
+              deque_cells
+            , queue_scheduler_deque(worker)
+            , &deque_bytes_local
+        );
+    }
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result queue_scheduler_submit(Queue_Scheduler* scheduler, Queue_Task* task)
+{
+    return mpmc_enqueue_Queue_Task_Pointer(queue_scheduler_submitted(scheduler), &task);
+}
+
+Queue_Result queue_scheduler_spawn
+(
+      Queue_Scheduler* scheduler
+    , size_t           worker
+    , Queue_Task*      task
+)
+{
+    Queue_Result result = queue_deque_push
+    (
+          queue_scheduler_deque(queue_scheduler_worker(scheduler, worker))
+        , task
+    );
+
+    if (result == Queue_Result_Full)
+    {
+        result = queue_scheduler_submit(scheduler, task);
+    }
+
+    return result;
+}
+
+Queue_Result queue_scheduler_try_run(Queue_Scheduler* scheduler, size_t worker)
+{
+    Queue_Scheduler_Worker* self = queue_scheduler_worker(scheduler, worker);
+    void*                   found = NULL;
+    Queue_Task*             task  = NULL;
+
+    if (queue_deque_pop(queue_scheduler_deque(self), &found) == Queue_Result_Ok)
+    {
+        task = (Queue_Task*) found;
+        task->run(task, worker);
+
+        return Queue_Result_Ok;
+    }
+
+    Queue_Result result = mpmc_try_dequeue_Queue_Task_Pointer
+    (
+          queue_scheduler_submitted(scheduler)
+        , &task
+    );
+
+    if (result == Queue_Result_Ok)
+    {
+        task->run(task, worker);
+
+        return Queue_Result_Ok;
+    }
+
+    int contention = (result == Queue_Result_Contention);
+
+    // Each worker goes round the others from where it last found something,
+    // so the thieves don't all start on the same deque.
+    size_t count = scheduler->worker_count;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        size_t victim = (self->victim + i) % count;
+
+        if (victim == worker)
+        {
+            continue;
+        }
+
+        result = queue_deque_steal
+        (
+              queue_scheduler_deque(queue_scheduler_worker(scheduler, victim))
+            , &found
+        );
+
+        if (result == Queue_Result_Ok)
+        {
+            self->victim = victim;
+
+            task = (Queue_Task*) found;
+            task->run(task, worker);
+
+            return Queue_Result_Ok;
+        }
+
+        contention |= (result == Queue_Result_Contention);
+    }
+
+    return contention ? Queue_Result_Contention : Queue_Result_Empty;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // QUEUE_SCHEDULER_IMPLEMENTATION
+
+#undef QUEUE_SCHEDULER_IMPLEMENTATION
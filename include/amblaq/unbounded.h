@@ -0,0 +1,388 @@
+// Unbounded spsc queue: a chain of spsc rings (segments). The producer starts
+// a new segment when the last one is full and the consumer moves on to it once
+// the one before is empty, so memory follows the backlog rather than the worst
+// case. Until a segment fills up, enqueue and dequeue are the spsc queue's plus
+// a pointer load.
+//
+// Built on the spsc queue for the same type, so include amblaq/queues.h with
+// QUEUE_MP 0 and QUEUE_MC 0 for QUEUE_TYPE first (with QUEUE_IMPLEMENTATION
+// somewhere). Then define QUEUE_TYPE, and optionally QUEUE_IMPLEMENTATION, and
+// include this. Names look like unbounded_try_enqueue_My_Struct.
+//
+// Segments come from QUEUE_UNBOUNDED_ALLOC(bytes), cache line aligned, and go
+// back with QUEUE_UNBOUNDED_FREE(pointer). Define both to use your own.
+
+#if !defined(QUEUE_TYPE)
+    #error Please define QUEUE_TYPE
+#endif
+
+// -----------------------------------------------------------------------------
+
+#include "queues_common.h"
+
+#if !defined(QUEUE_UNBOUNDED_DEFINED)
+
+    #define QUEUE_UNBOUNDED_DEFINED
+
+    #if defined(QUEUE_UNBOUNDED_ALLOC) != defined(QUEUE_UNBOUNDED_FREE)
+        #error Please define both QUEUE_UNBOUNDED_ALLOC and QUEUE_UNBOUNDED_FREE
+    #endif
+
+    #if !defined(QUEUE_UNBOUNDED_ALLOC)
+        #if defined(_WIN32)
+            #include <malloc.h>
+
+            #define QUEUE_UNBOUNDED_ALLOC(bytes)                               \
+                _aligned_malloc(bytes, QUEUE_CACHELINE_BYTES)
+
+            #define QUEUE_UNBOUNDED_FREE(pointer) _aligned_free(pointer)
+        #else
+            #include <stdlib.h>
+
+            #define QUEUE_UNBOUNDED_ALLOC(bytes)                               \
+                aligned_alloc(QUEUE_CACHELINE_BYTES, bytes)
+
+            #define QUEUE_UNBOUNDED_FREE(pointer) free(pointer)
+        #endif
+    #endif
+
+    // The segments' links and the spare are pointers kept as integers, so the
+    // usual atomics work on them.
+    typedef struct Queue_Unbounded_Segment
+    {
+        QUEUE_ATOMIC_SIZE_T next;
+        uint8_t             pad0[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+        uint8_t             ring[];
+    }
+    Queue_Unbounded_Segment;
+
+    #define QUEUE_UNBOUNDED_POINTER(x) ((Queue_Unbounded_Segment*) (uintptr_t) (x))
+    #define QUEUE_UNBOUNDED_INTEGER(x) ((size_t) (uintptr_t) (x))
+#endif
+
+#define QUEUE_UNBOUNDED_FN(name)                                               \
+    QUEUE_MERGE(unbounded_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_UNBOUNDED_STRUCT QUEUE_MERGE(Queue_Unbounded_, QUEUE_TYPE)
+
+#define QUEUE_UNBOUNDED_SPSC(name)                                             \
+    QUEUE_MERGE(spsc_, QUEUE_MERGE(name##_, QUEUE_TYPE))
+
+#define QUEUE_UNBOUNDED_RING QUEUE_MERGE(Queue_Spsc_, QUEUE_TYPE)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// -----------------------------------------------------------------------------
+
+typedef struct QUEUE_UNBOUNDED_STRUCT QUEUE_UNBOUNDED_STRUCT;
+
+// segment_cells is the cell_count of each segment, with the same rules as
+// make_queue in queues.h, and so is the bytes handshake for the queue itself.
+// The first segment is allocated here, Queue_Result_Error_System if that
+// fails. Release the segments with destroy_queue.
+Queue_Result QUEUE_UNBOUNDED_FN(make_queue)
+(
+      size_t                  segment_cells
+    , QUEUE_UNBOUNDED_STRUCT* queue
+    , size_t*                 bytes
+);
+
+// Frees every segment. Not thread safe, the queue must be done with.
+void QUEUE_UNBOUNDED_FN(destroy_queue)(QUEUE_UNBOUNDED_STRUCT* queue);
+
+// Never Queue_Result_Full, but Queue_Result_Error_System when a new segment is
+// needed and can't be allocated.
+Queue_Result QUEUE_UNBOUNDED_FN(try_enqueue)
+(
+      QUEUE_UNBOUNDED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+);
+
+Queue_Result QUEUE_UNBOUNDED_FN(try_dequeue)
+(
+      QUEUE_UNBOUNDED_STRUCT* queue
+    , QUEUE_TYPE*             data
+);
+
+// -----------------------------------------------------------------------------
+
+#if defined(QUEUE_IMPLEMENTATION)
+
+typedef struct QUEUE_UNBOUNDED_STRUCT
+{
+    uint8_t                  pad0[QUEUE_CACHELINE_BYTES];
+
+    // Producer only.
+    Queue_Unbounded_Segment* tail;
+    uint8_t                  pad1[QUEUE_CACHELINE_BYTES - sizeof(void*)];
+
+    // Consumer only.
+    Queue_Unbounded_Segment* head;
+    uint8_t                  pad2[QUEUE_CACHELINE_BYTES - sizeof(void*)];
+
+    // One drained segment kept for the producer's next, so a backlog going
+    // back and forth over a segment boundary doesn't allocate every time.
+    QUEUE_ATOMIC_SIZE_T      spare;
+    uint8_t                  pad3[QUEUE_CACHELINE_BYTES - sizeof(QUEUE_ATOMIC_SIZE_T)];
+
+    size_t                   segment_cells;
+    size_t                   segment_bytes;
+    size_t                   ring_bytes;
+    uint8_t                  pad4[QUEUE_CACHELINE_BYTES - (3 * sizeof(size_t))];
+}
+QUEUE_UNBOUNDED_STRUCT;
+
+static inline QUEUE_UNBOUNDED_RING* QUEUE_UNBOUNDED_FN(ring)
+(
+    Queue_Unbounded_Segment* segment
+)
+{
+    return (QUEUE_UNBOUNDED_RING*) (void*) segment->ring;
+}
+
+// An empty segment, the spare if there is one.
+static inline Queue_Unbounded_Segment* QUEUE_UNBOUNDED_FN(new_segment)
+(
+    QUEUE_UNBOUNDED_STRUCT* queue
+)
+{
+    Queue_Unbounded_Segment* segment = QUEUE_UNBOUNDED_POINTER
+    (
+        QUEUE_ATOMIC_EXCHANGE(&queue->spare, 0, QUEUE_ORDER_SEQ_CST)
+    );
+
+    if (!segment)
+    {
+        segment = (Queue_Unbounded_Segment*)
+            QUEUE_UNBOUNDED_ALLOC(queue->segment_bytes);
+
+        if (!segment)
+        {
+            return NULL;
+        }
+    }
+
+    size_t ring_bytes = queue->ring_bytes;
+
+    QUEUE_ATOMIC_STORE(&segment->next, 0, QUEUE_ORDER_RELAXED);
+
+    QUEUE_UNBOUNDED_SPSC(make_queue)
+    (
+          queue->segment_cells
+        , QUEUE_UNBOUNDED_FN(ring)(segment)
+        , &ring_bytes
+    );
+
+    return segment;
+}
+
+Queue_Result QUEUE_UNBOUNDED_FN(make_queue)
+(
+      size_t                  segment_cells
+    , QUEUE_UNBOUNDED_STRUCT* queue
+    , size_t*                 bytes
+)
+{
+    if (!bytes)
+    {
+        return Queue_Result_Error_Null_Bytes;
+    }
+
+    size_t ring_bytes = 0;
+
+    Queue_Result result =
+        QUEUE_UNBOUNDED_SPSC(make_queue)(segment_cells, NULL, &ring_bytes);
+
+    if (result != Queue_Result_Ok)
+    {
+        return result;
+    }
+
+    if (!queue)
+    {
+        *bytes = sizeof(QUEUE_UNBOUNDED_STRUCT);
+        return Queue_Result_Ok;
+    }
+
+    if (*bytes < sizeof(QUEUE_UNBOUNDED_STRUCT))
+    {
+        return Queue_Result_Error_Bytes_Smaller_Than_Needed;
+    }
+
+    {
+        intptr_t queue_value = (intptr_t) queue;
+
+        if (queue_value & 0x0F)
+        {
+            return Queue_Result_Error_Not_Aligned_16_Bytes;
+        }
+    }
+
+    memset((void*) queue, 0, sizeof(QUEUE_UNBOUNDED_STRUCT));
+
+    queue->segment_cells = segment_cells;
+    queue->ring_bytes    = ring_bytes;
+
+    // aligned_alloc wants a multiple of the alignment.
+    queue->segment_bytes =
+          (sizeof(Queue_Unbounded_Segment) + ring_bytes + QUEUE_CACHELINE_BYTES - 1)
+        & ~((size_t) QUEUE_CACHELINE_BYTES - 1);
+
+    QUEUE_ATOMIC_STORE(&queue->spare, 0, QUEUE_ORDER_RELAXED);
+
+    Queue_Unbounded_Segment* segment = QUEUE_UNBOUNDED_FN(new_segment)(queue);
+
+    if (!segment)
+    {
+        return Queue_Result_Error_System;
+    }
+
+    queue->head = segment;
+    queue->tail = segment;
+
+    return Queue_Result_Ok;
+}
+
+void QUEUE_UNBOUNDED_FN(destroy_queue)(QUEUE_UNBOUNDED_STRUCT* queue)
+{
+    Queue_Unbounded_Segment* segment = queue->head;
+
+    while (segment)
+    {
+        Queue_Unbounded_Segment* next = QUEUE_UNBOUNDED_POINTER
+        (
+            QUEUE_ATOMIC_LOAD(&segment->next, QUEUE_ORDER_RELAXED)
+        );
+
+        QUEUE_UNBOUNDED_FREE(segment);
+
+        segment = next;
+    }
+
+    Queue_Unbounded_Segment* spare = QUEUE_UNBOUNDED_POINTER
+    (
+        QUEUE_ATOMIC_LOAD(&queue->spare, QUEUE_ORDER_RELAXED)
+    );
+
+    if (spare)
+    {
+        QUEUE_UNBOUNDED_FREE(spare);
+    }
+
+    queue->head = NULL;
+    queue->tail = NULL;
+
+    QUEUE_ATOMIC_STORE(&queue->spare, 0, QUEUE_ORDER_RELAXED);
+}
+
+Queue_Result QUEUE_UNBOUNDED_FN(try_enqueue)
+(
+      QUEUE_UNBOUNDED_STRUCT* queue
+    , QUEUE_TYPE const*       data
+)
+{
+    Queue_Unbounded_Segment* tail = queue->tail;
+
+    Queue_Result result =
+        QUEUE_UNBOUNDED_SPSC(try_enqueue)(QUEUE_UNBOUNDED_FN(ring)(tail), data);
+
+    if (result != Queue_Result_Full)
+    {
+        return result;
+    }
+
+    Queue_Unbounded_Segment* segment = QUEUE_UNBOUNDED_FN(new_segment)(queue);
+
+    if (!segment)
+    {
+        return Queue_Result_Error_System;
+    }
+
+    // In before it is linked, so the consumer never finds it empty.
+    QUEUE_UNBOUNDED_SPSC(try_enqueue)(QUEUE_UNBOUNDED_FN(ring)(segment), data);
+
+    QUEUE_ATOMIC_STORE
+    (
+          &tail->next
+        , QUEUE_UNBOUNDED_INTEGER(segment)
+        , QUEUE_ORDER_RELEASE
+    );
+
+    queue->tail = segment;
+
+    return Queue_Result_Ok;
+}
+
+Queue_Result QUEUE_UNBOUNDED_FN(try_dequeue)
+(
+      QUEUE_UNBOUNDED_STRUCT* queue
+    , QUEUE_TYPE*             data
+)
+{
+    Queue_Unbounded_Segment* head = queue->head;
+
+    Queue_Result result =
+        QUEUE_UNBOUNDED_SPSC(try_dequeue)(QUEUE_UNBOUNDED_FN(ring)(head), data);
+
+    if (result != Queue_Result_Empty)
+    {
+        return result;
+    }
+
+    Queue_Unbounded_Segment* next = QUEUE_UNBOUNDED_POINTER
+    (
+        QUEUE_ATOMIC_LOAD(&head->next, QUEUE_ORDER_ACQUIRE)
+    );
+
+    if (!next)
+    {
+        return Queue_Result_Empty;
+    }
+
+    // The producer was done with head before linking next, so whatever it
+    // put in head is visible now. One last look, then head is drained.
+    result =
+        QUEUE_UNBOUNDED_SPSC(try_dequeue)(QUEUE_UNBOUNDED_FN(ring)(head), data);
+
+    if (result != Queue_Result_Empty)
+    {
+        return result;
+    }
+
+    queue->head = next;
+
+    Queue_Unbounded_Segment* old = QUEUE_UNBOUNDED_POINTER
+    (
+        QUEUE_ATOMIC_EXCHANGE
+        (
+              &queue->spare
+            , QUEUE_UNBOUNDED_INTEGER(head)
+            , QUEUE_ORDER_SEQ_CST
+        )
+    );
+
+    // The producer didn't want the last spare, so it is nobody's.
+    if (old)
+    {
+        QUEUE_UNBOUNDED_FREE(old);
+    }
+
+    return QUEUE_UNBOUNDED_SPSC(try_dequeue)(QUEUE_UNBOUNDED_FN(ring)(next), data);
+}
+
+#endif // QUEUE_IMPLEMENTATION
+
+#ifdef __cplusplus
+}
+#endif
+
+#undef QUEUE_TYPE
+#undef QUEUE_IMPLEMENTATION
+
+#undef QUEUE_UNBOUNDED_FN
+#undef QUEUE_UNBOUNDED_STRUCT
+#undef QUEUE_UNBOUNDED_SPSC
+#undef QUEUE_UNBOUNDED_RING
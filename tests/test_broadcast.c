@@ -0,0 +1,444 @@
+// -----------------------------------------------------------------------------
+// Tests for the broadcast ring, amblaq/broadcast.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/broadcast.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_READERS 4
+#define QUEUE_TEST_ITEMS   100000
+
+typedef Queue_Broadcast_uint64_t Queue;
+
+// -----------------------------------------------------------------------------
+
+Queue* make_malloc(size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if (broadcast_make_queue_uint64_t(cell_count, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    Queue* q = CAST(Queue*, malloc(bytes));
+
+    broadcast_make_queue_uint64_t(cell_count, q, &bytes);
+
+    return q;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t bytes = 0;
+    Queue* q     = NULL;
+
+    EXPECT(broadcast_make_queue_uint64_t(16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(broadcast_make_queue_uint64_t(1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(broadcast_make_queue_uint64_t(12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(broadcast_make_queue_uint64_t(16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue*, malloc(bytes));
+
+    bytes--;
+
+    EXPECT
+    (
+           broadcast_make_queue_uint64_t(16, q, &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    EXPECT(broadcast_make_queue_uint64_t(16, q, &bytes) == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* subscribe(void)
+{
+    Queue* q = make_malloc(16);
+
+    EXPECT(q);
+
+    size_t readers[QUEUE_BROADCAST_READERS];
+    size_t extra = 0;
+
+    for (unsigned i = 0; i < QUEUE_BROADCAST_READERS; i++)
+    {
+        EXPECT(broadcast_subscribe_uint64_t(q, &readers[i]) == Queue_Result_Ok);
+    }
+
+    EXPECT(broadcast_subscribe_uint64_t(q, &extra) == Queue_Result_Full);
+
+    broadcast_unsubscribe_uint64_t(q, readers[3]);
+
+    EXPECT(broadcast_subscribe_uint64_t(q, &extra) == Queue_Result_Ok);
+    EXPECT(extra == readers[3]);
+
+    free(q);
+
+    return NULL;
+}
+
+// The slowest reader holds the producer back, the others don't, and readers
+// only see what was enqueued after they subscribed.
+const char* gating(void)
+{
+    Queue* q = make_malloc(16);
+
+    EXPECT(q);
+
+    uint64_t data = 0;
+
+    // Nobody listening, nothing to hold the producer back.
+    for (unsigned i = 0; i < 100; i++)
+    {
+        EXPECT(broadcast_try_enqueue_uint64_t(q, &data) == Queue_Result_Ok);
+    }
+
+    size_t fast = 0;
+    size_t slow = 0;
+
+    EXPECT(broadcast_subscribe_uint64_t(q, &fast) == Queue_Result_Ok);
+    EXPECT(broadcast_subscribe_uint64_t(q, &slow) == Queue_Result_Ok);
+
+    EXPECT(broadcast_try_dequeue_uint64_t(q, fast, &data) == Queue_Result_Empty);
+
+    uint64_t in = 0;
+
+    for (unsigned round = 0; round < 10; round++)
+    {
+        for (;;)
+        {
+            data = in;
+
+            Queue_Result result = broadcast_try_enqueue_uint64_t(q, &data);
+
+            if (result == Queue_Result_Full)
+            {
+                break;
+            }
+
+            EXPECT(result == Queue_Result_Ok);
+
+            in++;
+
+            // Keep the fast reader drained.
+            EXPECT(broadcast_try_dequeue_uint64_t(q, fast, &data) == Queue_Result_Ok);
+            EXPECT(data == in - 1);
+        }
+
+        EXPECT(in == 16 * (round + 1));
+
+        uint64_t out[16];
+        size_t   read = 0;
+
+        EXPECT
+        (
+               broadcast_try_dequeue_bulk_uint64_t(q, slow, out, 16, &read)
+            == Queue_Result_Ok
+        );
+
+        EXPECT(read == 16);
+
+        for (unsigned i = 0; i < 16; i++)
+        {
+            EXPECT(out[i] == (16 * round) + i);
+        }
+    }
+
+    // Once the slow reader leaves, only the fast one counts.
+    broadcast_unsubscribe_uint64_t(q, slow);
+
+    for (unsigned i = 0; i < 100; i++)
+    {
+        data = in;
+
+        EXPECT(broadcast_try_enqueue_uint64_t(q, &data) == Queue_Result_Ok);
+        EXPECT(broadcast_try_dequeue_uint64_t(q, fast, &data) == Queue_Result_Ok);
+        EXPECT(data == in);
+
+        in++;
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// Batches are handed out in place and stop at the end of the ring.
+const char* peek(void)
+{
+    Queue* q = make_malloc(16);
+
+    EXPECT(q);
+
+    size_t reader = 0;
+
+    EXPECT(broadcast_subscribe_uint64_t(q, &reader) == Queue_Result_Ok);
+
+    uint64_t const* out   = NULL;
+    size_t          count = 0;
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Empty
+    );
+
+    uint64_t in[16];
+    size_t   written = 0;
+
+    for (unsigned i = 0; i < 16; i++)
+    {
+        in[i] = i;
+    }
+
+    EXPECT
+    (
+           broadcast_try_enqueue_bulk_uint64_t(q, in, 10, &written)
+        == Queue_Result_Ok
+    );
+
+    EXPECT(written == 10);
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Ok
+    );
+
+    EXPECT(count == 10);
+    EXPECT(out[9] == 9);
+
+    broadcast_dequeue_release_uint64_t(q, reader, 10);
+
+    // Ten more, which wrap after six.
+    for (unsigned i = 0; i < 10; i++)
+    {
+        uint64_t* cell = NULL;
+
+        EXPECT(broadcast_try_enqueue_reserve_uint64_t(q, &cell) == Queue_Result_Ok);
+
+        *cell = 10 + i;
+
+        broadcast_enqueue_commit_uint64_t(q);
+    }
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Ok
+    );
+
+    EXPECT(count == 6);
+    EXPECT(out[0] == 10);
+
+    // Only release some, the rest are still there on the next peek.
+    broadcast_dequeue_release_uint64_t(q, reader, 4);
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Ok
+    );
+
+    EXPECT(count == 2);
+    EXPECT(out[0] == 14);
+
+    broadcast_dequeue_release_uint64_t(q, reader, 2);
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Ok
+    );
+
+    EXPECT(count == 4);
+    EXPECT(out[3] == 19);
+
+    broadcast_dequeue_release_uint64_t(q, reader, 4);
+
+    EXPECT
+    (
+           broadcast_try_dequeue_peek_uint64_t(q, reader, &out, &count)
+        == Queue_Result_Empty
+    );
+
+    free(q);
+
+    return NULL;
+}
+
+#if QUEUE_TEST_THREADS
+
+typedef struct Thread_Data
+{
+    Queue*   q;
+    size_t   reader;
+    uint64_t bad;
+}
+Thread_Data;
+
+int thread_out(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    uint64_t expected = 0;
+
+    while (expected < QUEUE_TEST_ITEMS)
+    {
+        uint64_t const* out   = NULL;
+        size_t          count = 0;
+
+        Queue_Result result =
+            broadcast_try_dequeue_peek_uint64_t
+            (
+                  info->q
+                , info->reader
+                , &out
+                , &count
+            );
+
+        if (result != Queue_Result_Ok)
+        {
+            thrd_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            info->bad += (out[i] != expected++);
+        }
+
+        broadcast_dequeue_release_uint64_t(info->q, info->reader, count);
+    }
+
+    return 0;
+}
+
+#endif
+
+// Every reader sees every item, in order.
+const char* readers(void)
+{
+    Queue* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(256);
+
+    EXPECT(q);
+
+    Thread_Data info[QUEUE_TEST_READERS];
+    thrd_t      threads[QUEUE_TEST_READERS];
+
+    for (unsigned i = 0; i < QUEUE_TEST_READERS; i++)
+    {
+        info[i].q   = q;
+        info[i].bad = 0;
+
+        EXPECT(broadcast_subscribe_uint64_t(q, &info[i].reader) == Queue_Result_Ok);
+    }
+
+    for (unsigned i = 0; i < QUEUE_TEST_READERS; i++)
+    {
+        thrd_create(&threads[i], thread_out, &info[i]);
+    }
+
+    for (uint64_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        while (broadcast_try_enqueue_uint64_t(q, &i) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    uint64_t bad = 0;
+
+    for (unsigned i = 0; i < QUEUE_TEST_READERS; i++)
+    {
+        thrd_join(threads[i], NULL);
+
+        bad += info[i].bad;
+    }
+
+    EXPECT(!bad);
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(subscribe)
+    , TEST(gating)
+    , TEST(peek)
+    , TEST(readers)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Broadcast"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
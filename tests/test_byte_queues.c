@@ -0,0 +1,503 @@
+// -----------------------------------------------------------------------------
+// Tests for the variable length byte queues, amblaq/byte_queues.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_MP 0
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/byte_queues.h>
+
+#define QUEUE_MP 1
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/byte_queues.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_THREADS_MAX 8
+#define QUEUE_TEST_RECORDS     20000
+#define QUEUE_TEST_LONGEST     100
+
+// -----------------------------------------------------------------------------
+
+typedef enum Tag
+{
+      Spsc
+    , Mpsc
+
+    , Max = Mpsc
+}
+Tag;
+
+static const char* tag_to_name[] =
+{
+      "Spsc"
+    , "Mpsc"
+};
+
+Queue_Result make(Tag tag, size_t capacity, void* queue, size_t* bytes)
+{
+    switch (tag)
+    {
+        case Spsc:
+        {
+            return spsc_make_queue_Bytes
+            (
+                  capacity
+                , CAST(Queue_Spsc_Bytes*, queue)
+                , bytes
+            );
+        }
+        case Mpsc:
+        {
+            return mpsc_make_queue_Bytes
+            (
+                  capacity
+                , CAST(Queue_Mpsc_Bytes*, queue)
+                , bytes
+            );
+        }
+    }
+
+    return Queue_Result_Error;
+}
+
+void* make_malloc(Tag tag, size_t capacity)
+{
+    size_t bytes = 0;
+
+    if (make(tag, capacity, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    void* q = malloc(bytes);
+
+    make(tag, capacity, q, &bytes);
+
+    return q;
+}
+
+size_t max_length(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_max_length_Bytes(CAST(Queue_Spsc_Bytes*, q));
+        case Mpsc: return mpsc_max_length_Bytes(CAST(Queue_Mpsc_Bytes*, q));
+    }
+
+    return 0;
+}
+
+Queue_Result try_enqueue(Tag tag, void* q, void const* d, size_t length)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_Bytes(CAST(Queue_Spsc_Bytes*, q), d, length);
+        case Mpsc: return mpsc_try_enqueue_Bytes(CAST(Queue_Mpsc_Bytes*, q), d, length);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result enqueue(Tag tag, void* q, void const* d, size_t length)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_enqueue_Bytes(CAST(Queue_Spsc_Bytes*, q), d, length);
+        case Mpsc: return mpsc_enqueue_Bytes(CAST(Queue_Mpsc_Bytes*, q), d, length);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_dequeue(Tag tag, void* q, void* d, size_t* length)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_Bytes(CAST(Queue_Spsc_Bytes*, q), d, length);
+        case Mpsc: return mpsc_try_dequeue_Bytes(CAST(Queue_Mpsc_Bytes*, q), d, length);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_enqueue_reserve(Tag tag, void* q, size_t length, void** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_reserve_Bytes(CAST(Queue_Spsc_Bytes*, q), length, d);
+        case Mpsc: return mpsc_try_enqueue_reserve_Bytes(CAST(Queue_Mpsc_Bytes*, q), length, d);
+    }
+
+    return Queue_Result_Error;
+}
+
+void enqueue_commit(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_enqueue_commit_Bytes(CAST(Queue_Spsc_Bytes*, q), d); break;
+        case Mpsc: mpsc_enqueue_commit_Bytes(CAST(Queue_Mpsc_Bytes*, q), d); break;
+    }
+}
+
+Queue_Result try_dequeue_peek(Tag tag, void* q, void** d, size_t* length)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_peek_Bytes(CAST(Queue_Spsc_Bytes*, q), d, length);
+        case Mpsc: return mpsc_try_dequeue_peek_Bytes(CAST(Queue_Mpsc_Bytes*, q), d, length);
+    }
+
+    return Queue_Result_Error;
+}
+
+void dequeue_release(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_dequeue_release_Bytes(CAST(Queue_Spsc_Bytes*, q), d); break;
+        case Mpsc: mpsc_dequeue_release_Bytes(CAST(Queue_Mpsc_Bytes*, q), d); break;
+    }
+}
+
+// Records are filled with one value so a torn or misplaced one shows up.
+void fill(uint8_t* record, size_t length, uint8_t value)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        record[i] = value;
+    }
+}
+
+int filled(uint8_t const* record, size_t length, uint8_t value)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (record[i] != value)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void*  q     = NULL;
+
+    EXPECT(make(tag, 64,  NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(make(tag, 32,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(make(tag, 100, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(make(tag, 256, NULL, &bytes) == Queue_Result_Ok);
+    EXPECT(bytes >= 256);
+
+    q = malloc(bytes);
+
+    bytes--;
+
+    EXPECT
+    (
+           make(tag, 256, q, &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    EXPECT(make(tag, 256, q, &bytes) == Queue_Result_Ok);
+    EXPECT(max_length(tag, q) == 120);
+
+    uint8_t data[256] = {0};
+
+    EXPECT(try_enqueue(tag, q, data, 121) == Queue_Result_Error_Too_Big);
+
+    free(q);
+
+    return NULL;
+}
+
+// Fills and drains with mixed lengths, so records wrap at every offset.
+const char* wrap(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    void* q = make_malloc(tag, 256);
+
+    EXPECT(q);
+
+    uint8_t data[256];
+    size_t  length = sizeof(data);
+
+    EXPECT(try_dequeue(tag, q, data, &length) == Queue_Result_Empty);
+
+    unsigned in  = 0;
+    unsigned out = 0;
+
+    for (unsigned round = 0; round < 200; round++)
+    {
+        for (;;)
+        {
+            size_t in_length = (in * 7) % 121;
+
+            fill(data, in_length, (uint8_t) in);
+
+            Queue_Result result = try_enqueue(tag, q, data, in_length);
+
+            if (result == Queue_Result_Full)
+            {
+                break;
+            }
+
+            EXPECT(result == Queue_Result_Ok);
+
+            in++;
+        }
+
+        EXPECT(in != out);
+
+        // Every other round only take half, so the two sides drift apart.
+        unsigned target = (round & 1) ? in : out + ((in - out) / 2);
+
+        while (out < target)
+        {
+            size_t out_length = (out * 7) % 121;
+
+            length = 0;
+
+            if (out_length)
+            {
+                EXPECT
+                (
+                       try_dequeue(tag, q, data, &length)
+                    == Queue_Result_Error_Bytes_Smaller_Than_Needed
+                );
+
+                EXPECT(length == out_length);
+            }
+
+            length = sizeof(data);
+
+            EXPECT(try_dequeue(tag, q, data, &length) == Queue_Result_Ok);
+            EXPECT(length == out_length);
+            EXPECT(filled(data, length, (uint8_t) out));
+
+            out++;
+        }
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+const char* reserve(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    void* q = make_malloc(tag, 1024);
+
+    EXPECT(q);
+
+    for (unsigned i = 0; i < 100; i++)
+    {
+        void*  in     = NULL;
+        void*  out    = NULL;
+        size_t length = 0;
+
+        EXPECT(try_enqueue_reserve(tag, q, 8 + i, &in) == Queue_Result_Ok);
+        EXPECT(!(CAST(intptr_t, in) & (QUEUE_BYTES_ALIGN - 1)));
+
+        fill(CAST(uint8_t*, in), 8 + i, (uint8_t) i);
+
+        EXPECT(try_dequeue_peek(tag, q, &out, &length) == Queue_Result_Empty);
+
+        enqueue_commit(tag, q, in);
+
+        EXPECT(try_dequeue_peek(tag, q, &out, &length) == Queue_Result_Ok);
+        EXPECT(out == in);
+        EXPECT(length == 8 + i);
+        EXPECT(filled(CAST(uint8_t*, out), length, (uint8_t) i));
+
+        dequeue_release(tag, q, out);
+
+        EXPECT(try_dequeue_peek(tag, q, &out, &length) == Queue_Result_Empty);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+#if QUEUE_TEST_THREADS
+
+typedef struct Thread_Data
+{
+    void* q;
+    Tag   tag;
+}
+Thread_Data;
+
+int thread_in(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    uint8_t record[QUEUE_TEST_LONGEST];
+
+    for (unsigned i = 0; i < QUEUE_TEST_RECORDS; i++)
+    {
+        size_t length = 1 + (i % QUEUE_TEST_LONGEST);
+
+        fill(record, length, (uint8_t) i);
+
+        while (enqueue(info->tag, info->q, record, length) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
+const char* sums(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_out;
+
+#if QUEUE_TEST_THREADS
+    void* q = make_malloc(tag, 4096);
+
+    EXPECT(q);
+
+    Thread_Data info = {q, tag};
+    thrd_t      threads[QUEUE_TEST_THREADS_MAX];
+
+    for (unsigned i = 0; i < count_in; i++)
+    {
+        thrd_create(&threads[i], thread_in, &info);
+    }
+
+    uint64_t total    = 0;
+    uint64_t expected = 0;
+
+    for (unsigned i = 0; i < QUEUE_TEST_RECORDS; i++)
+    {
+        expected += 1 + (i % QUEUE_TEST_LONGEST);
+    }
+
+    expected *= count_in;
+
+    unsigned bad = 0;
+
+    for (unsigned i = 0; i < (QUEUE_TEST_RECORDS * count_in); i++)
+    {
+        uint8_t record[QUEUE_TEST_LONGEST];
+        size_t  length = sizeof(record);
+
+        while (try_dequeue(tag, q, record, &length) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        bad   += !filled(record, length, record[0]);
+        total += length;
+    }
+
+    for (unsigned i = 0; i < count_in; i++)
+    {
+        thrd_join(threads[i], NULL);
+    }
+
+    EXPECT(!bad);
+    EXPECT(total == expected);
+
+    free(q);
+#else
+    (void) count_in;
+    (void) tag;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(Tag, unsigned, unsigned);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(wrap)
+    , TEST(reserve)
+    , TEST(sums)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    unsigned producers[(Max + 1)] =
+    {
+          1
+        , QUEUE_TEST_THREADS_MAX
+    };
+
+    for (unsigned tag = 0; tag < (Max + 1); tag++)
+    {
+        for (unsigned j = 0; j < TEST_COUNT; j++)
+        {
+            const char* error =
+                tests[j].test(CAST(Tag, tag), producers[tag], 1);
+
+            printf
+            (
+                  "Test: %s: %-20s: %s%s\n"
+                , tag_to_name[tag]
+                , tests[j].name
+                , (error ? "FAIL: " : "PASS")
+                , (error ? error : "")
+            );
+
+            fflush(stdout);
+
+            if (error)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
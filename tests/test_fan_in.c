@@ -0,0 +1,376 @@
+// -----------------------------------------------------------------------------
+// Tests for the fan in queue, amblaq/fan_in.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/fan_in.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_PRODUCERS 4
+#define QUEUE_TEST_ITEMS     100000
+
+typedef Queue_Fan_In_uint64_t Queue;
+
+// -----------------------------------------------------------------------------
+
+Queue* make_malloc(size_t producer_count, size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if
+    (
+           fan_in_make_queue_uint64_t(producer_count, cell_count, NULL, &bytes)
+        != Queue_Result_Ok
+    )
+    {
+        return NULL;
+    }
+
+    Queue* q = CAST(Queue*, malloc(bytes));
+
+    fan_in_make_queue_uint64_t(producer_count, cell_count, q, &bytes);
+
+    return q;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t bytes = 0;
+    Queue* q     = NULL;
+
+    EXPECT(fan_in_make_queue_uint64_t(4, 16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(fan_in_make_queue_uint64_t(0, 16, NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(fan_in_make_queue_uint64_t(4, 1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(fan_in_make_queue_uint64_t(4, 12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(fan_in_make_queue_uint64_t(4, 16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue*, malloc(bytes));
+
+    bytes--;
+
+    EXPECT
+    (
+           fan_in_make_queue_uint64_t(4, 16, q, &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    EXPECT(fan_in_make_queue_uint64_t(4, 16, q, &bytes) == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* tokens(void)
+{
+    Queue* q = make_malloc(3, 16);
+
+    EXPECT(q);
+
+    uint64_t data = 0;
+
+    // Nobody registered, nothing to read.
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Empty);
+
+    size_t token = 0;
+
+    for (size_t i = 0; i < 3; i++)
+    {
+        EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Ok);
+        EXPECT(token == i);
+    }
+
+    EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Full);
+    EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Full);
+
+    // Each producer fills its own ring.
+    for (unsigned i = 0; i < 16; i++)
+    {
+        data = i;
+
+        EXPECT(fan_in_try_enqueue_uint64_t(q, 1, &data) == Queue_Result_Ok);
+    }
+
+    EXPECT(fan_in_try_enqueue_uint64_t(q, 1, &data) == Queue_Result_Full);
+    EXPECT(fan_in_try_enqueue_uint64_t(q, 0, &data) == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+// Producers take turns, and a busy one doesn't hide the others.
+const char* round_robin(void)
+{
+    Queue* q = make_malloc(3, 16);
+
+    EXPECT(q);
+
+    size_t token = 0;
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Ok);
+    }
+
+    uint64_t data = 0;
+
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        for (size_t p = 0; p < 3; p++)
+        {
+            data = (p * 100) + i;
+
+            EXPECT(fan_in_try_enqueue_uint64_t(q, p, &data) == Queue_Result_Ok);
+        }
+    }
+
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        for (uint64_t p = 0; p < 3; p++)
+        {
+            EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+            EXPECT(data == (p * 100) + i);
+        }
+    }
+
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Empty);
+
+    // Only the middle one has anything, then the last joins in.
+    data = 7;
+
+    EXPECT(fan_in_try_enqueue_uint64_t(q, 1, &data) == Queue_Result_Ok);
+    EXPECT(fan_in_try_enqueue_uint64_t(q, 1, &data) == Queue_Result_Ok);
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+
+    data = 9;
+
+    EXPECT(fan_in_try_enqueue_uint64_t(q, 2, &data) == Queue_Result_Ok);
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+    EXPECT(data == 9);
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+    EXPECT(data == 7);
+    EXPECT(fan_in_try_dequeue_uint64_t(q, &data) == Queue_Result_Empty);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* bulk(void)
+{
+    Queue* q = make_malloc(2, 16);
+
+    EXPECT(q);
+
+    size_t token = 0;
+
+    EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Ok);
+    EXPECT(fan_in_register_producer_uint64_t(q, &token) == Queue_Result_Ok);
+
+    uint64_t in[16];
+    size_t   written = 0;
+
+    for (unsigned i = 0; i < 16; i++)
+    {
+        in[i] = i;
+    }
+
+    EXPECT(fan_in_try_enqueue_bulk_uint64_t(q, 0, in, 10, &written) == Queue_Result_Ok);
+    EXPECT(written == 10);
+    EXPECT(fan_in_try_enqueue_bulk_uint64_t(q, 1, &in[10], 6, &written) == Queue_Result_Ok);
+    EXPECT(written == 6);
+
+    uint64_t out[16];
+    size_t   read = 0;
+
+    // A short read still moves on, so the rest of the first ring comes after
+    // the second one.
+    EXPECT(fan_in_try_dequeue_bulk_uint64_t(q, out, 4, &read) == Queue_Result_Ok);
+    EXPECT(read == 4);
+    EXPECT(out[3] == 3);
+
+    EXPECT(fan_in_try_dequeue_bulk_uint64_t(q, &out[4], 12, &read) == Queue_Result_Ok);
+    EXPECT(read == 12);
+    EXPECT(out[4]  == 10);
+    EXPECT(out[9]  == 15);
+    EXPECT(out[10] == 4);
+    EXPECT(out[15] == 9);
+
+    EXPECT(fan_in_try_dequeue_bulk_uint64_t(q, out, 16, &read) == Queue_Result_Empty);
+    EXPECT(read == 0);
+
+    free(q);
+
+    return NULL;
+}
+
+#if QUEUE_TEST_THREADS
+
+int thread_in(void* data)
+{
+    Queue* q     = CAST(Queue*, data);
+    size_t token = 0;
+
+    if (fan_in_register_producer_uint64_t(q, &token) != Queue_Result_Ok)
+    {
+        return 1;
+    }
+
+    // Top bits say who sent it, so the consumer can check per producer order.
+    for (uint64_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        uint64_t item = (CAST(uint64_t, token) << 32) | i;
+
+        while (fan_in_try_enqueue_uint64_t(q, token, &item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+
+#endif
+
+// Everything arrives, each producer's items in order.
+const char* producers(void)
+{
+    Queue* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(QUEUE_TEST_PRODUCERS, 256);
+
+    EXPECT(q);
+
+    thrd_t   threads[QUEUE_TEST_PRODUCERS];
+    uint64_t expected[QUEUE_TEST_PRODUCERS] = {0};
+    uint64_t bad = 0;
+
+    for (unsigned i = 0; i < QUEUE_TEST_PRODUCERS; i++)
+    {
+        thrd_create(&threads[i], thread_in, q);
+    }
+
+    uint64_t total = 0;
+    uint64_t out[64];
+
+    while (total < (CAST(uint64_t, QUEUE_TEST_PRODUCERS) * QUEUE_TEST_ITEMS))
+    {
+        size_t read = 0;
+
+        if (fan_in_try_dequeue_bulk_uint64_t(q, out, 64, &read) != Queue_Result_Ok)
+        {
+            thrd_yield();
+            continue;
+        }
+
+        for (size_t i = 0; i < read; i++)
+        {
+            uint64_t token = out[i] >> 32;
+
+            if (token >= QUEUE_TEST_PRODUCERS)
+            {
+                bad++;
+                continue;
+            }
+
+            bad += ((out[i] & 0xFFFFFFFF) != expected[token]++);
+        }
+
+        total += read;
+    }
+
+    for (unsigned i = 0; i < QUEUE_TEST_PRODUCERS; i++)
+    {
+        int result = 0;
+
+        thrd_join(threads[i], &result);
+
+        bad += CAST(uint64_t, result);
+    }
+
+    EXPECT(!bad);
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(tokens)
+    , TEST(round_robin)
+    , TEST(bulk)
+    , TEST(producers)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Fan In"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
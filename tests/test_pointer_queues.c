@@ -0,0 +1,368 @@
+// -----------------------------------------------------------------------------
+// Tests for the pointer queues, amblaq/pointer_queues.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_MP 0
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/pointer_queues.h>
+
+#define QUEUE_MP 1
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/pointer_queues.h>
+
+#define QUEUE_MP 0
+#define QUEUE_MC 1
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/pointer_queues.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_THREADS_MAX 4
+#define QUEUE_TEST_ITEMS       50000
+
+// -----------------------------------------------------------------------------
+
+typedef enum Tag
+{
+      Spsc
+    , Mpsc
+    , Spmc
+
+    , Max = Spmc
+}
+Tag;
+
+static const char* tag_to_name[] =
+{
+      "Spsc"
+    , "Mpsc"
+    , "Spmc"
+};
+
+Queue_Result make(Tag tag, size_t cell_count, void* q, size_t* bytes)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_make_queue_Pointers(cell_count, CAST(Queue_Spsc_Pointers*, q), bytes);
+        case Mpsc: return mpsc_make_queue_Pointers(cell_count, CAST(Queue_Mpsc_Pointers*, q), bytes);
+        case Spmc: return spmc_make_queue_Pointers(cell_count, CAST(Queue_Spmc_Pointers*, q), bytes);
+    }
+
+    return Queue_Result_Error;
+}
+
+void* make_malloc(Tag tag, size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if (make(tag, cell_count, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    void* q = malloc(bytes);
+
+    make(tag, cell_count, q, &bytes);
+
+    return q;
+}
+
+Queue_Result try_enqueue(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_Pointers(CAST(Queue_Spsc_Pointers*, q), d);
+        case Mpsc: return mpsc_try_enqueue_Pointers(CAST(Queue_Mpsc_Pointers*, q), d);
+        case Spmc: return spmc_try_enqueue_Pointers(CAST(Queue_Spmc_Pointers*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_dequeue(Tag tag, void* q, void** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_Pointers(CAST(Queue_Spsc_Pointers*, q), d);
+        case Mpsc: return mpsc_try_dequeue_Pointers(CAST(Queue_Mpsc_Pointers*, q), d);
+        case Spmc: return spmc_try_dequeue_Pointers(CAST(Queue_Spmc_Pointers*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+static uint32_t items[QUEUE_TEST_THREADS_MAX * QUEUE_TEST_ITEMS];
+
+const char* create(Tag tag)
+{
+    size_t bytes = 0;
+    void*  q     = NULL;
+
+    EXPECT(make(tag, 16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(make(tag, 1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(make(tag, 12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(make(tag, 16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = malloc(bytes);
+
+    bytes--;
+
+    EXPECT
+    (
+           make(tag, 16, q, &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    EXPECT(make(tag, 16, q, &bytes) == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* fill_drain(Tag tag)
+{
+    void* q = make_malloc(tag, 16);
+
+    EXPECT(q);
+
+    void* data = NULL;
+
+    EXPECT(try_enqueue(tag, q, NULL) == Queue_Result_Error);
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+
+    for (size_t lap = 0; lap < 3; lap++)
+    {
+        for (size_t i = 0; i < 16; i++)
+        {
+            EXPECT(try_enqueue(tag, q, &items[i + lap]) == Queue_Result_Ok);
+        }
+
+        EXPECT(try_enqueue(tag, q, &items[0]) == Queue_Result_Full);
+
+        for (size_t i = 0; i < 16; i++)
+        {
+            EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+            EXPECT(data == &items[i + lap]);
+        }
+
+        EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+    }
+
+    // Half full, so the next laps start part way round.
+    for (size_t i = 0; i < 40; i++)
+    {
+        EXPECT(try_enqueue(tag, q, &items[i]) == Queue_Result_Ok);
+
+        if (i >= 8)
+        {
+            EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+            EXPECT(data == &items[i - 8]);
+        }
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Thread_Data
+{
+    Tag      tag;
+    void*    q;
+    uint32_t first;
+    uint32_t count;
+    int      bad;
+}
+Thread_Data;
+
+int thread_in(void* data)
+{
+    Thread_Data* thread = CAST(Thread_Data*, data);
+
+    for (uint32_t i = 0; i < thread->count; i++)
+    {
+        while
+        (
+               try_enqueue(thread->tag, thread->q, &items[thread->first + i])
+            != Queue_Result_Ok
+        )
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+
+// Marks each item it gets, a second mark is a duplicate.
+int thread_out(void* data)
+{
+    Thread_Data* thread = CAST(Thread_Data*, data);
+    void*        item   = NULL;
+
+    for (uint32_t i = 0; i < thread->count; i++)
+    {
+        while (try_dequeue(thread->tag, thread->q, &item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        uint32_t* mark = CAST(uint32_t*, item);
+
+        if ((mark < items) || (mark >= &items[QUEUE_TEST_THREADS_MAX * QUEUE_TEST_ITEMS]))
+        {
+            thread->bad++;
+            continue;
+        }
+
+        thread->bad += (*mark)++ != 0;
+    }
+
+    return 0;
+}
+#endif
+
+const char* threads(Tag tag)
+{
+    void* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(tag, 64);
+
+    EXPECT(q);
+
+    memset(items, 0, sizeof(items));
+
+    unsigned producers = (tag == Mpsc) ? QUEUE_TEST_THREADS_MAX : 1;
+    unsigned consumers = (tag == Spmc) ? QUEUE_TEST_THREADS_MAX : 1;
+    uint32_t total     = QUEUE_TEST_THREADS_MAX * QUEUE_TEST_ITEMS;
+
+    thrd_t      threads_in[QUEUE_TEST_THREADS_MAX];
+    thrd_t      threads_out[QUEUE_TEST_THREADS_MAX];
+    Thread_Data data_in[QUEUE_TEST_THREADS_MAX];
+    Thread_Data data_out[QUEUE_TEST_THREADS_MAX];
+    int         bad = 0;
+
+    for (unsigned i = 0; i < producers; i++)
+    {
+        Thread_Data in = {tag, q, i * (total / producers), total / producers, 0};
+
+        data_in[i] = in;
+
+        thrd_create(&threads_in[i], thread_in, &data_in[i]);
+    }
+
+    for (unsigned i = 0; i < consumers; i++)
+    {
+        Thread_Data out = {tag, q, 0, total / consumers, 0};
+
+        data_out[i] = out;
+
+        thrd_create(&threads_out[i], thread_out, &data_out[i]);
+    }
+
+    for (unsigned i = 0; i < producers; i++)
+    {
+        thrd_join(threads_in[i], NULL);
+    }
+
+    for (unsigned i = 0; i < consumers; i++)
+    {
+        thrd_join(threads_out[i], NULL);
+
+        bad += data_out[i].bad;
+    }
+
+    EXPECT(!bad);
+
+    for (uint32_t i = 0; i < total; i++)
+    {
+        EXPECT(items[i] == 1);
+    }
+
+    void* item = NULL;
+
+    EXPECT(try_dequeue(tag, q, &item) == Queue_Result_Empty);
+
+    free(q);
+#else
+    (void) q;
+    (void) tag;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(Tag);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(fill_drain)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned i = 0; i <= Max; i++)
+    {
+        for (unsigned j = 0; j < TEST_COUNT; j++)
+        {
+            const char* error = tests[j].test(CAST(Tag, i));
+
+            printf
+            (
+                  "Test: %s: %-20s: %s%s\n"
+                , tag_to_name[i]
+                , tests[j].name
+                , (error ? "FAIL: " : "PASS")
+                , (error ? error : "")
+            );
+
+            fflush(stdout);
+
+            if (error)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
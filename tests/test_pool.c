@@ -0,0 +1,386 @@
+// -----------------------------------------------------------------------------
+// Tests for the object pool, amblaq/pool.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/pool.h>
+
+typedef struct Buffer
+{
+    uint32_t owner;
+    uint32_t sequence;
+    uint8_t  bytes[40];
+}
+Buffer;
+
+typedef Buffer* Buffer_Pointer;
+
+#define QUEUE_TYPE Buffer_Pointer
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_SLOTS 100
+#define QUEUE_TEST_ITEMS 1000000
+
+// -----------------------------------------------------------------------------
+
+Queue_Pool* make_malloc(size_t slot_count)
+{
+    size_t bytes = 0;
+
+    if (queue_pool_make(slot_count, sizeof(Buffer), NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    Queue_Pool* q = CAST(Queue_Pool*, aligned_alloc(QUEUE_CACHELINE_BYTES, bytes));
+
+    queue_pool_make(slot_count, sizeof(Buffer), q, &bytes);
+
+    return q;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t      bytes = 0;
+    Queue_Pool* q     = NULL;
+    void*       slot  = NULL;
+
+    EXPECT(queue_pool_make(16, 16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(queue_pool_make(0,  16, NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(queue_pool_make(16, 0,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(queue_pool_make(1,  1,  NULL, &bytes) == Queue_Result_Ok);
+    EXPECT(queue_pool_make(SIZE_MAX, 16, NULL, &bytes) == Queue_Result_Error_Too_Big);
+    EXPECT(queue_pool_make(12, 20, NULL, &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue_Pool*, aligned_alloc(QUEUE_CACHELINE_BYTES, bytes));
+
+    bytes--;
+
+    EXPECT(queue_pool_make(12, 20, q, &bytes) == Queue_Result_Error_Bytes_Smaller_Than_Needed);
+
+    bytes++;
+
+    EXPECT(queue_pool_make(12, 20, q, &bytes) == Queue_Result_Ok);
+
+    // Slots start on a cache line, 20 bytes are rounded up to 32.
+    uintptr_t first = 0;
+
+    for (unsigned i = 0; i < 12; i++)
+    {
+        EXPECT(queue_pool_acquire(q, NULL, &slot) == Queue_Result_Ok);
+
+        uintptr_t at = CAST(uintptr_t, slot);
+
+        first = (!i || (at < first)) ? at : first;
+
+        EXPECT(!(at & 15));
+        EXPECT((at + 32) <= (CAST(uintptr_t, q) + bytes));
+    }
+
+    EXPECT(!(first & (QUEUE_CACHELINE_BYTES - 1)));
+
+    free(q);
+
+    return NULL;
+}
+
+// Every slot once, then Empty, then the same slots again.
+const char* reuse(void)
+{
+    Queue_Pool* q = make_malloc(QUEUE_TEST_SLOTS);
+    Buffer*     slots[QUEUE_TEST_SLOTS];
+    void*       slot  = NULL;
+    Buffer      other;
+
+    EXPECT(q);
+
+    for (size_t lap = 0; lap < 3; lap++)
+    {
+        for (size_t i = 0; i < QUEUE_TEST_SLOTS; i++)
+        {
+            EXPECT(queue_pool_acquire(q, NULL, &slot) == Queue_Result_Ok);
+
+            slots[i] = CAST(Buffer*, slot);
+
+            for (size_t j = 0; j < i; j++)
+            {
+                EXPECT(slots[j] != slots[i]);
+            }
+        }
+
+        EXPECT(queue_pool_acquire(q, NULL, &slot) == Queue_Result_Empty);
+
+        EXPECT(queue_pool_release(q, NULL, &other)                       == Queue_Result_Error);
+        EXPECT(queue_pool_release(q, NULL, q)                            == Queue_Result_Error);
+        EXPECT(queue_pool_release(q, NULL, CAST(uint8_t*, slots[0]) + 1) == Queue_Result_Error);
+
+        for (size_t i = 0; i < QUEUE_TEST_SLOTS; i++)
+        {
+            EXPECT(queue_pool_release(q, NULL, slots[i]) == Queue_Result_Ok);
+        }
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// A cache keeps up to QUEUE_POOL_CACHE slots from everyone else until flushed.
+const char* cache(void)
+{
+    Queue_Pool*      q     = make_malloc(QUEUE_TEST_SLOTS);
+    Queue_Pool_Cache local = {0};
+    Buffer*          slots[QUEUE_TEST_SLOTS];
+    void*            slot  = NULL;
+
+    EXPECT(q);
+
+    for (size_t i = 0; i < QUEUE_TEST_SLOTS; i++)
+    {
+        EXPECT(queue_pool_acquire(q, &local, &slot) == Queue_Result_Ok);
+
+        slots[i] = CAST(Buffer*, slot);
+    }
+
+    EXPECT(queue_pool_acquire(q, &local, &slot) == Queue_Result_Empty);
+    EXPECT(!local.count);
+
+    for (size_t i = 0; i < QUEUE_TEST_SLOTS; i++)
+    {
+        EXPECT(queue_pool_release(q, &local, slots[i]) == Queue_Result_Ok);
+        EXPECT(local.count <= QUEUE_POOL_CACHE);
+    }
+
+    // Newest first from the cache.
+    EXPECT(queue_pool_acquire(q, &local, &slot) == Queue_Result_Ok);
+    EXPECT(slot == slots[QUEUE_TEST_SLOTS - 1]);
+    EXPECT(queue_pool_release(q, &local, slot) == Queue_Result_Ok);
+
+    size_t cached = local.count;
+    size_t shared = 0;
+
+    while (queue_pool_acquire(q, NULL, &slot) == Queue_Result_Ok)
+    {
+        shared++;
+    }
+
+    EXPECT(cached);
+    EXPECT((shared + cached) == QUEUE_TEST_SLOTS);
+
+    queue_pool_cache_flush(q, &local);
+
+    EXPECT(!local.count);
+
+    shared = 0;
+
+    while (queue_pool_acquire(q, NULL, &slot) == Queue_Result_Ok)
+    {
+        shared++;
+    }
+
+    EXPECT(shared == cached);
+
+    free(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Side
+{
+    Queue_Pool*                pool;
+    Queue_Spsc_Buffer_Pointer* pipe;
+    int                        bad;
+}
+Side;
+
+// Acquires, stamps and sends on. Stamps are checked at the other end, so a
+// slot handed out twice shows up as out of order.
+int thread_acquire(void* data)
+{
+    Side*            side  = CAST(Side*, data);
+    Queue_Pool_Cache local = {0};
+    void*            slot  = NULL;
+
+    for (uint32_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        while (queue_pool_acquire(side->pool, &local, &slot) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        Buffer* buffer = CAST(Buffer*, slot);
+
+        side->bad += (buffer->owner != 0);
+
+        buffer->owner    = 1;
+        buffer->sequence = i;
+
+        while (spsc_try_enqueue_Buffer_Pointer(side->pipe, &buffer) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    queue_pool_cache_flush(side->pool, &local);
+
+    return 0;
+}
+
+int thread_release(void* data)
+{
+    Side*            side   = CAST(Side*, data);
+    Queue_Pool_Cache local  = {0};
+    Buffer*          buffer = NULL;
+
+    for (uint32_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        while (spsc_try_dequeue_Buffer_Pointer(side->pipe, &buffer) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        side->bad += (buffer->owner != 1) || (buffer->sequence != i);
+
+        buffer->owner = 0;
+
+        side->bad += (queue_pool_release(side->pool, &local, buffer) != Queue_Result_Ok);
+    }
+
+    queue_pool_cache_flush(side->pool, &local);
+
+    return 0;
+}
+#endif
+
+// Slots acquired on one thread and released on another, each with a cache.
+const char* threads(void)
+{
+    Queue_Pool* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(QUEUE_TEST_SLOTS);
+
+    EXPECT(q);
+
+    size_t bytes = 0;
+
+    EXPECT(spsc_make_queue_Buffer_Pointer(64, NULL, &bytes) == Queue_Result_Ok);
+
+    Queue_Spsc_Buffer_Pointer* pipe = CAST(Queue_Spsc_Buffer_Pointer*, malloc(bytes));
+
+    EXPECT(pipe);
+    EXPECT(spsc_make_queue_Buffer_Pointer(64, pipe, &bytes) == Queue_Result_Ok);
+
+    Side   in  = {q, pipe, 0};
+    Side   out = {q, pipe, 0};
+    thrd_t handles[2];
+
+    for (size_t i = 0; i < QUEUE_TEST_SLOTS; i++)
+    {
+        void* slot = NULL;
+
+        queue_pool_acquire(q, NULL, &slot);
+        CAST(Buffer*, slot)->owner = 0;
+        queue_pool_release(q, NULL, slot);
+    }
+
+    thrd_create(&handles[0], thread_acquire, &in);
+    thrd_create(&handles[1], thread_release, &out);
+
+    thrd_join(handles[0], NULL);
+    thrd_join(handles[1], NULL);
+
+    free(pipe);
+
+    EXPECT(!in.bad);
+    EXPECT(!out.bad);
+
+    size_t count = 0;
+    void*  slot  = NULL;
+
+    while (queue_pool_acquire(q, NULL, &slot) == Queue_Result_Ok)
+    {
+        count++;
+    }
+
+    EXPECT(count == QUEUE_TEST_SLOTS);
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(reuse)
+    , TEST(cache)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Pool"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
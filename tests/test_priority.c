@@ -0,0 +1,348 @@
+// -----------------------------------------------------------------------------
+// Tests for the priority queue, amblaq/priority.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/priority.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_LANES     4
+#define QUEUE_TEST_PRODUCERS 4
+#define QUEUE_TEST_CONSUMERS 2
+#define QUEUE_TEST_ITEMS     200000
+
+typedef Queue_Priority_uint64_t Queue;
+
+// -----------------------------------------------------------------------------
+
+Queue* make_malloc(size_t lane_count, size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if (priority_make_queue_uint64_t(lane_count, cell_count, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    Queue* q = CAST(Queue*, malloc(bytes));
+
+    priority_make_queue_uint64_t(lane_count, cell_count, q, &bytes);
+
+    return q;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t bytes = 0;
+    Queue* q     = NULL;
+
+    EXPECT(priority_make_queue_uint64_t(4,  16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(priority_make_queue_uint64_t(0,  16, NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(priority_make_queue_uint64_t(QUEUE_PRIORITY_LANES_MAX + 1, 16, NULL, &bytes) == Queue_Result_Error_Too_Big);
+    EXPECT(priority_make_queue_uint64_t(4,  12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(priority_make_queue_uint64_t(QUEUE_PRIORITY_LANES_MAX, 16, NULL, &bytes) == Queue_Result_Ok);
+    EXPECT(priority_make_queue_uint64_t(4,  16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue*, malloc(bytes));
+
+    bytes--;
+
+    EXPECT(priority_make_queue_uint64_t(4, 16, q, &bytes) == Queue_Result_Error_Bytes_Smaller_Than_Needed);
+
+    bytes++;
+
+    EXPECT(priority_make_queue_uint64_t(4, 16, q, &bytes) == Queue_Result_Ok);
+
+    uint64_t data = 0;
+
+    EXPECT(priority_try_enqueue_uint64_t(q, 4, &data)    == Queue_Result_Error);
+    EXPECT(priority_try_dequeue_uint64_t(q, &data, NULL) == Queue_Result_Empty);
+
+    free(q);
+
+    return NULL;
+}
+
+// Lower lanes first, in order within a lane, and a full lane doesn't stop the
+// others.
+const char* order(void)
+{
+    Queue*   q    = make_malloc(QUEUE_PRIORITY_LANES_MAX, 8);
+    uint64_t data = 0;
+    size_t   lane = 0;
+
+    EXPECT(q);
+
+    for (size_t lap = 0; lap < 3; lap++)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            for (size_t l = QUEUE_PRIORITY_LANES_MAX; l-- > 0;)
+            {
+                if ((l % 3) == lap)
+                {
+                    continue;
+                }
+
+                data = (l << 8) | i;
+
+                EXPECT(priority_try_enqueue_uint64_t(q, l, &data) == Queue_Result_Ok);
+            }
+        }
+
+        EXPECT(priority_try_enqueue_uint64_t(q, lap + 1, &data) == Queue_Result_Full);
+
+        for (size_t l = 0; l < QUEUE_PRIORITY_LANES_MAX; l++)
+        {
+            if ((l % 3) == lap)
+            {
+                continue;
+            }
+
+            for (size_t i = 0; i < 8; i++)
+            {
+                EXPECT(priority_dequeue_uint64_t(q, &data, &lane) == Queue_Result_Ok);
+                EXPECT(lane == l);
+                EXPECT(data == ((l << 8) | i));
+            }
+        }
+
+        EXPECT(priority_try_dequeue_uint64_t(q, &data, &lane) == Queue_Result_Empty);
+    }
+
+    // An urgent item overtakes a backlog.
+    for (size_t i = 0; i < 4; i++)
+    {
+        data = i;
+
+        EXPECT(priority_enqueue_uint64_t(q, 5, &data) == Queue_Result_Ok);
+    }
+
+    data = 100;
+
+    EXPECT(priority_enqueue_uint64_t(q, 0, &data)     == Queue_Result_Ok);
+    EXPECT(priority_dequeue_uint64_t(q, &data, NULL)  == Queue_Result_Ok);
+    EXPECT(data == 100);
+    EXPECT(priority_dequeue_uint64_t(q, &data, &lane) == Queue_Result_Ok);
+    EXPECT((data == 0) && (lane == 5));
+
+    free(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Consumer
+{
+    Queue*               q;
+    QUEUE_ATOMIC_SIZE_T* taken;
+    uint64_t             last[QUEUE_TEST_PRODUCERS];
+    uint64_t             sum;
+    int                  bad;
+}
+Consumer;
+
+static Queue* shared = NULL;
+
+// Producer p goes into lane p % QUEUE_TEST_LANES, items are the producer in
+// the top bits and a count in the bottom ones.
+int thread_in(void* data)
+{
+    uint64_t producer = CAST(uint64_t, CAST(uintptr_t, data));
+    size_t   lane     = CAST(size_t, producer % QUEUE_TEST_LANES);
+
+    for (uint64_t i = 1; i <= QUEUE_TEST_ITEMS; i++)
+    {
+        uint64_t item = (producer << 32) | i;
+
+        while (priority_enqueue_uint64_t(shared, lane, &item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+
+// Items from one producer come out in order, and nothing is left behind.
+int thread_out(void* data)
+{
+    Consumer* consumer = CAST(Consumer*, data);
+    uint64_t  item     = 0;
+    size_t    lane     = 0;
+    size_t    total    = CAST(size_t, QUEUE_TEST_ITEMS) * QUEUE_TEST_PRODUCERS;
+
+    while (QUEUE_ATOMIC_LOAD(consumer->taken, QUEUE_ORDER_RELAXED) < total)
+    {
+        if (priority_dequeue_uint64_t(consumer->q, &item, &lane) != Queue_Result_Ok)
+        {
+            thrd_yield();
+            continue;
+        }
+
+        uint64_t producer = item >> 32;
+        uint64_t count    = item & 0xFFFFFFFF;
+
+        if
+        (
+               (producer >= QUEUE_TEST_PRODUCERS)
+            || (lane != (producer % QUEUE_TEST_LANES))
+            || (count <= consumer->last[producer])
+        )
+        {
+            consumer->bad++;
+        }
+        else
+        {
+            consumer->last[producer] = count;
+        }
+
+        consumer->sum += count;
+
+        QUEUE_ATOMIC_FETCH_ADD(consumer->taken, 1, QUEUE_ORDER_RELAXED);
+    }
+
+    return 0;
+}
+#endif
+
+const char* threads(void)
+{
+    Queue* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q      = make_malloc(QUEUE_TEST_LANES, 64);
+    shared = q;
+
+    EXPECT(q);
+
+    QUEUE_ATOMIC_SIZE_T taken;
+    thrd_t              handles[QUEUE_TEST_PRODUCERS + QUEUE_TEST_CONSUMERS];
+    Consumer            consumers[QUEUE_TEST_CONSUMERS];
+
+    QUEUE_ATOMIC_STORE(&taken, 0, QUEUE_ORDER_RELAXED);
+
+    for (unsigned i = 0; i < QUEUE_TEST_CONSUMERS; i++)
+    {
+        Consumer consumer = {q, &taken, {0}, 0, 0};
+
+        consumers[i] = consumer;
+
+        thrd_create(&handles[i], thread_out, &consumers[i]);
+    }
+
+    for (unsigned i = 0; i < QUEUE_TEST_PRODUCERS; i++)
+    {
+        thrd_create
+        (
+              &handles[QUEUE_TEST_CONSUMERS + i]
+            , thread_in
+            , CAST(void*, CAST(uintptr_t, i))
+        );
+    }
+
+    for (unsigned i = 0; i < (QUEUE_TEST_PRODUCERS + QUEUE_TEST_CONSUMERS); i++)
+    {
+        thrd_join(handles[i], NULL);
+    }
+
+    uint64_t sum = 0;
+    int      bad = 0;
+
+    for (unsigned i = 0; i < QUEUE_TEST_CONSUMERS; i++)
+    {
+        sum += consumers[i].sum;
+        bad += consumers[i].bad;
+    }
+
+    uint64_t expected =
+          QUEUE_TEST_PRODUCERS
+        * ((CAST(uint64_t, QUEUE_TEST_ITEMS) * (QUEUE_TEST_ITEMS + 1)) / 2);
+
+    uint64_t item = 0;
+
+    EXPECT(!bad);
+    EXPECT(sum == expected);
+    EXPECT(priority_try_dequeue_uint64_t(q, &item, NULL) == Queue_Result_Empty);
+    EXPECT(!QUEUE_ATOMIC_LOAD(&q->ready, QUEUE_ORDER_RELAXED));
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(order)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Priority"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,400 @@
+// -----------------------------------------------------------------------------
+// Tests for the C++ front end, amblaq/queue.hpp
+// -----------------------------------------------------------------------------
+#include <amblaq/queue.hpp>
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using amblaq::access;
+using amblaq::result;
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { return #x; }} while(0)
+
+#define QUEUE_TEST_CAPACITY 16
+#define QUEUE_TEST_THREADS  4
+#define QUEUE_TEST_ITEMS    5000
+
+// Counts live instances, to check the queue destroys what it holds.
+struct Tracked
+{
+    static inline std::atomic<int> live{0};
+
+    std::unique_ptr<unsigned> value;
+
+    Tracked() noexcept
+        : value(nullptr)
+    {
+        live++;
+    }
+
+    explicit Tracked(unsigned v)
+        : value(new unsigned(v))
+    {
+        live++;
+    }
+
+    // Takes the value over, and throws without one. Not noexcept, so emplace
+    // builds it before claiming a cell.
+    explicit Tracked(std::unique_ptr<unsigned>&& v)
+        : value(std::move(v))
+    {
+        if (!value)
+        {
+            throw std::invalid_argument("no value");
+        }
+
+        live++;
+    }
+
+    Tracked(Tracked&& other) noexcept
+        : value(std::move(other.value))
+    {
+        live++;
+    }
+
+    Tracked& operator=(Tracked&& other) noexcept
+    {
+        value = std::move(other.value);
+        return *this;
+    }
+
+    ~Tracked()
+    {
+        live--;
+    }
+};
+
+template <access P, access C>
+using Dynamic = amblaq::queue<Tracked, P, C>;
+
+template <access P, access C>
+using Fixed = amblaq::queue<Tracked, P, C, QUEUE_TEST_CAPACITY>;
+
+template <typename Q>
+std::unique_ptr<Q> make()
+{
+    if constexpr (std::is_constructible_v<Q, std::size_t>)
+    {
+        return std::unique_ptr<Q>(new Q(QUEUE_TEST_CAPACITY));
+    }
+    else
+    {
+        return std::unique_ptr<Q>(new Q());
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+template <typename Q>
+const char* create()
+{
+    if constexpr (std::is_constructible_v<Q, std::size_t>)
+    {
+        bool thrown = false;
+
+        try { Q q(13); } catch (std::invalid_argument const&) { thrown = true; }
+
+        EXPECT(thrown);
+
+        thrown = false;
+
+        try { Q q(1); } catch (std::invalid_argument const&) { thrown = true; }
+
+        EXPECT(thrown);
+    }
+
+    auto q = make<Q>();
+
+    EXPECT(q->capacity() == QUEUE_TEST_CAPACITY);
+
+    return nullptr;
+}
+
+template <typename Q>
+const char* full_empty()
+{
+    auto q = make<Q>();
+
+    for (unsigned round = 0; round < 3; round++)
+    {
+        Tracked item;
+
+        EXPECT(q->try_pop(item) == result::empty);
+
+        for (unsigned i = 0; i < QUEUE_TEST_CAPACITY; i++)
+        {
+            unsigned value = (round * QUEUE_TEST_CAPACITY) + i;
+
+            if (i & 1)
+            {
+                EXPECT(q->try_emplace(value) == result::ok);
+            }
+            else
+            {
+                EXPECT(q->try_push(Tracked(value)) == result::ok);
+            }
+        }
+
+        EXPECT(q->try_emplace(0u) == result::full);
+
+        for (unsigned i = 0; i < QUEUE_TEST_CAPACITY; i++)
+        {
+            EXPECT(q->try_pop(item) == result::ok);
+            EXPECT(item.value);
+            EXPECT(*item.value == (round * QUEUE_TEST_CAPACITY) + i);
+        }
+
+        EXPECT(q->try_pop(item) == result::empty);
+    }
+
+    EXPECT(Tracked::live == 0);
+
+    return nullptr;
+}
+
+template <typename Q>
+const char* destroy()
+{
+    {
+        auto q = make<Q>();
+
+        for (unsigned i = 0; i < 10; i++)
+        {
+            EXPECT(q->emplace(i) == result::ok);
+        }
+
+        Tracked item;
+
+        EXPECT(q->pop(item) == result::ok);
+        EXPECT(q->pop(item) == result::ok);
+        EXPECT(Tracked::live == 9);
+    }
+
+    EXPECT(Tracked::live == 0);
+
+    return nullptr;
+}
+
+template <typename Q>
+const char* sums()
+{
+    auto q = make<Q>();
+
+    constexpr bool mp = (Q::producers == access::multi);
+    constexpr bool mc = (Q::consumers == access::multi);
+
+    unsigned producers = mp ? QUEUE_TEST_THREADS : 1;
+    unsigned consumers = mc ? QUEUE_TEST_THREADS : 1;
+    unsigned total     = producers * QUEUE_TEST_ITEMS;
+
+    std::atomic<unsigned long long> sum{0};
+    std::atomic<unsigned>           count{0};
+    std::vector<std::thread>        threads;
+
+    for (unsigned p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&q]
+        {
+            for (unsigned i = 1; i <= QUEUE_TEST_ITEMS; i++)
+            {
+                while (q->push(Tracked(i)) != result::ok)
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (unsigned c = 0; c < consumers; c++)
+    {
+        threads.emplace_back([&q, &sum, &count, total]
+        {
+            Tracked item;
+
+            while (count.load(std::memory_order_relaxed) < total)
+            {
+                if (q->pop(item) == result::ok)
+                {
+                    sum.fetch_add(*item.value, std::memory_order_relaxed);
+                    count.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    unsigned long long expected =
+        producers * ((QUEUE_TEST_ITEMS * (QUEUE_TEST_ITEMS + 1ULL)) / 2);
+
+    EXPECT(count == total);
+    EXPECT(sum   == expected);
+
+    return nullptr;
+}
+
+// emplace from a move only argument, with a constructor that can throw, while
+// the producers get in each other's way. Retrying must not construct again
+// from the argument it already moved from.
+template <typename Q>
+const char* emplace_moved()
+{
+    auto q = make<Q>();
+
+    constexpr bool mp = (Q::producers == access::multi);
+
+    unsigned producers = mp ? QUEUE_TEST_THREADS : 1;
+    unsigned total     = producers * QUEUE_TEST_ITEMS;
+
+    bool thrown = false;
+
+    try
+    {
+        q->emplace(std::unique_ptr<unsigned>());
+    }
+    catch (std::invalid_argument const&)
+    {
+        thrown = true;
+    }
+
+    Tracked item;
+
+    EXPECT(thrown);
+    EXPECT(q->try_pop(item) == result::empty);
+
+    std::atomic<unsigned long long> sum{0};
+    std::atomic<unsigned>           count{0};
+    std::atomic<unsigned>           bad{0};
+    std::vector<std::thread>        threads;
+
+    for (unsigned p = 0; p < producers; p++)
+    {
+        threads.emplace_back([&q, &bad]
+        {
+            for (unsigned i = 1; i <= QUEUE_TEST_ITEMS; i++)
+            {
+                try
+                {
+                    while
+                    (
+                        q->emplace(std::make_unique<unsigned>(i)) != result::ok
+                    )
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+                catch (std::invalid_argument const&)
+                {
+                    bad++;
+                }
+            }
+        });
+    }
+
+    threads.emplace_back([&q, &sum, &count, &bad, total]
+    {
+        Tracked out;
+
+        while
+        (
+            (count.load(std::memory_order_relaxed) + bad.load()) < total
+        )
+        {
+            if (q->try_pop(out) == result::ok)
+            {
+                sum.fetch_add(*out.value, std::memory_order_relaxed);
+                count.fetch_add(1, std::memory_order_relaxed);
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    unsigned long long expected =
+        producers * ((QUEUE_TEST_ITEMS * (QUEUE_TEST_ITEMS + 1ULL)) / 2);
+
+    EXPECT(bad   == 0);
+    EXPECT(count == total);
+    EXPECT(sum   == expected);
+
+    return nullptr;
+}
+
+// -----------------------------------------------------------------------------
+
+template <typename Q>
+bool run(const char* name)
+{
+    struct
+    {
+        const char* name;
+        const char* (*test)();
+    }
+    tests[] =
+    {
+          {"create",        create<Q>}
+        , {"full_empty",    full_empty<Q>}
+        , {"destroy",       destroy<Q>}
+        , {"sums",          sums<Q>}
+        , {"emplace_moved", emplace_moved<Q>}
+    };
+
+    for (auto const& test : tests)
+    {
+        const char* error = test.test();
+
+        printf
+        (
+              "Test: %-12s: %-20s: %s%s\n"
+            , name
+            , test.name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    bool ok =
+           run<Dynamic<access::single, access::single>>("Spsc")
+        && run<Dynamic<access::multi,  access::single>>("Mpsc")
+        && run<Dynamic<access::single, access::multi >>("Spmc")
+        && run<Dynamic<access::multi,  access::multi >>("Mpmc")
+        && run<Fixed  <access::single, access::single>>("Spsc_Fixed")
+        && run<Fixed  <access::multi,  access::single>>("Mpsc_Fixed")
+        && run<Fixed  <access::single, access::multi >>("Spmc_Fixed")
+        && run<Fixed  <access::multi,  access::multi >>("Mpmc_Fixed");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,436 @@
+// -----------------------------------------------------------------------------
+// Tests for queue sets, QUEUE_SELECT in amblaq/queues.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+// Three types, to check one set takes any of them.
+typedef struct Tick
+{
+    uint32_t producer;
+    uint32_t count;
+}
+Tick;
+
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_TYPE uint32_t
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_SELECT
+#include <amblaq/queues.h>
+
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_TYPE uint64_t
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_SELECT
+#include <amblaq/queues.h>
+
+#define QUEUE_MP   1
+#define QUEUE_MC   0
+#define QUEUE_TYPE Tick
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_SELECT
+#include <amblaq/queues.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_ITEMS     100000
+#define QUEUE_TEST_PRODUCERS 2
+
+typedef enum Tag
+{
+      Spsc_U32
+    , Spsc_U64
+    , Mpsc_Tick
+}
+Tag;
+
+typedef struct Entry
+{
+    Tag   tag;
+    void* q;
+}
+Entry;
+
+// -----------------------------------------------------------------------------
+
+void* make_malloc(Tag tag, size_t cell_count)
+{
+    size_t bytes = 0;
+    void*  q     = NULL;
+
+    switch (tag)
+    {
+        case Spsc_U32:  spsc_make_queue_uint32_t(cell_count, NULL, &bytes); break;
+        case Spsc_U64:  spsc_make_queue_uint64_t(cell_count, NULL, &bytes); break;
+        case Mpsc_Tick: mpsc_make_queue_Tick    (cell_count, NULL, &bytes); break;
+    }
+
+    q = malloc(bytes);
+
+    switch (tag)
+    {
+        case Spsc_U32:  spsc_make_queue_uint32_t(cell_count, CAST(Queue_Spsc_uint32_t*, q), &bytes); break;
+        case Spsc_U64:  spsc_make_queue_uint64_t(cell_count, CAST(Queue_Spsc_uint64_t*, q), &bytes); break;
+        case Mpsc_Tick: mpsc_make_queue_Tick    (cell_count, CAST(Queue_Mpsc_Tick*,     q), &bytes); break;
+    }
+
+    return q;
+}
+
+Queue_Set_Link* link_of(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc_U32:  return spsc_set_link_uint32_t(CAST(Queue_Spsc_uint32_t*, q));
+        case Spsc_U64:  return spsc_set_link_uint64_t(CAST(Queue_Spsc_uint64_t*, q));
+        case Mpsc_Tick: return mpsc_set_link_Tick    (CAST(Queue_Mpsc_Tick*,     q));
+    }
+
+    return NULL;
+}
+
+Queue_Result enqueue(Tag tag, void* q, uint32_t value)
+{
+    uint64_t wide = value;
+    Tick     tick = {value >> 24, value & 0xFFFFFF};
+
+    switch (tag)
+    {
+        case Spsc_U32:  return spsc_try_enqueue_uint32_t(CAST(Queue_Spsc_uint32_t*, q), &value);
+        case Spsc_U64:  return spsc_try_enqueue_uint64_t(CAST(Queue_Spsc_uint64_t*, q), &wide);
+        case Mpsc_Tick: return mpsc_try_enqueue_Tick    (CAST(Queue_Mpsc_Tick*,     q), &tick);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result dequeue(Tag tag, void* q, uint32_t* value)
+{
+    uint64_t     wide   = 0;
+    Tick         tick   = {0, 0};
+    Queue_Result result = Queue_Result_Error;
+
+    switch (tag)
+    {
+        case Spsc_U32:
+            return spsc_try_dequeue_uint32_t(CAST(Queue_Spsc_uint32_t*, q), value);
+
+        case Spsc_U64:
+            result = spsc_try_dequeue_uint64_t(CAST(Queue_Spsc_uint64_t*, q), &wide);
+            *value = CAST(uint32_t, wide);
+            break;
+
+        case Mpsc_Tick:
+            result = mpsc_try_dequeue_Tick(CAST(Queue_Mpsc_Tick*, q), &tick);
+            *value = (tick.producer << 24) | tick.count;
+            break;
+    }
+
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* add(void)
+{
+    Queue_Set set;
+    unsigned  index = 99;
+    void*     q     = NULL;
+    void*     queues[QUEUE_SET_MAX + 1];
+
+    queue_set_init(&set);
+
+    for (unsigned i = 0; i < (QUEUE_SET_MAX + 1); i++)
+    {
+        queues[i] = make_malloc(CAST(Tag, (i % 3)), 2);
+    }
+
+    for (unsigned i = 0; i < QUEUE_SET_MAX; i++)
+    {
+        Tag tag = CAST(Tag, (i % 3));
+
+        EXPECT(queue_set_add(&set, link_of(tag, queues[i]), &index) == Queue_Result_Ok);
+        EXPECT(index == i);
+    }
+
+    Queue_Set_Link* last = link_of(CAST(Tag, (QUEUE_SET_MAX % 3)), queues[QUEUE_SET_MAX]);
+
+    EXPECT(queue_set_add(&set, link_of(Spsc_U32, queues[0]), &index) == Queue_Result_Error);
+    EXPECT(queue_set_add(&set, last, &index) == Queue_Result_Error_Too_Big);
+
+    // Added queues start out ready.
+    EXPECT(queue_set_poll(&set) == UINT64_MAX);
+    EXPECT(queue_set_poll(&set) == 0);
+
+    queue_set_remove(&set, link_of(Spsc_U64, queues[7]));
+
+    EXPECT(queue_set_add(&set, last, &index) == Queue_Result_Ok);
+    EXPECT(index == 7);
+
+    for (unsigned i = 0; i < (QUEUE_SET_MAX + 1); i++)
+    {
+        free(queues[i]);
+    }
+
+    return NULL;
+}
+
+// Only the queues that had something enqueued come back.
+const char* poll_ready(void)
+{
+    Queue_Set set;
+    uint64_t  ready = 0;
+    unsigned  index = 0;
+    void*     q     = NULL;
+    Entry     entries[3];
+
+    queue_set_init(&set);
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        Entry entry = {CAST(Tag, i), make_malloc(CAST(Tag, i), 8)};
+
+        entries[i] = entry;
+
+        EXPECT(queue_set_add(&set, link_of(entry.tag, entry.q), &index) == Queue_Result_Ok);
+    }
+
+    EXPECT(queue_set_poll(&set) == 7);
+    EXPECT(queue_set_wait(&set, 1000000, &ready) == Queue_Result_Timeout);
+    EXPECT(queue_set_wait(&set, 0,       &ready) == Queue_Result_Timeout);
+
+    for (unsigned round = 0; round < 8; round++)
+    {
+        Entry*   entry = &entries[round % 3];
+        uint32_t value = 0;
+
+        EXPECT(enqueue(entry->tag, entry->q, round)     == Queue_Result_Ok);
+        EXPECT(enqueue(entry->tag, entry->q, round + 1) == Queue_Result_Ok);
+
+        EXPECT(queue_set_wait(&set, QUEUE_WAIT_FOREVER, &ready) == Queue_Result_Ok);
+        EXPECT(ready == (1ULL << (round % 3)));
+
+        // Half drained, so marked again.
+        EXPECT(dequeue(entry->tag, entry->q, &value) == Queue_Result_Ok);
+        EXPECT(value == round);
+
+        queue_set_mark(&set, ready);
+
+        EXPECT(queue_set_poll(&set) == ready);
+        EXPECT(dequeue(entry->tag, entry->q, &value) == Queue_Result_Ok);
+        EXPECT(dequeue(entry->tag, entry->q, &value) == Queue_Result_Empty);
+        EXPECT(queue_set_poll(&set) == 0);
+    }
+
+    // Out of the set, enqueues don't set the bit.
+    queue_set_remove(&set, link_of(entries[1].tag, entries[1].q));
+
+    EXPECT(enqueue(entries[1].tag, entries[1].q, 1) == Queue_Result_Ok);
+    EXPECT(queue_set_poll(&set) == 0);
+
+    for (unsigned i = 0; i < 3; i++)
+    {
+        free(entries[i].q);
+    }
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Producer
+{
+    Entry    entry;
+    uint32_t id;
+}
+Producer;
+
+int thread_produce(void* data)
+{
+    Producer* producer = CAST(Producer*, data);
+
+    for (uint32_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        uint32_t value = (producer->id << 24) | i;
+
+        while (enqueue(producer->entry.tag, producer->entry.q, value) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        // Bursts with gaps, so the consumer goes to sleep.
+        if (!(i % 1000))
+        {
+            struct timespec nap = {0, 100000};
+
+            thrd_sleep(&nap, NULL);
+        }
+    }
+
+    return 0;
+}
+#endif
+
+// Spsc queues of both types with a producer each, and an mpsc one with two,
+// all read by one consumer that only wakes when something is ready.
+const char* threads(void)
+{
+    void* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    enum
+    {
+          QUEUE_COUNT    = 5
+        , PRODUCER_COUNT = QUEUE_COUNT - 1 + QUEUE_TEST_PRODUCERS
+    };
+
+    Queue_Set set;
+    Entry     entries[QUEUE_COUNT];
+    Producer  producers[PRODUCER_COUNT];
+    thrd_t    handles[PRODUCER_COUNT];
+    uint32_t  next[PRODUCER_COUNT] = {0};
+    unsigned  index = 0;
+    uint64_t  bad   = 0;
+    uint64_t  got   = 0;
+    uint64_t  waits = 0;
+
+    queue_set_init(&set);
+
+    for (unsigned i = 0; i < QUEUE_COUNT; i++)
+    {
+        Tag   tag   = (i == (QUEUE_COUNT - 1)) ? Mpsc_Tick : CAST(Tag, (i & 1));
+        Entry entry = {tag, make_malloc(tag, 64)};
+
+        entries[i] = entry;
+
+        EXPECT(queue_set_add(&set, link_of(tag, entry.q), &index) == Queue_Result_Ok);
+    }
+
+    for (unsigned i = 0; i < PRODUCER_COUNT; i++)
+    {
+        unsigned queue = (i < QUEUE_COUNT) ? i : (QUEUE_COUNT - 1);
+        Producer producer = {entries[queue], i};
+
+        producers[i] = producer;
+
+        thrd_create(&handles[i], thread_produce, &producers[i]);
+    }
+
+    while (got < (CAST(uint64_t, PRODUCER_COUNT) * QUEUE_TEST_ITEMS))
+    {
+        uint64_t ready = 0;
+
+        if (queue_set_wait(&set, 1000000000ULL, &ready) != Queue_Result_Ok)
+        {
+            bad++;
+            break;
+        }
+
+        waits++;
+
+        for (unsigned i = 0; i < QUEUE_COUNT; i++)
+        {
+            if (!(ready & (1ULL << i)))
+            {
+                continue;
+            }
+
+            uint32_t value = 0;
+
+            while (dequeue(entries[i].tag, entries[i].q, &value) == Queue_Result_Ok)
+            {
+                uint32_t id = value >> 24;
+
+                if (id >= PRODUCER_COUNT)
+                {
+                    bad++;
+                    break;
+                }
+
+                bad += ((value & 0xFFFFFF) != next[id]);
+                next[id]++;
+                got++;
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < PRODUCER_COUNT; i++)
+    {
+        thrd_join(handles[i], NULL);
+    }
+
+    for (unsigned i = 0; i < QUEUE_COUNT; i++)
+    {
+        free(entries[i].q);
+    }
+
+    EXPECT(!bad);
+    EXPECT(waits < got);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(add)
+    , TEST(poll_ready)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Queue Set"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -110,24 +110,151 @@ Data;
 #define QUEUE_MC   0
 #define QUEUE_TYPE Data
 #define QUEUE_IMPLEMENTATION
+#define QUEUE_WAIT
+#define QUEUE_SHM
+#define QUEUE_CLOSE
 #include <amblaq/queues.h>
 
 #define QUEUE_MP   1
 #define QUEUE_MC   0
 #define QUEUE_TYPE Data
 #define QUEUE_IMPLEMENTATION
+#define QUEUE_WAIT
+#define QUEUE_SHM
+#define QUEUE_CLOSE
 #include <amblaq/queues.h>
 
+// Spmc also uses the spread cell layout so every test covers it.
 #define QUEUE_MP   0
 #define QUEUE_MC   1
 #define QUEUE_TYPE Data
 #define QUEUE_IMPLEMENTATION
+#define QUEUE_WAIT
+#define QUEUE_SHM
+#define QUEUE_CLOSE
+#define QUEUE_CELL_LAYOUT_SPREAD
 #include <amblaq/queues.h>
 
 #define QUEUE_MP   1
 #define QUEUE_MC   1
 #define QUEUE_TYPE Data
 #define QUEUE_IMPLEMENTATION
+#define QUEUE_WAIT
+#define QUEUE_SHM
+#define QUEUE_CLOSE
+#include <amblaq/queues.h>
+
+// The fetch and add engine needs its own type name to live next to mpmc.
+typedef Data Faa_Data;
+
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_TYPE Faa_Data
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_WAIT
+#define QUEUE_SHM
+#define QUEUE_CLOSE
+#define QUEUE_MPMC_ENGINE_FAA
+#include <amblaq/queues.h>
+
+// Fixed capacity versions, named *_Data_16. These also keep stats, and on
+// linux have eventfd notifiers.
+#if defined(__linux__)
+    #define QUEUE_TEST_NOTIFY 1
+#else
+    #define QUEUE_TEST_NOTIFY 0
+#endif
+
+#define QUEUE_MP       0
+#define QUEUE_MC       0
+#define QUEUE_TYPE     Data
+#define QUEUE_CAPACITY 16
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_STATS
+#if QUEUE_TEST_NOTIFY
+#define QUEUE_NOTIFY
+#endif
+#include <amblaq/queues.h>
+
+#define QUEUE_MP       1
+#define QUEUE_MC       0
+#define QUEUE_TYPE     Data
+#define QUEUE_CAPACITY 16
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_STATS
+#if QUEUE_TEST_NOTIFY
+#define QUEUE_NOTIFY
+#endif
+#include <amblaq/queues.h>
+
+#define QUEUE_MP       0
+#define QUEUE_MC       1
+#define QUEUE_TYPE     Data
+#define QUEUE_CAPACITY 16
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_STATS
+#if QUEUE_TEST_NOTIFY
+#define QUEUE_NOTIFY
+#endif
+#define QUEUE_CELL_LAYOUT_SPREAD
+#include <amblaq/queues.h>
+
+#define QUEUE_MP       1
+#define QUEUE_MC       1
+#define QUEUE_TYPE     Data
+#define QUEUE_CAPACITY 16
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_STATS
+#if QUEUE_TEST_NOTIFY
+#define QUEUE_NOTIFY
+#endif
+#include <amblaq/queues.h>
+
+#define QUEUE_MP       1
+#define QUEUE_MC       1
+#define QUEUE_TYPE     Faa_Data
+#define QUEUE_CAPACITY 16
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_STATS
+#if QUEUE_TEST_NOTIFY
+#define QUEUE_NOTIFY
+#endif
+#define QUEUE_MPMC_ENGINE_FAA
+#include <amblaq/queues.h>
+
+// Overwrite mode, where the producer laps the consumers instead of seeing a
+// full queue.
+typedef Data Lossy_Data;
+
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_TYPE Lossy_Data
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_OVERWRITE
+#define QUEUE_STATS
+#include <amblaq/queues.h>
+
+#define QUEUE_MP   0
+#define QUEUE_MC   1
+#define QUEUE_TYPE Lossy_Data
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_OVERWRITE
+#define QUEUE_STATS
+#include <amblaq/queues.h>
+
+// Spread layout with 24 bytes of sequence and data, which isn't a power of 2.
+typedef struct Odd_Data
+{
+    uint64_t a;
+    uint64_t b;
+}
+Odd_Data;
+
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_TYPE Odd_Data
+#define QUEUE_IMPLEMENTATION
+#define QUEUE_CELL_LAYOUT_SPREAD
 #include <amblaq/queues.h>
 
 #define CAST(x, y) ((x) y)
@@ -140,8 +267,9 @@ typedef enum Tag
     , Mpsc
     , Spmc
     , Mpmc
+    , Mpmc_Faa
 
-    , Max = Mpmc
+    , Max = Mpmc_Faa
 }
 Tag;
 
@@ -151,6 +279,7 @@ static const char* tag_to_name[] =
     , "Mpsc"
     , "Spmc"
     , "Mpmc"
+    , "Mpmc_Faa"
 };
 
 Queue_Result make(Tag tag, size_t cell_count, void* queue, size_t* bytes)
@@ -193,6 +322,15 @@ Queue_Result make(Tag tag, size_t cell_count, void* queue, size_t* bytes)
                 , bytes
             );
         }
+        case Mpmc_Faa:
+        {
+            return mpmc_make_queue_Faa_Data
+            (
+                  cell_count
+                , CAST(Queue_Mpmc_Faa_Data*, queue)
+                , bytes
+            );
+        }
     }
 
     return Queue_Result_Error;
@@ -206,6 +344,7 @@ Queue_Result try_enqueue(Tag tag, void* q, Data const* d)
         case Mpsc: return mpsc_try_enqueue_Data(CAST(Queue_Mpsc_Data*, q), d);
         case Spmc: return spmc_try_enqueue_Data(CAST(Queue_Spmc_Data*, q), d);
         case Mpmc: return mpmc_try_enqueue_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_try_enqueue_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
     }
 
     return Queue_Result_Error;
@@ -218,6 +357,7 @@ Queue_Result try_dequeue(Tag tag, void* q, Data* d)
         case Mpsc: return mpsc_try_dequeue_Data(CAST(Queue_Mpsc_Data*, q), d);
         case Spmc: return spmc_try_dequeue_Data(CAST(Queue_Spmc_Data*, q), d);
         case Mpmc: return mpmc_try_dequeue_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_try_dequeue_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
     }
 
     return Queue_Result_Error;
@@ -230,6 +370,7 @@ Queue_Result enqueue(Tag tag, void* q, Data const* d)
         case Mpsc: return mpsc_enqueue_Data(CAST(Queue_Mpsc_Data*, q), d);
         case Spmc: return spmc_enqueue_Data(CAST(Queue_Spmc_Data*, q), d);
         case Mpmc: return mpmc_enqueue_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_enqueue_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
     }
 
     return Queue_Result_Error;
@@ -242,11 +383,270 @@ Queue_Result dequeue(Tag tag, void* q, Data* d)
         case Mpsc: return mpsc_dequeue_Data(CAST(Queue_Mpsc_Data*, q), d);
         case Spmc: return spmc_dequeue_Data(CAST(Queue_Spmc_Data*, q), d);
         case Mpmc: return mpmc_dequeue_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_dequeue_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result shm_create(Tag tag, char const* name, size_t cell_count, void** q)
+{
+    switch (tag)
+    {
+        case Spsc:
+        {
+            return spsc_shm_create_name_Data
+            (
+                  name
+                , cell_count
+                , CAST(Queue_Spsc_Data**, q)
+            );
+        }
+        case Mpsc:
+        {
+            return mpsc_shm_create_name_Data
+            (
+                  name
+                , cell_count
+                , CAST(Queue_Mpsc_Data**, q)
+            );
+        }
+        case Spmc:
+        {
+            return spmc_shm_create_name_Data
+            (
+                  name
+                , cell_count
+                , CAST(Queue_Spmc_Data**, q)
+            );
+        }
+        case Mpmc:
+        {
+            return mpmc_shm_create_name_Data
+            (
+                  name
+                , cell_count
+                , CAST(Queue_Mpmc_Data**, q)
+            );
+        }
+        case Mpmc_Faa:
+        {
+            return mpmc_shm_create_name_Faa_Data
+            (
+                  name
+                , cell_count
+                , CAST(Queue_Mpmc_Faa_Data**, q)
+            );
+        }
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result shm_attach(Tag tag, char const* name, void** q)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_shm_attach_name_Data(name, CAST(Queue_Spsc_Data**, q));
+        case Mpsc: return mpsc_shm_attach_name_Data(name, CAST(Queue_Mpsc_Data**, q));
+        case Spmc: return spmc_shm_attach_name_Data(name, CAST(Queue_Spmc_Data**, q));
+        case Mpmc: return mpmc_shm_attach_name_Data(name, CAST(Queue_Mpmc_Data**, q));
+        case Mpmc_Faa: return mpmc_shm_attach_name_Faa_Data(name, CAST(Queue_Mpmc_Faa_Data**, q));
+    }
+
+    return Queue_Result_Error;
+}
+
+void shm_detach(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_shm_detach_Data(CAST(Queue_Spsc_Data*, q)); break;
+        case Mpsc: mpsc_shm_detach_Data(CAST(Queue_Mpsc_Data*, q)); break;
+        case Spmc: spmc_shm_detach_Data(CAST(Queue_Spmc_Data*, q)); break;
+        case Mpmc: mpmc_shm_detach_Data(CAST(Queue_Mpmc_Data*, q)); break;
+        case Mpmc_Faa: mpmc_shm_detach_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q)); break;
+    }
+}
+
+Queue_Result try_enqueue_bulk
+(
+      Tag         tag
+    , void*       q
+    , Data const* d
+    , size_t      count
+    , size_t*     written
+)
+{
+    switch (tag)
+    {
+        case Spsc:
+            return spsc_try_enqueue_bulk_Data(CAST(Queue_Spsc_Data*, q), d, count, written);
+        case Mpsc:
+            return mpsc_try_enqueue_bulk_Data(CAST(Queue_Mpsc_Data*, q), d, count, written);
+        case Spmc:
+            return spmc_try_enqueue_bulk_Data(CAST(Queue_Spmc_Data*, q), d, count, written);
+        case Mpmc:
+            return mpmc_try_enqueue_bulk_Data(CAST(Queue_Mpmc_Data*, q), d, count, written);
+        case Mpmc_Faa:
+            return mpmc_try_enqueue_bulk_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d, count, written);
+    }
+
+    return Queue_Result_Error;
+}
+Queue_Result try_dequeue_bulk
+(
+      Tag     tag
+    , void*   q
+    , Data*   d
+    , size_t  count
+    , size_t* read
+)
+{
+    switch (tag)
+    {
+        case Spsc:
+            return spsc_try_dequeue_bulk_Data(CAST(Queue_Spsc_Data*, q), d, count, read);
+        case Mpsc:
+            return mpsc_try_dequeue_bulk_Data(CAST(Queue_Mpsc_Data*, q), d, count, read);
+        case Spmc:
+            return spmc_try_dequeue_bulk_Data(CAST(Queue_Spmc_Data*, q), d, count, read);
+        case Mpmc:
+            return mpmc_try_dequeue_bulk_Data(CAST(Queue_Mpmc_Data*, q), d, count, read);
+        case Mpmc_Faa:
+            return mpmc_try_dequeue_bulk_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d, count, read);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_enqueue_reserve(Tag tag, void* q, Data** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_reserve_Data(CAST(Queue_Spsc_Data*, q), d);
+        case Mpsc: return mpsc_try_enqueue_reserve_Data(CAST(Queue_Mpsc_Data*, q), d);
+        case Spmc: return spmc_try_enqueue_reserve_Data(CAST(Queue_Spmc_Data*, q), d);
+        case Mpmc: return mpmc_try_enqueue_reserve_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_try_enqueue_reserve_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+Queue_Result try_dequeue_peek(Tag tag, void* q, Data** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_peek_Data(CAST(Queue_Spsc_Data*, q), d);
+        case Mpsc: return mpsc_try_dequeue_peek_Data(CAST(Queue_Mpsc_Data*, q), d);
+        case Spmc: return spmc_try_dequeue_peek_Data(CAST(Queue_Spmc_Data*, q), d);
+        case Mpmc: return mpmc_try_dequeue_peek_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_try_dequeue_peek_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+void enqueue_commit(Tag tag, void* q, Data* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_enqueue_commit_Data(CAST(Queue_Spsc_Data*, q), d); break;
+        case Mpsc: mpsc_enqueue_commit_Data(CAST(Queue_Mpsc_Data*, q), d); break;
+        case Spmc: spmc_enqueue_commit_Data(CAST(Queue_Spmc_Data*, q), d); break;
+        case Mpmc: mpmc_enqueue_commit_Data(CAST(Queue_Mpmc_Data*, q), d); break;
+        case Mpmc_Faa: mpmc_enqueue_commit_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d); break;
+    }
+}
+void dequeue_release(Tag tag, void* q, Data* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_dequeue_release_Data(CAST(Queue_Spsc_Data*, q), d); break;
+        case Mpsc: mpsc_dequeue_release_Data(CAST(Queue_Mpsc_Data*, q), d); break;
+        case Spmc: spmc_dequeue_release_Data(CAST(Queue_Spmc_Data*, q), d); break;
+        case Mpmc: mpmc_dequeue_release_Data(CAST(Queue_Mpmc_Data*, q), d); break;
+        case Mpmc_Faa: mpmc_dequeue_release_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d); break;
+    }
+}
+
+Queue_Result enqueue_wait_timed(Tag tag, void* q, Data const* d, uint64_t ns)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_enqueue_wait_timed_Data(CAST(Queue_Spsc_Data*, q), d, ns);
+        case Mpsc: return mpsc_enqueue_wait_timed_Data(CAST(Queue_Mpsc_Data*, q), d, ns);
+        case Spmc: return spmc_enqueue_wait_timed_Data(CAST(Queue_Spmc_Data*, q), d, ns);
+        case Mpmc: return mpmc_enqueue_wait_timed_Data(CAST(Queue_Mpmc_Data*, q), d, ns);
+        case Mpmc_Faa: return mpmc_enqueue_wait_timed_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d, ns);
+    }
+
+    return Queue_Result_Error;
+}
+Queue_Result dequeue_wait_timed(Tag tag, void* q, Data* d, uint64_t ns)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_dequeue_wait_timed_Data(CAST(Queue_Spsc_Data*, q), d, ns);
+        case Mpsc: return mpsc_dequeue_wait_timed_Data(CAST(Queue_Mpsc_Data*, q), d, ns);
+        case Spmc: return spmc_dequeue_wait_timed_Data(CAST(Queue_Spmc_Data*, q), d, ns);
+        case Mpmc: return mpmc_dequeue_wait_timed_Data(CAST(Queue_Mpmc_Data*, q), d, ns);
+        case Mpmc_Faa: return mpmc_dequeue_wait_timed_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d, ns);
+    }
+
+    return Queue_Result_Error;
+}
+Queue_Result enqueue_wait(Tag tag, void* q, Data const* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_enqueue_wait_Data(CAST(Queue_Spsc_Data*, q), d);
+        case Mpsc: return mpsc_enqueue_wait_Data(CAST(Queue_Mpsc_Data*, q), d);
+        case Spmc: return spmc_enqueue_wait_Data(CAST(Queue_Spmc_Data*, q), d);
+        case Mpmc: return mpmc_enqueue_wait_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_enqueue_wait_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+Queue_Result dequeue_wait(Tag tag, void* q, Data* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_dequeue_wait_Data(CAST(Queue_Spsc_Data*, q), d);
+        case Mpsc: return mpsc_dequeue_wait_Data(CAST(Queue_Mpsc_Data*, q), d);
+        case Spmc: return spmc_dequeue_wait_Data(CAST(Queue_Spmc_Data*, q), d);
+        case Mpmc: return mpmc_dequeue_wait_Data(CAST(Queue_Mpmc_Data*, q), d);
+        case Mpmc_Faa: return mpmc_dequeue_wait_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q), d);
     }
 
     return Queue_Result_Error;
 }
 
+void close_queue(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_close_Data(CAST(Queue_Spsc_Data*, q)); break;
+        case Mpsc: mpsc_close_Data(CAST(Queue_Mpsc_Data*, q)); break;
+        case Spmc: spmc_close_Data(CAST(Queue_Spmc_Data*, q)); break;
+        case Mpmc: mpmc_close_Data(CAST(Queue_Mpmc_Data*, q)); break;
+        case Mpmc_Faa: mpmc_close_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q)); break;
+    }
+}
+int is_closed(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_is_closed_Data(CAST(Queue_Spsc_Data*, q));
+        case Mpsc: return mpsc_is_closed_Data(CAST(Queue_Mpsc_Data*, q));
+        case Spmc: return spmc_is_closed_Data(CAST(Queue_Spmc_Data*, q));
+        case Mpmc: return mpmc_is_closed_Data(CAST(Queue_Mpmc_Data*, q));
+        case Mpmc_Faa: return mpmc_is_closed_Faa_Data(CAST(Queue_Mpmc_Faa_Data*, q));
+    }
+
+    return 0;
+}
+
 // -----------------------------------------------------------------------------
 
 #define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
@@ -400,139 +800,1509 @@ const char* full(Tag tag, unsigned count_in, unsigned count_out)
     return NULL;
 }
 
-typedef struct Thread_Data
+const char* bulk(Tag tag, unsigned count_in, unsigned count_out)
 {
-    void*          q;
-    int            multiplier;
-    Tag            tag;
-    atomic_size_t* global_count;
-    atomic_size_t* done;
-}
-Thread_Data;
+    (void) count_in;
+    (void) count_out;
 
-int thread_in(void* data)
-{
-    Data item =
-    {
-          11.0f
-        , 22
-        , {0}
-    };
+    size_t bytes = 0;
+    void* q = NULL;
 
-    Thread_Data* info = CAST(Thread_Data*, data);
+    make(tag, 1 << 8, NULL, &bytes);
 
-    unsigned max = 10000 * info->multiplier;
+    EXPECT(bytes > 0);
 
-    for (unsigned j = 0; j < max; j++)
+    q = malloc(bytes);
+
+    make(tag, 1 << 8, q, &bytes);
+
+    Data in [300] = {{0}};
+    Data out[300] = {{0}};
+
+    for (unsigned i = 0; i < 300; i++)
     {
-        while
-        (
-               enqueue(info->tag, info->q, &item)
-            != Queue_Result_Ok
-        );
+        in[i].b = i;
     }
 
-    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+    size_t moved = 0;
 
-    return 0;
-}
+    EXPECT(try_dequeue_bulk(tag, q, out, 10, &moved) == Queue_Result_Empty);
+    EXPECT(moved == 0);
 
-int thread_out(void* data)
-{
-    Thread_Data* info = CAST(Thread_Data*, data);
+    EXPECT(try_enqueue_bulk(tag, q, in, 100, &moved) == Queue_Result_Ok);
+    EXPECT(moved == 100);
 
-    unsigned max = 10000 * info->multiplier;
+    EXPECT(try_dequeue_bulk(tag, q, out, 60, &moved) == Queue_Result_Ok);
+    EXPECT(moved == 60);
 
-    for (unsigned j = 0; j < max; j++)
+    for (unsigned i = 0; i < 60; i++)
     {
-        Data item = {0};
-        while
-        (
-               dequeue(info->tag, info->q, &item)
-            != Queue_Result_Ok
-        );
-
-        atomic_fetch_add_explicit
-        (
-              info->global_count
-            , item.b
-            , memory_order_relaxed
-        );
+        EXPECT(out[i].b == i);
     }
 
-    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+    EXPECT(try_enqueue_bulk(tag, q, &in[100], 200, &moved) == Queue_Result_Ok);
+    EXPECT(moved == 200);
 
-    return 0;
-}
+    // 240 queued, so only 16 more fit.
+    EXPECT(try_enqueue_bulk(tag, q, in, 50, &moved) == Queue_Result_Ok);
+    EXPECT(moved == 16);
 
-const char* sums10000(Tag tag, unsigned count_in, unsigned count_out)
-{
-#if QUEUE_TEST_THREADS
+    EXPECT(try_enqueue_bulk(tag, q, in, 1, &moved) == Queue_Result_Full);
+    EXPECT(moved == 0);
 
-    void* q = NULL;
+    EXPECT(try_dequeue_bulk(tag, q, out, 300, &moved) == Queue_Result_Ok);
+    EXPECT(moved == 256);
+
+    for (unsigned i = 0; i < 240; i++)
     {
-        size_t bytes = 0;
+        EXPECT(out[i].b == i + 60);
+    }
 
-        make(tag, 1 << 8, NULL, &bytes);
+    for (unsigned i = 240; i < 256; i++)
+    {
+        EXPECT(out[i].b == i - 240);
+    }
+
+    EXPECT(try_dequeue_bulk(tag, q, out, 300, &moved) == Queue_Result_Empty);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* reserve(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 1 << 8, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 8, q, &bytes);
+
+    Data* cell = NULL;
+
+    EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Empty);
+
+    for (unsigned i = 0; i < (1 << 8); i++)
+    {
+        EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Ok);
+
+        cell->b = i;
+
+        enqueue_commit(tag, q, cell);
+    }
+
+    EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Full);
+
+    for (unsigned i = 0; i < (1 << 8); i++)
+    {
+        EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Ok);
+        EXPECT(cell->b == i);
+
+        dequeue_release(tag, q, cell);
+    }
+
+    EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Empty);
+
+    {
+        Data data = {0};
+
+        data.b = 33;
+
+        EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Ok);
+        EXPECT(cell->b == 33);
+
+        dequeue_release(tag, q, cell);
+
+        EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// A fetch and add consumer that draws a reserved cell's ticket leaves it for
+// later and moves on, instead of waiting for the commit.
+const char* parked(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    if (tag != Mpmc_Faa)
+    {
+        return NULL;
+    }
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 1 << 8, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 8, q, &bytes);
+
+    Data* cell = NULL;
+    Data  data = {0};
+
+    EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Ok);
+
+    cell->b = 1;
+    data.b  = 2;
+
+    EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Ok);
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+    EXPECT(data.b == 2);
+
+    // Only the parked ticket is left, and its item isn't there yet.
+    Data* peeked = NULL;
+
+    EXPECT(try_dequeue(tag, q, &data)        == Queue_Result_Contention);
+    EXPECT(try_dequeue_peek(tag, q, &peeked) == Queue_Result_Contention);
+
+    enqueue_commit(tag, q, cell);
+
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+    EXPECT(data.b == 1);
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+
+    free(q);
+    q = NULL;
+
+    // A producer a lap ahead of a parked ticket gives up rather than wait for
+    // a dequeue that may never come.
+    make(tag, 4, NULL, &bytes);
+
+    q = malloc(bytes);
+
+    make(tag, 4, q, &bytes);
+
+    EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Ok);
+    EXPECT(try_dequeue(tag, q, &data)         == Queue_Result_Contention);
+
+    cell->b = 0;
+
+    enqueue_commit(tag, q, cell);
+
+    for (uint32_t i = 1; i < 4; i++)
+    {
+        data.b = i;
+
+        EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Ok);
+    }
+
+    EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Contention);
+
+    for (uint32_t i = 0; i < 4; i++)
+    {
+        EXPECT(dequeue(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(data.b == i);
+    }
+
+    // The ticket the producer gave up is skipped on the way.
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+
+    data.b = 4;
+
+    EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Ok);
+    EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+    EXPECT(data.b == 4);
+
+    free(q);
+
+    return NULL;
+}
+
+const char* wait_timeout(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 1 << 8, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 8, q, &bytes);
+
+    Data data = {0};
+
+    EXPECT(dequeue_wait_timed(tag, q, &data, 1000000) == Queue_Result_Timeout);
+    EXPECT(dequeue_wait_timed(tag, q, &data, 0)       == Queue_Result_Timeout);
+
+    for (unsigned i = 0; i < (1 << 8); i++)
+    {
+        EXPECT(enqueue_wait_timed(tag, q, &data, 0) == Queue_Result_Ok);
+    }
+
+    EXPECT(enqueue_wait_timed(tag, q, &data, 1000000) == Queue_Result_Timeout);
+    EXPECT(dequeue_wait(tag, q, &data)                == Queue_Result_Ok);
+    EXPECT(enqueue_wait(tag, q, &data)                == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+// After close enqueues fail, and dequeues drain what was left before saying
+// Queue_Result_Closed.
+const char* closed(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 1 << 4, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 4, q, &bytes);
+
+    Data   data  = {0};
+    Data*  slot  = NULL;
+    size_t moved = 1;
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        data.b = i;
+
+        EXPECT(enqueue(tag, q, &data) == Queue_Result_Ok);
+    }
+
+    EXPECT(!is_closed(tag, q));
+
+    close_queue(tag, q);
+    close_queue(tag, q);
+
+    EXPECT(is_closed(tag, q));
+
+    EXPECT(try_enqueue(tag, q, &data)                 == Queue_Result_Closed);
+    EXPECT(enqueue(tag, q, &data)                     == Queue_Result_Closed);
+    EXPECT(enqueue_wait(tag, q, &data)                == Queue_Result_Closed);
+    EXPECT(try_enqueue_reserve(tag, q, &slot)         == Queue_Result_Closed);
+    EXPECT(try_enqueue_bulk(tag, q, &data, 1, &moved) == Queue_Result_Closed);
+    EXPECT(!moved);
+
+    for (uint32_t i = 0; i < 3; i++)
+    {
+        EXPECT(dequeue_wait(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(data.b == i);
+    }
+
+    EXPECT(try_dequeue(tag, q, &data)                 == Queue_Result_Closed);
+    EXPECT(dequeue(tag, q, &data)                     == Queue_Result_Closed);
+    EXPECT(dequeue_wait(tag, q, &data)                == Queue_Result_Closed);
+    EXPECT(dequeue_wait_timed(tag, q, &data, 1000000) == Queue_Result_Closed);
+    EXPECT(try_dequeue_peek(tag, q, &slot)            == Queue_Result_Closed);
+    EXPECT(try_dequeue_bulk(tag, q, &data, 1, &moved) == Queue_Result_Closed);
+
+    // Faa consumers that race for the last item all take a ticket, so the
+    // dequeue index can end up past where the queue was closed.
+    if (tag == Mpmc_Faa)
+    {
+        Queue_Mpmc_Faa_Data* faa = CAST(Queue_Mpmc_Faa_Data*, q);
+
+        QUEUE_ATOMIC_FETCH_ADD(&faa->dequeue_index, 2, QUEUE_ORDER_RELAXED);
+
+        EXPECT(try_dequeue(tag, q, &data)      == Queue_Result_Closed);
+        EXPECT(dequeue_wait(tag, q, &data)     == Queue_Result_Closed);
+        EXPECT(try_dequeue_peek(tag, q, &slot) == Queue_Result_Closed);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// A 4 cell ring filled and drained at shifting offsets, so the producer keeps
+// finding it full until it refreshes its copy of the dequeue index, and the
+// consumer keeps finding it empty until it refreshes its copy of the enqueue
+// index. Spsc starts its indices just short of SIZE_MAX so they wrap as well.
+const char* wraparound(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 4, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    EXPECT(make(tag, 4, q, &bytes) == Queue_Result_Ok);
+
+    if (tag == Spsc)
+    {
+        Queue_Spsc_Data* spsc  = CAST(Queue_Spsc_Data*, q);
+        size_t           start = SIZE_MAX - 9;
+
+        QUEUE_ATOMIC_STORE(&spsc->enqueue_index, start, QUEUE_ORDER_RELAXED);
+        QUEUE_ATOMIC_STORE(&spsc->dequeue_index, start, QUEUE_ORDER_RELAXED);
+
+        spsc->enqueue_index_cached = start;
+        spsc->dequeue_index_cached = start;
+    }
+
+    Data     data     = {0};
+    Data     items[4] = {{0}};
+    size_t   moved    = 0;
+    uint32_t in       = 0;
+    uint32_t out      = 0;
+
+    for (uint32_t round = 0; round < 32; round++)
+    {
+        // Fill up, one at a time or in bulk, until the ring is really full.
+        if (round & 1)
+        {
+            for (unsigned i = 0; i < 4; i++)
+            {
+                items[i].b = in + i;
+            }
+
+            EXPECT(try_enqueue_bulk(tag, q, items, 4, &moved) == Queue_Result_Ok);
+            EXPECT(moved == (4 - (in - out)));
+
+            in += (uint32_t) moved;
+        }
+        else
+        {
+            for (data.b = in; try_enqueue(tag, q, &data) == Queue_Result_Ok;)
+            {
+                data.b = ++in;
+            }
+        }
+
+        EXPECT((in - out) == 4);
+        EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Full);
+
+        // Take some back, all of them every fourth round.
+        uint32_t take = ((round % 4) == 3) ? 4 : ((round % 4) + 1);
+
+        for (uint32_t i = 0; i < take; i++)
+        {
+            EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+            EXPECT(data.b == out++);
+        }
+
+        if (in == out)
+        {
+            EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+        }
+    }
+
+    // Drain, then one item at a time, so the consumer refreshes every time.
+    while (out != in)
+    {
+        EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(data.b == out++);
+    }
+
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        data.b = in++;
+
+        EXPECT(try_enqueue(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Ok);
+        EXPECT(data.b == out++);
+        EXPECT(try_dequeue(tag, q, &data) == Queue_Result_Empty);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+const char* spread(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    size_t bytes = 0;
+    void* q = NULL;
+
+    make(tag, 1 << 8, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 8, q, &bytes);
+
+    Data* first  = NULL;
+    Data* second = NULL;
+
+    EXPECT(try_enqueue_reserve(tag, q, &first)  == Queue_Result_Ok);
+    EXPECT(try_enqueue_reserve(tag, q, &second) == Queue_Result_Ok);
+
+    intptr_t distance = CAST(intptr_t, second) - CAST(intptr_t, first);
+
+    if (tag == Spmc)
+    {
+        EXPECT(distance >= QUEUE_CACHELINE_BYTES);
+    }
+    else if (tag != Spsc)
+    {
+        EXPECT(distance < QUEUE_CACHELINE_BYTES);
+    }
+
+    free(q);
+    q = NULL;
+
+    if (tag == Mpmc)
+    {
+        // Every pair of consecutive positions is on different lines, also
+        // with a cell size that isn't a power of 2.
+        Queue_Mpmc_Odd_Data* odd = NULL;
+
+        EXPECT(mpmc_make_queue_Odd_Data(1 << 8, NULL, &bytes) == Queue_Result_Ok);
+
+        bytes = (bytes + QUEUE_CACHELINE_BYTES - 1) & ~(QUEUE_CACHELINE_BYTES - 1);
+        q     = aligned_alloc(QUEUE_CACHELINE_BYTES, bytes);
+        odd   = CAST(Queue_Mpmc_Odd_Data*, q);
+
+        EXPECT(mpmc_make_queue_Odd_Data(1 << 8, odd, &bytes) == Queue_Result_Ok);
+
+        uintptr_t last_line = 0;
+
+        for (unsigned i = 0; i < (1 << 8); i++)
+        {
+            Odd_Data* next = NULL;
+
+            EXPECT(mpmc_try_enqueue_reserve_Odd_Data(odd, &next) == Queue_Result_Ok);
+
+            uintptr_t line = CAST(uintptr_t, next) / QUEUE_CACHELINE_BYTES;
+
+            EXPECT(!i || (line != last_line));
+
+            last_line = line;
+        }
+
+        free(q);
+    }
+
+    return NULL;
+}
+
+static Queue_Spsc_Data_16 fixed_spsc;
+static Queue_Mpsc_Data_16 fixed_mpsc;
+static Queue_Spmc_Data_16 fixed_spmc;
+static Queue_Mpmc_Data_16 fixed_mpmc;
+
+static Queue_Mpmc_Faa_Data_16 fixed_mpmc_faa;
+
+#define FIXED_ROUNDS(prefix, name, queue)                                      \
+    do                                                                         \
+    {                                                                          \
+        Data data = {0};                                                       \
+                                                                               \
+        EXPECT(!(CAST(intptr_t, queue) & (QUEUE_CACHELINE_BYTES - 1)));        \
+                                                                               \
+        prefix##_init_queue_##name(queue);                                    \
+                                                                               \
+        for (unsigned round = 0; round < 3; round++)                           \
+        {                                                                      \
+            for (unsigned i = 0; i < 16; i++)                                  \
+            {                                                                  \
+                data.b = (round * 16) + i;                                     \
+                                                                               \
+                EXPECT                                                         \
+                (                                                              \
+                       prefix##_try_enqueue_##name(queue, &data)              \
+                    == Queue_Result_Ok                                         \
+                );                                                             \
+            }                                                                  \
+                                                                               \
+            EXPECT                                                             \
+            (                                                                  \
+                   prefix##_try_enqueue_##name(queue, &data)                  \
+                == Queue_Result_Full                                           \
+            );                                                                 \
+                                                                               \
+            for (unsigned i = 0; i < 16; i++)                                  \
+            {                                                                  \
+                EXPECT                                                         \
+                (                                                              \
+                       prefix##_try_dequeue_##name(queue, &data)              \
+                    == Queue_Result_Ok                                         \
+                );                                                             \
+                                                                               \
+                EXPECT(data.b == (round * 16) + i);                            \
+            }                                                                  \
+                                                                               \
+            EXPECT                                                             \
+            (                                                                  \
+                   prefix##_try_dequeue_##name(queue, &data)                  \
+                == Queue_Result_Empty                                          \
+            );                                                                 \
+        }                                                                      \
+                                                                               \
+        Queue_Stats stats;                                                     \
+                                                                               \
+        prefix##_get_stats_##name(queue, &stats);                              \
+                                                                               \
+        EXPECT(stats.enqueue_ok         == 48);                                \
+        EXPECT(stats.enqueue_full       == 3);                                 \
+        EXPECT(stats.enqueue_contention == 0);                                 \
+        EXPECT(stats.dequeue_ok         == 48);                                \
+        EXPECT(stats.dequeue_empty      == 3);                                 \
+        EXPECT(stats.dequeue_contention == 0);                                 \
+        EXPECT(stats.peak_occupancy     == 16);                                \
+    }                                                                          \
+    while (0)
+
+const char* fixed(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    void* q = NULL;
+
+    switch (tag)
+    {
+        case Spsc:     FIXED_ROUNDS(spsc, Data_16,     &fixed_spsc);     break;
+        case Mpsc:     FIXED_ROUNDS(mpsc, Data_16,     &fixed_mpsc);     break;
+        case Spmc:     FIXED_ROUNDS(spmc, Data_16,     &fixed_spmc);     break;
+        case Mpmc:     FIXED_ROUNDS(mpmc, Data_16,     &fixed_mpmc);     break;
+        case Mpmc_Faa: FIXED_ROUNDS(mpmc, Faa_Data_16, &fixed_mpmc_faa); break;
+    }
+
+    return NULL;
+}
+
+#if QUEUE_TEST_NOTIFY
+
+#include <poll.h>
+
+int readable(int fd)
+{
+    struct pollfd check = {fd, POLLIN, 0};
+
+    return poll(&check, 1, 0) == 1;
+}
+
+#define NOTIFY_ROUNDS(prefix, name, queue)                                     \
+    do                                                                         \
+    {                                                                          \
+        Data data = {0};                                                       \
+                                                                               \
+        prefix##_init_queue_##name(queue);                                    \
+                                                                               \
+        EXPECT(prefix##_notify_open_##name(queue) == Queue_Result_Ok);        \
+                                                                               \
+        int in  = prefix##_get_fd_##name(queue, Queue_Notify_Not_Empty);      \
+        int out = prefix##_get_fd_##name(queue, Queue_Notify_Not_Full);       \
+                                                                               \
+        EXPECT(!readable(in));                                                 \
+        EXPECT(!readable(out));                                                \
+                                                                               \
+        /* The first item wakes the consumer, the next one doesn't. */         \
+        EXPECT(prefix##_try_enqueue_##name(queue, &data) == Queue_Result_Ok); \
+        EXPECT(readable(in));                                                  \
+                                                                               \
+        EXPECT                                                                 \
+        (                                                                      \
+               prefix##_notify_clear_##name(queue, Queue_Notify_Not_Empty)    \
+            == Queue_Result_Ok                                                 \
+        );                                                                     \
+                                                                               \
+        /* Nothing left to read is not an error. */                           \
+        EXPECT                                                                 \
+        (                                                                      \
+               prefix##_notify_clear_##name(queue, Queue_Notify_Not_Empty)    \
+            == Queue_Result_Ok                                                 \
+        );                                                                     \
+                                                                               \
+        EXPECT(prefix##_try_enqueue_##name(queue, &data) == Queue_Result_Ok); \
+        EXPECT(!readable(in));                                                 \
+                                                                               \
+        /* Drained and armed, so the next item wakes it again. */              \
+        EXPECT(prefix##_try_dequeue_##name(queue, &data) == Queue_Result_Ok); \
+        EXPECT(prefix##_try_dequeue_##name(queue, &data) == Queue_Result_Ok); \
+                                                                               \
+        prefix##_notify_arm_##name(queue, Queue_Notify_Not_Empty);            \
+                                                                               \
+        EXPECT                                                                 \
+        (                                                                      \
+               prefix##_try_dequeue_##name(queue, &data)                      \
+            == Queue_Result_Empty                                              \
+        );                                                                     \
+                                                                               \
+        EXPECT(!readable(in));                                                 \
+        EXPECT(prefix##_try_enqueue_##name(queue, &data) == Queue_Result_Ok); \
+        EXPECT(readable(in));                                                  \
+                                                                               \
+        /* Same for a producer waiting on a full queue. */                     \
+        while (prefix##_try_enqueue_##name(queue, &data) == Queue_Result_Ok)  \
+        {                                                                      \
+        }                                                                      \
+                                                                               \
+        prefix##_notify_clear_##name(queue, Queue_Notify_Not_Full);           \
+        prefix##_notify_arm_##name(queue, Queue_Notify_Not_Full);             \
+                                                                               \
+        EXPECT                                                                 \
+        (                                                                      \
+               prefix##_try_enqueue_##name(queue, &data)                      \
+            == Queue_Result_Full                                               \
+        );                                                                     \
+                                                                               \
+        EXPECT(!readable(out));                                                \
+        EXPECT(prefix##_try_dequeue_##name(queue, &data) == Queue_Result_Ok); \
+        EXPECT(readable(out));                                                 \
+                                                                               \
+        prefix##_notify_close_##name(queue);                                  \
+    }                                                                          \
+    while (0)
+
+#endif
+
+const char* notify(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    void* q = NULL;
+
+#if QUEUE_TEST_NOTIFY
+    switch (tag)
+    {
+        case Spsc:     NOTIFY_ROUNDS(spsc, Data_16,     &fixed_spsc);     break;
+        case Mpsc:     NOTIFY_ROUNDS(mpsc, Data_16,     &fixed_mpsc);     break;
+        case Spmc:     NOTIFY_ROUNDS(spmc, Data_16,     &fixed_spmc);     break;
+        case Mpmc:     NOTIFY_ROUNDS(mpmc, Data_16,     &fixed_mpmc);     break;
+        case Mpmc_Faa: NOTIFY_ROUNDS(mpmc, Faa_Data_16, &fixed_mpmc_faa); break;
+    }
+#else
+    (void) tag;
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// Maps the same queue twice, so each side sees it at a different address like
+// two processes would.
+const char* shm(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    void* q        = NULL;
+    void* created  = NULL;
+    void* attached = NULL;
+    void* other    = NULL;
+    char  name[64];
+
+    snprintf
+    (
+          name
+        , sizeof(name)
+        , "/amblaq_test_%d_%s"
+        , (int) getpid()
+        , tag_to_name[tag]
+    );
+
+    shm_unlink(name);
+
+    EXPECT(shm_attach(tag, name, &attached) == Queue_Result_Error_Not_Ready);
+    EXPECT(shm_create(tag, name, 100, &created) == Queue_Result_Error_Not_Pow2);
+    EXPECT(shm_create(tag, name, 64,  &created) == Queue_Result_Ok);
+    EXPECT(shm_create(tag, name, 64,  &other)   == Queue_Result_Error_System);
+    EXPECT(shm_attach(tag, name, &attached)     == Queue_Result_Ok);
+    EXPECT(created != attached);
+
+    // Same type, different flavour.
+    Tag other_tag = (tag == Spsc) ? Mpsc : Spsc;
+
+    EXPECT
+    (
+           shm_attach(other_tag, name, &other)
+        == Queue_Result_Error_Header_Mismatch
+    );
+
+    Data data = {0};
+
+    for (unsigned round = 0; round < 3; round++)
+    {
+        for (unsigned i = 0; i < 64; i++)
+        {
+            data.b = (round * 64) + i;
+
+            EXPECT(try_enqueue(tag, created, &data) == Queue_Result_Ok);
+        }
+
+        EXPECT(try_enqueue(tag, attached, &data) == Queue_Result_Full);
+
+        for (unsigned i = 0; i < 64; i++)
+        {
+            EXPECT(try_dequeue(tag, attached, &data) == Queue_Result_Ok);
+            EXPECT(data.b == (round * 64) + i);
+        }
+
+        EXPECT(try_dequeue(tag, created, &data) == Queue_Result_Empty);
+    }
+
+    shm_detach(tag, attached);
+    shm_detach(tag, created);
+
+    EXPECT(!shm_unlink(name));
+
+    return NULL;
+}
+
+#include <amblaq/alloc.h>
+
+// A queue bigger than a couple of huge pages, in memory from queue_alloc.
+const char* alloc(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+    (void) count_out;
+
+    // Stays NULL, EXPECT frees it.
+    void*        q     = NULL;
+    size_t       bytes = 0;
+    size_t       cells = 1 << 17;
+    Queue_Memory memory;
+
+    EXPECT(queue_alloc(0, 0, 0, &memory) == Queue_Result_Error_Too_Small);
+
+    EXPECT
+    (
+           queue_alloc(64, QUEUE_ALLOC_NODES, 0, &memory)
+        == Queue_Result_Error_Too_Big
+    );
+
+#if defined(__linux__)
+    EXPECT
+    (
+           queue_alloc(64, QUEUE_ALLOC_NODES - 1, 0, &memory)
+        == Queue_Result_Error_System
+    );
+#endif
+
+    EXPECT(make(tag, cells, NULL, &bytes) == Queue_Result_Ok);
+
+    unsigned const flags[] =
+    {
+          0
+        , Queue_Alloc_Prefault
+        , Queue_Alloc_Huge | Queue_Alloc_Prefault
+    };
+
+    for (unsigned f = 0; f < (sizeof(flags) / sizeof(flags[0])); f++)
+    {
+        int node = (f == 1) ? QUEUE_ALLOC_ANY_NODE : 0;
+
+        EXPECT(queue_alloc(bytes, node, flags[f], &memory) == Queue_Result_Ok);
+        EXPECT(memory.mapped_bytes >= bytes);
+        EXPECT(!((uintptr_t) memory.bytes % QUEUE_CACHELINE_BYTES));
+
+        if (flags[f] & Queue_Alloc_Huge)
+        {
+            EXPECT(!((uintptr_t) memory.bytes % QUEUE_ALLOC_HUGE_BYTES));
+            EXPECT(!(memory.mapped_bytes % QUEUE_ALLOC_HUGE_BYTES));
+        }
+        else
+        {
+            EXPECT(memory.pages == Queue_Alloc_Pages_Normal);
+        }
+
+        EXPECT(make(tag, cells, memory.bytes, &bytes) == Queue_Result_Ok);
+
+        Data data = {0};
+
+        for (uint32_t i = 0; i < cells; i++)
+        {
+            data.b = i;
+
+            EXPECT(try_enqueue(tag, memory.bytes, &data) == Queue_Result_Ok);
+        }
+
+        EXPECT(try_enqueue(tag, memory.bytes, &data) == Queue_Result_Full);
+
+        for (uint32_t i = 0; i < cells; i++)
+        {
+            EXPECT(try_dequeue(tag, memory.bytes, &data) == Queue_Result_Ok);
+            EXPECT(data.b == i);
+        }
+
+        queue_free(&memory);
+
+        EXPECT(!memory.bytes);
+    }
+
+    return NULL;
+}
+
+typedef struct Thread_Data
+{
+    void*          q;
+    int            multiplier;
+    Tag            tag;
+    atomic_size_t* global_count;
+    atomic_size_t* done;
+}
+Thread_Data;
+
+int thread_in(void* data)
+{
+    Data item =
+    {
+          11.0f
+        , 22
+        , {0}
+    };
+
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        while
+        (
+               enqueue(info->tag, info->q, &item)
+            != Queue_Result_Ok
+        );
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+int thread_out(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        Data item = {0};
+        while
+        (
+               dequeue(info->tag, info->q, &item)
+            != Queue_Result_Ok
+        );
+
+        atomic_fetch_add_explicit
+        (
+              info->global_count
+            , item.b
+            , memory_order_relaxed
+        );
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+#if QUEUE_TEST_THREADS
+
+#define QUEUE_TEST_BULK 32
+
+int thread_in_bulk(void* data)
+{
+    Data items[QUEUE_TEST_BULK];
+
+    for (unsigned i = 0; i < QUEUE_TEST_BULK; i++)
+    {
+        Data item = {11.0f, 22, {0}};
+
+        items[i] = item;
+    }
+
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    while (max)
+    {
+        size_t count   = (max < QUEUE_TEST_BULK) ? max : QUEUE_TEST_BULK;
+        size_t written = 0;
+
+        if
+        (
+               try_enqueue_bulk(info->tag, info->q, items, count, &written)
+            != Queue_Result_Ok
+        )
+        {
+            thrd_yield();
+        }
+
+        max -= (unsigned) written;
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+int thread_out_bulk(void* data)
+{
+    Data items[QUEUE_TEST_BULK];
+
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    while (max)
+    {
+        size_t count = (max < QUEUE_TEST_BULK) ? max : QUEUE_TEST_BULK;
+        size_t read  = 0;
+
+        if
+        (
+               try_dequeue_bulk(info->tag, info->q, items, count, &read)
+            != Queue_Result_Ok
+        )
+        {
+            thrd_yield();
+        }
+
+        for (size_t i = 0; i < read; i++)
+        {
+            atomic_fetch_add_explicit
+            (
+                  info->global_count
+                , items[i].b
+                , memory_order_relaxed
+            );
+        }
+
+        max -= (unsigned) read;
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+int thread_in_wait(void* data)
+{
+    Data item =
+    {
+          11.0f
+        , 22
+        , {0}
+    };
+
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        if (enqueue_wait(info->tag, info->q, &item) != Queue_Result_Ok)
+        {
+            return 1;
+        }
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+int thread_out_wait(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        Data item = {0};
+
+        if (dequeue_wait(info->tag, info->q, &item) != Queue_Result_Ok)
+        {
+            return 1;
+        }
+
+        atomic_fetch_add_explicit
+        (
+              info->global_count
+            , item.b
+            , memory_order_relaxed
+        );
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+// Spsc only: the sequence rides in a, so the consumer can check the order.
+// Both sides yield on a full or empty ring, which with a tiny ring is most of
+// the time.
+int thread_in_order(void* data)
+{
+    Data item =
+    {
+          0.0f
+        , 22
+        , {0}
+    };
+
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        item.a = (float) j;
+
+        while (try_enqueue(info->tag, info->q, &item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+int thread_out_order(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+
+    unsigned max = 10000 * info->multiplier;
+
+    for (unsigned j = 0; j < max; j++)
+    {
+        Data item = {0};
+
+        while (try_dequeue(info->tag, info->q, &item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        // Out of order items don't count, so the sum comes up short.
+        if (item.a == (float) j)
+        {
+            atomic_fetch_add_explicit
+            (
+                  info->global_count
+                , item.b
+                , memory_order_relaxed
+            );
+        }
+    }
+
+    atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+const char* run_threads
+(
+      Tag            tag
+    , unsigned       count_in
+    , unsigned       count_out
+    , thrd_start_t   function_in
+    , thrd_start_t   function_out
+    , size_t         cell_count
+)
+{
+    void* q = NULL;
+    {
+        size_t bytes = 0;
+
+        make(tag, cell_count, NULL, &bytes);
+
+        EXPECT(bytes > 0);
+
+        q = malloc(bytes);
+
+        Queue_Result create = make(tag, cell_count, q, &bytes);
+
+        EXPECT(create == Queue_Result_Ok);
+    }
+
+    thrd_t in_threads [QUEUE_TEST_THREADS_MAX];
+    thrd_t out_threads[QUEUE_TEST_THREADS_MAX];
+
+    atomic_size_t  done_in_count  = ATOMIC_VAR_INIT(count_in);
+    atomic_size_t  done_out_count = ATOMIC_VAR_INIT(count_out);
+    atomic_size_t  global_count   = ATOMIC_VAR_INIT(0);
+
+    int multiplier_in  = QUEUE_TEST_THREADS_MAX / count_in;
+    int multiplier_out = QUEUE_TEST_THREADS_MAX / count_out;
+
+    Thread_Data data_in =
+    {
+          q
+        , multiplier_in
+        , tag
+        , &global_count
+        , &done_in_count
+    };
+    Thread_Data data_out =
+    {
+          q
+        , multiplier_out
+        , tag
+        , &global_count
+        , &done_out_count
+    };
+
+    for (unsigned i = 0; i < count_in; i++)
+    {
+        int result = thrd_create(&in_threads[i], function_in, &data_in);
+        EXPECT(result == thrd_success);
+    }
+
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        int result = thrd_create(&out_threads[i], function_out, &data_out);
+        EXPECT(result == thrd_success);
+    }
+
+    // Yield, or on a single core this spins away the workers' time slices.
+    while (atomic_load_explicit(&done_in_count, memory_order_relaxed))
+    {
+        thrd_yield();
+    }
+
+    while (atomic_load_explicit(&done_out_count, memory_order_relaxed))
+    {
+        thrd_yield();
+    }
+
+    for (unsigned i = 0; i < count_in; i++)
+    {
+        int ignored = 0;
+        int result  = thrd_join(in_threads[i], &ignored);
+
+        EXPECT(result == thrd_success);
+    }
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        int ignored = 0;
+        int result  = thrd_join(out_threads[i], &ignored);
+
+        EXPECT(result == thrd_success);
+    }
+
+    size_t expected_count = 10000ULL * 22 * QUEUE_TEST_THREADS_MAX;
+
+    EXPECT(atomic_load(&global_count) == expected_count);
+
+    free(q);
+
+    return NULL;
+}
+
+#endif
+
+const char* sums10000(Tag tag, unsigned count_in, unsigned count_out)
+{
+#if QUEUE_TEST_THREADS
+    return run_threads
+    (
+          tag
+        , count_in
+        , count_out
+        , thread_in
+        , thread_out
+        , 1 << 8
+    );
+#else
+    (void) count_in;
+    (void) count_out;
+    (void) tag;
+
+    return NULL;
+#endif
+}
+
+const char* bulk_sums10000(Tag tag, unsigned count_in, unsigned count_out)
+{
+#if QUEUE_TEST_THREADS
+    return run_threads
+    (
+          tag
+        , count_in
+        , count_out
+        , thread_in_bulk
+        , thread_out_bulk
+        , 1 << 8
+    );
+#else
+    (void) count_in;
+    (void) count_out;
+    (void) tag;
+
+    return NULL;
+#endif
+}
+
+const char* wait_sums10000(Tag tag, unsigned count_in, unsigned count_out)
+{
+#if QUEUE_TEST_THREADS
+    return run_threads
+    (
+          tag
+        , count_in
+        , count_out
+        , thread_in_wait
+        , thread_out_wait
+        , 1 << 8
+    );
+#else
+    (void) count_in;
+    (void) count_out;
+    (void) tag;
+
+    return NULL;
+#endif
+}
+
+// The smallest ring, so the spsc fast path keeps running into full and empty
+// and has to refresh its cached indices while the other side is moving.
+const char* small_sums10000(Tag tag, unsigned count_in, unsigned count_out)
+{
+#if QUEUE_TEST_THREADS
+    if (tag == Spsc)
+    {
+        return run_threads
+        (
+              tag
+            , count_in
+            , count_out
+            , thread_in_order
+            , thread_out_order
+            , 2
+        );
+    }
+#endif
+    (void) count_in;
+    (void) count_out;
+    (void) tag;
+
+    return NULL;
+}
+
+#if QUEUE_TEST_THREADS
+int thread_out_close(void* data)
+{
+    Thread_Data* info = CAST(Thread_Data*, data);
+    Data         item = {0};
+    Queue_Result result;
+
+    while ((result = dequeue_wait(info->tag, info->q, &item)) == Queue_Result_Ok)
+    {
+        atomic_fetch_add_explicit
+        (
+              info->global_count
+            , item.b
+            , memory_order_relaxed
+        );
+    }
+
+    if (result == Queue_Result_Closed)
+    {
+        atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+    }
+
+    return 0;
+}
+#endif
+
+// Consumers only stop once the queue is closed and drained, parked ones
+// included.
+const char* close_wakes(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
+
+    void* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    size_t bytes = 0;
+
+    make(tag, 1 << 6, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 6, q, &bytes);
+
+    thrd_t        out_threads[QUEUE_TEST_THREADS_MAX];
+    atomic_size_t done_out_count = ATOMIC_VAR_INIT(count_out);
+    atomic_size_t global_count   = ATOMIC_VAR_INIT(0);
+
+    Thread_Data data_out =
+    {
+          q
+        , 1
+        , tag
+        , &global_count
+        , &done_out_count
+    };
+
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        int result = thrd_create(&out_threads[i], thread_out_close, &data_out);
+        EXPECT(result == thrd_success);
+    }
+
+    Data item =
+    {
+          11.0f
+        , 22
+        , {0}
+    };
+
+    for (unsigned j = 0; j < 10000; j++)
+    {
+        EXPECT(enqueue_wait(tag, q, &item) == Queue_Result_Ok);
+    }
+
+    close_queue(tag, q);
+
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        int ignored = 0;
+        int result  = thrd_join(out_threads[i], &ignored);
+
+        EXPECT(result == thrd_success);
+    }
 
-        EXPECT(bytes > 0);
+    EXPECT(!atomic_load(&done_out_count));
+    EXPECT(atomic_load(&global_count) == 10000ULL * 22);
 
-        q = malloc(bytes);
+    free(q);
+#else
+    (void) tag;
+    (void) count_out;
+    (void) q;
+#endif
 
-        Queue_Result create = make(tag, 1 << 8, q, &bytes);
+    return NULL;
+}
 
-        EXPECT(create == Queue_Result_Ok);
+#if QUEUE_TEST_THREADS
+// Polls rather than waits, so consumers race each other for the last items.
+// Gives up, without counting itself done, if a closed queue keeps saying
+// Empty.
+int thread_out_drain(void* data)
+{
+    Thread_Data* info  = CAST(Thread_Data*, data);
+    Data         item  = {0};
+    unsigned     tries = 0;
+
+    for (;;)
+    {
+        Queue_Result result = try_dequeue(info->tag, info->q, &item);
+
+        if (result == Queue_Result_Ok)
+        {
+            atomic_fetch_add_explicit
+            (
+                  info->global_count
+                , item.b
+                , memory_order_relaxed
+            );
+
+            continue;
+        }
+
+        if (result == Queue_Result_Closed)
+        {
+            atomic_fetch_sub_explicit(info->done, 1, memory_order_relaxed);
+            return 0;
+        }
+
+        if (is_closed(info->tag, info->q) && (++tries > 1000000))
+        {
+            return 0;
+        }
+
+        thrd_yield();
     }
+}
+#endif
 
-    thrd_t in_threads [QUEUE_TEST_THREADS_MAX];
-    thrd_t out_threads[QUEUE_TEST_THREADS_MAX];
+// Every consumer sees Closed once a closed queue is drained, even when
+// several of them went for the same last item.
+const char* close_drains(Tag tag, unsigned count_in, unsigned count_out)
+{
+    (void) count_in;
 
-    atomic_size_t  done_in_count  = ATOMIC_VAR_INIT(count_in);
-    atomic_size_t  done_out_count = ATOMIC_VAR_INIT(count_out);
-    atomic_size_t  global_count   = ATOMIC_VAR_INIT(0);
+    void* q = NULL;
 
-    int multiplier_in  = QUEUE_TEST_THREADS_MAX / count_in;
-    int multiplier_out = QUEUE_TEST_THREADS_MAX / count_out;
+#if QUEUE_TEST_THREADS
+    size_t bytes = 0;
+
+    make(tag, 1 << 6, NULL, &bytes);
+
+    EXPECT(bytes > 0);
+
+    q = malloc(bytes);
+
+    make(tag, 1 << 6, q, &bytes);
+
+    thrd_t        out_threads[QUEUE_TEST_THREADS_MAX];
+    atomic_size_t done_out_count = ATOMIC_VAR_INIT(count_out);
+    atomic_size_t global_count   = ATOMIC_VAR_INIT(0);
 
-    Thread_Data data_in =
-    {
-          q
-        , multiplier_in
-        , tag
-        , &global_count
-        , &done_in_count
-    };
     Thread_Data data_out =
     {
           q
-        , multiplier_out
+        , 1
         , tag
         , &global_count
         , &done_out_count
     };
 
-    for (unsigned i = 0; i < count_in; i++)
-    {
-        int result = thrd_create(&in_threads[i], thread_in, &data_in);
-        EXPECT(result == thrd_success);
-    }
-
     for (unsigned i = 0; i < count_out; i++)
     {
-        int result = thrd_create(&out_threads[i], thread_out, &data_out);
+        int result = thrd_create(&out_threads[i], thread_out_drain, &data_out);
         EXPECT(result == thrd_success);
     }
 
-    while(atomic_load_explicit(&done_in_count,  memory_order_relaxed));
-    while(atomic_load_explicit(&done_out_count, memory_order_relaxed));
+    Data item =
+    {
+          11.0f
+        , 22
+        , {0}
+    };
 
-    for (unsigned i = 0; i < count_in; i++)
+    // One at a time, so the queue is nearly always empty.
+    for (unsigned j = 0; j < 10000; j++)
     {
-        int ignored = 0;
-        int result  = thrd_join(in_threads[i], &ignored);
+        EXPECT(enqueue(tag, q, &item) == Queue_Result_Ok);
 
-        EXPECT(result == thrd_success);
+        thrd_yield();
     }
+
+    close_queue(tag, q);
+
     for (unsigned i = 0; i < count_out; i++)
     {
         int ignored = 0;
@@ -541,18 +2311,336 @@ const char* sums10000(Tag tag, unsigned count_in, unsigned count_out)
         EXPECT(result == thrd_success);
     }
 
-    size_t expected_count = 10000ULL * 22 * QUEUE_TEST_THREADS_MAX;
+    EXPECT(!atomic_load(&done_out_count));
+    EXPECT(atomic_load(&global_count) == 10000ULL * 22);
 
-    EXPECT(atomic_load(&global_count) == expected_count);
+    free(q);
 #else
+    (void) tag;
+    (void) count_out;
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#define QUEUE_TEST_LOSSY_ITEMS 100000
+
+void* lossy_make(Tag tag, size_t cell_count)
+{
+    size_t bytes = 0;
+    void*  q     = NULL;
+
+    switch (tag)
+    {
+        case Spsc:
+        {
+            spsc_make_queue_Lossy_Data(cell_count, NULL, &bytes);
+            q = malloc(bytes);
+            spsc_make_queue_Lossy_Data(cell_count, CAST(Queue_Spsc_Lossy_Data*, q), &bytes);
+            break;
+        }
+        case Spmc:
+        {
+            spmc_make_queue_Lossy_Data(cell_count, NULL, &bytes);
+            q = malloc(bytes);
+            spmc_make_queue_Lossy_Data(cell_count, CAST(Queue_Spmc_Lossy_Data*, q), &bytes);
+            break;
+        }
+        default: break;
+    }
+
+    return q;
+}
+
+Queue_Result lossy_try_enqueue(Tag tag, void* q, Data const* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), d);
+        case Spmc: return spmc_try_enqueue_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), d);
+        default:   return Queue_Result_Error;
+    }
+}
+
+Queue_Result lossy_try_dequeue(Tag tag, void* q, Data* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), d);
+        case Spmc: return spmc_dequeue_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), d);
+        default:   return Queue_Result_Error;
+    }
+}
+
+Queue_Result lossy_try_enqueue_reserve(Tag tag, void* q, Data** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_reserve_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), d);
+        case Spmc: return spmc_try_enqueue_reserve_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), d);
+        default:   return Queue_Result_Error;
+    }
+}
+
+void lossy_enqueue_commit(Tag tag, void* q, Data* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_enqueue_commit_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), d); break;
+        case Spmc: spmc_enqueue_commit_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), d); break;
+        default:   break;
+    }
+}
+
+size_t lossy_take_dropped(Tag tag, void* q)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_take_dropped_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q));
+        case Spmc: return spmc_take_dropped_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q));
+        default:   return 0;
+    }
+}
+
+void lossy_get_stats(Tag tag, void* q, Queue_Stats* stats)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_get_stats_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), stats); break;
+        case Spmc: spmc_get_stats_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), stats); break;
+        default:   break;
+    }
+}
+
+// Every byte carries the item number, so a torn copy shows up.
+void lossy_fill(Data* item, uint32_t value)
+{
+    item->a = (float) value;
+    item->b = value;
+
+    memset(item->bytes, (uint8_t) value, sizeof(item->bytes));
+}
+
+int lossy_intact(Data const* item)
+{
+    if (item->a != (float) item->b)
+    {
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(item->bytes); i++)
+    {
+        if (item->bytes[i] != (uint8_t) item->b)
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+#if QUEUE_TEST_THREADS
+
+typedef struct Lossy_Thread_Data
+{
+    void*          q;
+    Tag            tag;
+    atomic_size_t* producing;
+    size_t         received;
+    size_t         bad;
+}
+Lossy_Thread_Data;
+
+// Each consumer's items must be intact and in order, with gaps where the
+// producer lapped it or another consumer took them.
+int thread_out_lossy(void* data)
+{
+    Lossy_Thread_Data* info = CAST(Lossy_Thread_Data*, data);
+
+    int64_t last = -1;
+
+    for (;;)
+    {
+        size_t producing =
+            atomic_load_explicit(info->producing, memory_order_acquire);
+
+        Data item;
+
+        if (lossy_try_dequeue(info->tag, info->q, &item) == Queue_Result_Ok)
+        {
+            info->bad += !lossy_intact(&item) || ((int64_t) item.b <= last);
+            info->received++;
+
+            last = item.b;
+            continue;
+        }
+
+        if (!producing)
+        {
+            return 0;
+        }
+
+        thrd_yield();
+    }
+}
+
+#endif
+
+const char* overwrite(Tag tag, unsigned count_in, unsigned count_out)
+{
     (void) count_in;
+
+    if ((tag != Spsc) && (tag != Spmc))
+    {
+        (void) count_out;
+        return NULL;
+    }
+
+    void* q = lossy_make(tag, 16);
+
+    EXPECT(q);
+
+    Data item = {0};
+
+    EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Empty);
+
+    // Lap the consumer twice and a half, only the newest 16 are left.
+    for (uint32_t i = 0; i < 40; i++)
+    {
+        lossy_fill(&item, i);
+
+        EXPECT(lossy_try_enqueue(tag, q, &item) == Queue_Result_Ok);
+    }
+
+    for (uint32_t i = 24; i < 40; i++)
+    {
+        EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Ok);
+        EXPECT(item.b == i);
+        EXPECT(lossy_intact(&item));
+    }
+
+    EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Empty);
+    EXPECT(lossy_take_dropped(tag, q) == 24);
+    EXPECT(lossy_take_dropped(tag, q) == 0);
+
+    // Part way through reading, 40 to 49 then 50 to 69 with 40 to 42 read.
+    for (uint32_t i = 40; i < 70; i++)
+    {
+        lossy_fill(&item, i);
+
+        EXPECT(lossy_try_enqueue(tag, q, &item) == Queue_Result_Ok);
+
+        if (i < 43)
+        {
+            EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Ok);
+            EXPECT(item.b == i);
+        }
+    }
+
+    for (uint32_t i = 54; i < 70; i++)
+    {
+        EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Ok);
+        EXPECT(item.b == i);
+    }
+
+    EXPECT(lossy_take_dropped(tag, q) == 11);
+
+    Queue_Stats stats;
+
+    lossy_get_stats(tag, q, &stats);
+
+    EXPECT(stats.enqueue_ok   == 70);
+    EXPECT(stats.enqueue_full == 0);
+    EXPECT(stats.dequeue_ok   == 35);
+
+    // A consumer lapped by a producer that is still writing the oldest cell
+    // doesn't wait for it to finish.
+    Data* slot = NULL;
+
+    for (uint32_t i = 70; i < 86; i++)
+    {
+        lossy_fill(&item, i);
+
+        EXPECT(lossy_try_enqueue(tag, q, &item) == Queue_Result_Ok);
+    }
+
+    EXPECT(lossy_try_enqueue_reserve(tag, q, &slot) == Queue_Result_Ok);
+
+    lossy_fill(slot, 86);
+
+    Queue_Result result = (tag == Spsc)
+        ? spsc_try_dequeue_Lossy_Data(CAST(Queue_Spsc_Lossy_Data*, q), &item)
+        : spmc_try_dequeue_Lossy_Data(CAST(Queue_Spmc_Lossy_Data*, q), &item);
+
+    EXPECT(result == Queue_Result_Contention);
+
+    lossy_enqueue_commit(tag, q, slot);
+
+    for (uint32_t i = 71; i < 87; i++)
+    {
+        EXPECT(lossy_try_dequeue(tag, q, &item) == Queue_Result_Ok);
+        EXPECT(item.b == i);
+    }
+
+    EXPECT(lossy_take_dropped(tag, q) == 1);
+
+    free(q);
+
+#if QUEUE_TEST_THREADS
+    // Everything the producer enqueued is either received once or dropped.
+    q = lossy_make(tag, 64);
+
+    EXPECT(q);
+
+    atomic_size_t     producing = ATOMIC_VAR_INIT(1);
+    Lossy_Thread_Data info[QUEUE_TEST_THREADS_MAX];
+    thrd_t            threads[QUEUE_TEST_THREADS_MAX];
+
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        Lossy_Thread_Data init = {q, tag, &producing, 0, 0};
+
+        info[i] = init;
+
+        EXPECT(thrd_create(&threads[i], thread_out_lossy, &info[i]) == thrd_success);
+    }
+
+    for (uint32_t i = 0; i < QUEUE_TEST_LOSSY_ITEMS; i++)
+    {
+        lossy_fill(&item, i);
+
+        EXPECT(lossy_try_enqueue(tag, q, &item) == Queue_Result_Ok);
+    }
+
+    atomic_store_explicit(&producing, 0, memory_order_release);
+
+    size_t received = 0;
+    size_t bad      = 0;
+
+    for (unsigned i = 0; i < count_out; i++)
+    {
+        thrd_join(threads[i], NULL);
+
+        received += info[i].received;
+        bad      += info[i].bad;
+    }
+
+    EXPECT(!bad);
+    EXPECT(received + lossy_take_dropped(tag, q) == QUEUE_TEST_LOSSY_ITEMS);
+
+    free(q);
+#else
     (void) count_out;
-    (void) tag;
 #endif
 
     return NULL;
 }
 
+// -----------------------------------------------------------------------------
+
 typedef const char* (*Test)(Tag, unsigned, unsigned);
 #define TEST(x) { #x, x }
 
@@ -567,13 +2655,30 @@ static tests[] =
     , TEST(create)
     , TEST(empty)
     , TEST(full)
+    , TEST(bulk)
+    , TEST(reserve)
+    , TEST(parked)
+    , TEST(wait_timeout)
+    , TEST(closed)
+    , TEST(wraparound)
+    , TEST(spread)
+    , TEST(fixed)
+    , TEST(notify)
+    , TEST(shm)
+    , TEST(alloc)
+    , TEST(overwrite)
     , TEST(sums10000)
+    , TEST(bulk_sums10000)
+    , TEST(wait_sums10000)
+    , TEST(small_sums10000)
+    , TEST(close_wakes)
+    , TEST(close_drains)
 };
 
 #if QUEUE_TEST_THREADS
-    #define TEST_COUNT 5
+    #define TEST_COUNT 22
 #else
-    #define TEST_COUNT 4
+    #define TEST_COUNT 16
 #endif
 
 int main(int arg_count, char** args)
@@ -614,6 +2719,7 @@ int main(int arg_count, char** args)
         , {QUEUE_TEST_THREADS_MAX,                      1}
         , {                     1, QUEUE_TEST_THREADS_MAX}
         , {QUEUE_TEST_THREADS_MAX, QUEUE_TEST_THREADS_MAX}
+        , {QUEUE_TEST_THREADS_MAX, QUEUE_TEST_THREADS_MAX}
     };
 
     for (unsigned tag = 0; tag < (Max + 1); tag++)
@@ -0,0 +1,643 @@
+// -----------------------------------------------------------------------------
+// Tests for the runtime item size queues, amblaq/queues_any.h, and the typed
+// wrappers amblaq/queues.h makes over them with QUEUE_ERASED.
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_MP 0
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues_any.h>
+
+#define QUEUE_MP 1
+#define QUEUE_MC 0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues_any.h>
+
+#define QUEUE_MP 0
+#define QUEUE_MC 1
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues_any.h>
+
+#define QUEUE_MP 1
+#define QUEUE_MC 1
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues_any.h>
+
+typedef struct Point
+{
+    double x;
+    double y;
+    double z;
+}
+Point;
+
+typedef struct Rgb
+{
+    uint8_t r;
+    uint8_t g;
+    uint8_t b;
+}
+Rgb;
+
+#define QUEUE_TYPE Point
+#define QUEUE_MP   1
+#define QUEUE_MC   1
+#define QUEUE_ERASED
+#include <amblaq/queues.h>
+
+#define QUEUE_TYPE Rgb
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_ERASED
+#include <amblaq/queues.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_THREADS_MAX 2
+#define QUEUE_TEST_ITEMS       100000
+
+// -----------------------------------------------------------------------------
+
+typedef enum Tag
+{
+      Spsc
+    , Mpsc
+    , Spmc
+    , Mpmc
+
+    , Max = Mpmc
+}
+Tag;
+
+static const char* tag_to_name[] =
+{
+      "Spsc"
+    , "Mpsc"
+    , "Spmc"
+    , "Mpmc"
+};
+
+Queue_Result make
+(
+      Tag     tag
+    , size_t  item_bytes
+    , size_t  item_align
+    , size_t  cell_count
+    , void*   q
+    , size_t* bytes
+)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_make_queue_Any(item_bytes, item_align, cell_count, CAST(Queue_Spsc_Any*, q), bytes);
+        case Mpsc: return mpsc_make_queue_Any(item_bytes, item_align, cell_count, CAST(Queue_Mpsc_Any*, q), bytes);
+        case Spmc: return spmc_make_queue_Any(item_bytes, item_align, cell_count, CAST(Queue_Spmc_Any*, q), bytes);
+        case Mpmc: return mpmc_make_queue_Any(item_bytes, item_align, cell_count, CAST(Queue_Mpmc_Any*, q), bytes);
+    }
+
+    return Queue_Result_Error;
+}
+
+void* make_malloc(Tag tag, size_t item_bytes, size_t item_align, size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if (make(tag, item_bytes, item_align, cell_count, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    void* q = malloc(bytes);
+
+    make(tag, item_bytes, item_align, cell_count, q, &bytes);
+
+    return q;
+}
+
+Queue_Result try_enqueue(Tag tag, void* q, void const* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_Any(CAST(Queue_Spsc_Any*, q), d);
+        case Mpsc: return mpsc_try_enqueue_Any(CAST(Queue_Mpsc_Any*, q), d);
+        case Spmc: return spmc_try_enqueue_Any(CAST(Queue_Spmc_Any*, q), d);
+        case Mpmc: return mpmc_try_enqueue_Any(CAST(Queue_Mpmc_Any*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_dequeue(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_Any(CAST(Queue_Spsc_Any*, q), d);
+        case Mpsc: return mpsc_try_dequeue_Any(CAST(Queue_Mpsc_Any*, q), d);
+        case Spmc: return spmc_try_dequeue_Any(CAST(Queue_Spmc_Any*, q), d);
+        case Mpmc: return mpmc_try_dequeue_Any(CAST(Queue_Mpmc_Any*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_enqueue_bulk(Tag tag, void* q, void const* d, size_t count, size_t* written)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_bulk_Any(CAST(Queue_Spsc_Any*, q), d, count, written);
+        case Mpsc: return mpsc_try_enqueue_bulk_Any(CAST(Queue_Mpsc_Any*, q), d, count, written);
+        case Spmc: return spmc_try_enqueue_bulk_Any(CAST(Queue_Spmc_Any*, q), d, count, written);
+        case Mpmc: return mpmc_try_enqueue_bulk_Any(CAST(Queue_Mpmc_Any*, q), d, count, written);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_dequeue_bulk(Tag tag, void* q, void* d, size_t count, size_t* read)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_bulk_Any(CAST(Queue_Spsc_Any*, q), d, count, read);
+        case Mpsc: return mpsc_try_dequeue_bulk_Any(CAST(Queue_Mpsc_Any*, q), d, count, read);
+        case Spmc: return spmc_try_dequeue_bulk_Any(CAST(Queue_Spmc_Any*, q), d, count, read);
+        case Mpmc: return mpmc_try_dequeue_bulk_Any(CAST(Queue_Mpmc_Any*, q), d, count, read);
+    }
+
+    return Queue_Result_Error;
+}
+
+Queue_Result try_enqueue_reserve(Tag tag, void* q, void** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_enqueue_reserve_Any(CAST(Queue_Spsc_Any*, q), d);
+        case Mpsc: return mpsc_try_enqueue_reserve_Any(CAST(Queue_Mpsc_Any*, q), d);
+        case Spmc: return spmc_try_enqueue_reserve_Any(CAST(Queue_Spmc_Any*, q), d);
+        case Mpmc: return mpmc_try_enqueue_reserve_Any(CAST(Queue_Mpmc_Any*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+void enqueue_commit(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_enqueue_commit_Any(CAST(Queue_Spsc_Any*, q), d); break;
+        case Mpsc: mpsc_enqueue_commit_Any(CAST(Queue_Mpsc_Any*, q), d); break;
+        case Spmc: spmc_enqueue_commit_Any(CAST(Queue_Spmc_Any*, q), d); break;
+        case Mpmc: mpmc_enqueue_commit_Any(CAST(Queue_Mpmc_Any*, q), d); break;
+    }
+}
+
+Queue_Result try_dequeue_peek(Tag tag, void* q, void** d)
+{
+    switch (tag)
+    {
+        case Spsc: return spsc_try_dequeue_peek_Any(CAST(Queue_Spsc_Any*, q), d);
+        case Mpsc: return mpsc_try_dequeue_peek_Any(CAST(Queue_Mpsc_Any*, q), d);
+        case Spmc: return spmc_try_dequeue_peek_Any(CAST(Queue_Spmc_Any*, q), d);
+        case Mpmc: return mpmc_try_dequeue_peek_Any(CAST(Queue_Mpmc_Any*, q), d);
+    }
+
+    return Queue_Result_Error;
+}
+
+void dequeue_release(Tag tag, void* q, void* d)
+{
+    switch (tag)
+    {
+        case Spsc: spsc_dequeue_release_Any(CAST(Queue_Spsc_Any*, q), d); break;
+        case Mpsc: mpsc_dequeue_release_Any(CAST(Queue_Mpsc_Any*, q), d); break;
+        case Spmc: spmc_dequeue_release_Any(CAST(Queue_Spmc_Any*, q), d); break;
+        case Mpmc: mpmc_dequeue_release_Any(CAST(Queue_Mpmc_Any*, q), d); break;
+    }
+}
+
+// Item i is item_bytes bytes of i + offset.
+void fill(uint8_t* item, size_t item_bytes, size_t i)
+{
+    for (size_t b = 0; b < item_bytes; b++)
+    {
+        item[b] = CAST(uint8_t, (i + b));
+    }
+}
+
+int check(uint8_t const* item, size_t item_bytes, size_t i)
+{
+    for (size_t b = 0; b < item_bytes; b++)
+    {
+        if (item[b] != CAST(uint8_t, (i + b)))
+        {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(Tag tag)
+{
+    size_t bytes = 0;
+    void*  q     = NULL;
+
+    EXPECT(make(tag, 8,  8,  16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(make(tag, 0,  1,  16, NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(make(tag, 8,  8,  1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(make(tag, 8,  8,  12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(make(tag, 8,  0,  16, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(make(tag, 12, 12, 16, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(make(tag, 32, 32, 16, NULL, &bytes) == Queue_Result_Error_Too_Big);
+    EXPECT(make(tag, 8,  8,  16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = malloc(bytes);
+
+    bytes--;
+
+    EXPECT
+    (
+           make(tag, 8, 8, 16, q, &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    EXPECT(make(tag, 8, 8, 16, q, &bytes) == Queue_Result_Ok);
+
+    free(q);
+
+    return NULL;
+}
+
+// Odd sizes fill the queue, then come out intact and in order, twice so the
+// second lap goes round the end of the ring.
+const char* sizes(Tag tag)
+{
+    static const size_t item_bytes[] = {1, 3, 8, 13, 24, 100};
+    static const size_t item_align[] = {1, 1, 8, 1,  8,  4};
+
+    void* q = NULL;
+
+    for (size_t s = 0; s < (sizeof(item_bytes) / sizeof(item_bytes[0])); s++)
+    {
+        size_t  length = item_bytes[s];
+        uint8_t item[100];
+
+        q = make_malloc(tag, length, item_align[s], 16);
+
+        EXPECT(q);
+
+        for (size_t lap = 0; lap < 2; lap++)
+        {
+            for (size_t i = 0; i < 16; i++)
+            {
+                fill(item, length, i + lap);
+
+                EXPECT(try_enqueue(tag, q, item) == Queue_Result_Ok);
+            }
+
+            EXPECT(try_enqueue(tag, q, item) == Queue_Result_Full);
+
+            for (size_t i = 0; i < 16; i++)
+            {
+                EXPECT(try_dequeue(tag, q, item) == Queue_Result_Ok);
+                EXPECT(check(item, length, i + lap));
+            }
+
+            EXPECT(try_dequeue(tag, q, item) == Queue_Result_Empty);
+        }
+
+        free(q);
+    }
+
+    return NULL;
+}
+
+const char* bulk(Tag tag)
+{
+    void*   q = make_malloc(tag, 24, 8, 16);
+    uint8_t items[24 * 20];
+    size_t  count = 0;
+
+    EXPECT(q);
+
+    for (size_t i = 0; i < 20; i++)
+    {
+        fill(&items[i * 24], 24, i);
+    }
+
+    EXPECT(try_enqueue_bulk(tag, q, items, 10, &count) == Queue_Result_Ok);
+    EXPECT(count == 10);
+    EXPECT(try_enqueue_bulk(tag, q, &items[10 * 24], 10, &count) == Queue_Result_Ok);
+    EXPECT(count == 6);
+    EXPECT(try_enqueue_bulk(tag, q, items, 1, &count) == Queue_Result_Full);
+    EXPECT(count == 0);
+
+    memset(items, 0, sizeof(items));
+
+    EXPECT(try_dequeue_bulk(tag, q, items, 20, &count) == Queue_Result_Ok);
+    EXPECT(count == 16);
+    EXPECT(try_dequeue_bulk(tag, q, items, 20, &count) == Queue_Result_Empty);
+    EXPECT(count == 0);
+
+    for (size_t i = 0; i < 16; i++)
+    {
+        EXPECT(check(&items[i * 24], 24, i));
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+const char* in_place(Tag tag)
+{
+    void* q = make_malloc(tag, 16, 16, 4);
+
+    EXPECT(q);
+
+    for (size_t lap = 0; lap < 3; lap++)
+    {
+        void* cell = NULL;
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Ok);
+            EXPECT(!(CAST(uintptr_t, cell) & 15));
+
+            fill(CAST(uint8_t*, cell), 16, i + lap);
+
+            enqueue_commit(tag, q, cell);
+        }
+
+        EXPECT(try_enqueue_reserve(tag, q, &cell) == Queue_Result_Full);
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Ok);
+            EXPECT(check(CAST(uint8_t*, cell), 16, i + lap));
+
+            dequeue_release(tag, q, cell);
+        }
+
+        EXPECT(try_dequeue_peek(tag, q, &cell) == Queue_Result_Empty);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// The typed names work as they do without QUEUE_ERASED.
+const char* erased(Tag tag)
+{
+    void* q = NULL;
+
+    if (tag != Mpmc)
+    {
+        return NULL;
+    }
+
+    size_t bytes = 0;
+
+    EXPECT(mpmc_make_queue_Point(8, NULL, &bytes) == Queue_Result_Ok);
+
+    Queue_Mpmc_Point* points = CAST(Queue_Mpmc_Point*, malloc(bytes));
+
+    q = points;
+
+    EXPECT(mpmc_make_queue_Point(8, points, &bytes) == Queue_Result_Ok);
+
+    Point point = {1.0, 2.0, 3.0};
+
+    EXPECT(mpmc_try_enqueue_Point(points, &point) == Queue_Result_Ok);
+
+    Point* cell = NULL;
+
+    EXPECT(mpmc_try_enqueue_reserve_Point(points, &cell) == Queue_Result_Ok);
+    EXPECT(!(CAST(uintptr_t, cell) & (QUEUE_ALIGNOF(Point) - 1)));
+
+    cell->x = 4.0;
+    cell->y = 5.0;
+    cell->z = 6.0;
+
+    mpmc_enqueue_commit_Point(points, cell);
+
+    EXPECT(mpmc_try_dequeue_Point(points, &point) == Queue_Result_Ok);
+    EXPECT((point.x == 1.0) && (point.y == 2.0) && (point.z == 3.0));
+    EXPECT(mpmc_try_dequeue_peek_Point(points, &cell) == Queue_Result_Ok);
+    EXPECT((cell->x == 4.0) && (cell->y == 5.0) && (cell->z == 6.0));
+
+    mpmc_dequeue_release_Point(points, cell);
+
+    EXPECT(mpmc_try_dequeue_Point(points, &point) == Queue_Result_Empty);
+
+    free(q);
+
+    q = NULL;
+
+    EXPECT(spsc_make_queue_Rgb(4, NULL, &bytes) == Queue_Result_Ok);
+
+    Queue_Spsc_Rgb* colours = CAST(Queue_Spsc_Rgb*, malloc(bytes));
+
+    q = colours;
+
+    EXPECT(spsc_make_queue_Rgb(4, colours, &bytes) == Queue_Result_Ok);
+
+    // 3 byte items are packed 3 bytes apart.
+    EXPECT(spsc_item_bytes_Any(CAST(Queue_Spsc_Any*, colours)) == 3);
+
+    Rgb    in[5]  = {{1, 2, 3}, {4, 5, 6}, {7, 8, 9}, {10, 11, 12}, {0, 0, 0}};
+    Rgb    out[5] = {{0, 0, 0}};
+    size_t count  = 0;
+
+    EXPECT(spsc_try_enqueue_bulk_Rgb(colours, in, 5, &count) == Queue_Result_Ok);
+    EXPECT(count == 4);
+    EXPECT(spsc_try_dequeue_bulk_Rgb(colours, out, 5, &count) == Queue_Result_Ok);
+    EXPECT(count == 4);
+    EXPECT(!memcmp(in, out, 4 * sizeof(Rgb)));
+
+    free(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Thread_Data
+{
+    Tag   tag;
+    void* q;
+    int   first;
+}
+Thread_Data;
+
+int thread_in(void* data)
+{
+    Thread_Data* thread = CAST(Thread_Data*, data);
+    uint8_t      item[24];
+
+    for (size_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        fill(item, 24, i);
+
+        while (try_enqueue(thread->tag, thread->q, item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+
+// Counts items that aren't all from the same fill.
+int thread_out(void* data)
+{
+    Thread_Data* thread = CAST(Thread_Data*, data);
+    uint8_t      item[24];
+    int          bad = 0;
+
+    for (size_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        while (try_dequeue(thread->tag, thread->q, item) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        bad += !check(item, 24, item[0]);
+    }
+
+    return bad;
+}
+#endif
+
+const char* threads(Tag tag)
+{
+    void* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(tag, 24, 8, 64);
+
+    EXPECT(q);
+
+    unsigned producers = ((tag == Mpsc) || (tag == Mpmc)) ? QUEUE_TEST_THREADS_MAX : 1;
+    unsigned consumers = ((tag == Spmc) || (tag == Mpmc)) ? QUEUE_TEST_THREADS_MAX : 1;
+
+    // Every consumer reads as many as a producer writes.
+    if (producers != consumers)
+    {
+        producers = consumers = 1;
+    }
+
+    thrd_t      threads_in[QUEUE_TEST_THREADS_MAX];
+    thrd_t      threads_out[QUEUE_TEST_THREADS_MAX];
+    Thread_Data data = {tag, q, 0};
+    int         bad  = 0;
+
+    for (unsigned i = 0; i < producers; i++)
+    {
+        thrd_create(&threads_in[i], thread_in, &data);
+    }
+
+    for (unsigned i = 0; i < consumers; i++)
+    {
+        thrd_create(&threads_out[i], thread_out, &data);
+    }
+
+    for (unsigned i = 0; i < producers; i++)
+    {
+        thrd_join(threads_in[i], NULL);
+    }
+
+    for (unsigned i = 0; i < consumers; i++)
+    {
+        int result = 0;
+
+        thrd_join(threads_out[i], &result);
+
+        bad += result;
+    }
+
+    uint8_t item[24];
+
+    EXPECT(!bad);
+    EXPECT(try_dequeue(tag, q, item) == Queue_Result_Empty);
+
+    free(q);
+#else
+    (void) q;
+    (void) tag;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(Tag);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(sizes)
+    , TEST(bulk)
+    , TEST(in_place)
+    , TEST(erased)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned i = 0; i <= Max; i++)
+    {
+        for (unsigned j = 0; j < TEST_COUNT; j++)
+        {
+            const char* error = tests[j].test(CAST(Tag, i));
+
+            printf
+            (
+                  "Test: %s: %-20s: %s%s\n"
+                , tag_to_name[i]
+                , tests[j].name
+                , (error ? "FAIL: " : "PASS")
+                , (error ? error : "")
+            );
+
+            fflush(stdout);
+
+            if (error)
+            {
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
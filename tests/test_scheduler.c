@@ -0,0 +1,412 @@
+// -----------------------------------------------------------------------------
+// Tests for the work stealing deque and scheduler, amblaq/deque.h and
+// amblaq/scheduler.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/scheduler.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_THIEVES 3
+#define QUEUE_TEST_ITEMS   200000
+#define QUEUE_TEST_WORKERS 4
+#define QUEUE_TEST_DEPTH   14
+
+// -----------------------------------------------------------------------------
+
+Queue_Deque* make_malloc(size_t cell_count)
+{
+    size_t bytes = 0;
+
+    if (queue_deque_make(cell_count, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    Queue_Deque* q = CAST(Queue_Deque*, malloc(bytes));
+
+    queue_deque_make(cell_count, q, &bytes);
+
+    return q;
+}
+
+static uint32_t items[QUEUE_TEST_ITEMS];
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { free(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t       bytes = 0;
+    Queue_Deque* q     = NULL;
+
+    EXPECT(queue_deque_make(16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(queue_deque_make(1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(queue_deque_make(12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(queue_deque_make(16, NULL, &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue_Deque*, malloc(bytes));
+
+    bytes--;
+
+    EXPECT(queue_deque_make(16, q, &bytes) == Queue_Result_Error_Bytes_Smaller_Than_Needed);
+
+    bytes++;
+
+    EXPECT(queue_deque_make(16, q, &bytes) == Queue_Result_Ok);
+
+    free(q);
+
+    q = NULL;
+
+    EXPECT(queue_scheduler_make(0, 16, 16, NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(queue_scheduler_make(4, 12, 16, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(queue_scheduler_make(4, 16, 12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(queue_scheduler_make(4, 16, 16, NULL, &bytes) == Queue_Result_Ok);
+
+    return NULL;
+}
+
+// Pop is newest first, steal is oldest first.
+const char* ends(void)
+{
+    Queue_Deque* q    = make_malloc(8);
+    void*        data = NULL;
+
+    EXPECT(q);
+
+    EXPECT(queue_deque_pop(q, &data)   == Queue_Result_Empty);
+    EXPECT(queue_deque_steal(q, &data) == Queue_Result_Empty);
+
+    for (size_t lap = 0; lap < 3; lap++)
+    {
+        for (size_t i = 0; i < 8; i++)
+        {
+            EXPECT(queue_deque_push(q, &items[i]) == Queue_Result_Ok);
+        }
+
+        EXPECT(queue_deque_push(q, &items[8]) == Queue_Result_Full);
+
+        for (size_t i = 0; i < 4; i++)
+        {
+            EXPECT(queue_deque_steal(q, &data) == Queue_Result_Ok);
+            EXPECT(data == &items[i]);
+
+            EXPECT(queue_deque_pop(q, &data) == Queue_Result_Ok);
+            EXPECT(data == &items[7 - i]);
+        }
+
+        EXPECT(queue_deque_pop(q, &data)   == Queue_Result_Empty);
+        EXPECT(queue_deque_steal(q, &data) == Queue_Result_Empty);
+    }
+
+    free(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+typedef struct Thief
+{
+    Queue_Deque*        q;
+    QUEUE_ATOMIC_SIZE_T* done;
+    int                 bad;
+}
+Thief;
+
+// Marks each item it gets, a second mark is a duplicate.
+int mark(void* item)
+{
+    uint32_t* at = CAST(uint32_t*, item);
+
+    if ((at < items) || (at >= &items[QUEUE_TEST_ITEMS]))
+    {
+        return 1;
+    }
+
+    return (*at)++ != 0;
+}
+
+int thread_steal(void* data)
+{
+    Thief* thief = CAST(Thief*, data);
+    void*  item  = NULL;
+
+    while (!QUEUE_ATOMIC_LOAD(thief->done, QUEUE_ORDER_ACQUIRE))
+    {
+        if (queue_deque_steal(thief->q, &item) == Queue_Result_Ok)
+        {
+            thief->bad += mark(item);
+        }
+    }
+
+    // Whatever is left after the owner stopped.
+    while (queue_deque_steal(thief->q, &item) != Queue_Result_Empty)
+    {
+        if (item)
+        {
+            thief->bad += mark(item);
+            item = NULL;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+// The owner pushes and pops while thieves steal, every item is taken once.
+const char* steal(void)
+{
+    Queue_Deque* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(64);
+
+    EXPECT(q);
+
+    memset(items, 0, sizeof(items));
+
+    QUEUE_ATOMIC_SIZE_T done;
+    thrd_t              threads[QUEUE_TEST_THIEVES];
+    Thief               thieves[QUEUE_TEST_THIEVES];
+    int                 bad = 0;
+
+    QUEUE_ATOMIC_STORE(&done, 0, QUEUE_ORDER_RELAXED);
+
+    for (unsigned i = 0; i < QUEUE_TEST_THIEVES; i++)
+    {
+        Thief thief = {q, &done, 0};
+
+        thieves[i] = thief;
+
+        thrd_create(&threads[i], thread_steal, &thieves[i]);
+    }
+
+    void* item = NULL;
+
+    for (uint32_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        while (queue_deque_push(q, &items[i]) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        // Keep it short, so the owner and thieves meet at the last item.
+        if (i & 1)
+        {
+            while (queue_deque_pop(q, &item) == Queue_Result_Ok)
+            {
+                bad += mark(item);
+            }
+        }
+    }
+
+    QUEUE_ATOMIC_STORE(&done, 1, QUEUE_ORDER_RELEASE);
+
+    for (unsigned i = 0; i < QUEUE_TEST_THIEVES; i++)
+    {
+        thrd_join(threads[i], NULL);
+
+        bad += thieves[i].bad;
+    }
+
+    EXPECT(!bad);
+
+    for (uint32_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        EXPECT(items[i] == 1);
+    }
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+// A binary tree of tasks, each spawning its two children until the leaves,
+// which count themselves. Only the root comes in through submit.
+typedef struct Node
+{
+    Queue_Task task;
+    size_t     index;
+}
+Node;
+
+static Queue_Scheduler*    scheduler = NULL;
+static Node*               nodes     = NULL;
+static QUEUE_ATOMIC_SIZE_T leaves;
+static QUEUE_ATOMIC_SIZE_T ran[QUEUE_TEST_WORKERS];
+
+#define NODE_COUNT ((CAST(size_t, 1) << (QUEUE_TEST_DEPTH + 1)) - 1)
+#define LEAF_COUNT (CAST(size_t, 1) << QUEUE_TEST_DEPTH)
+
+void run_node(Queue_Task* task, size_t worker)
+{
+    Node*  node  = CAST(Node*, task);
+    size_t left  = (2 * node->index) + 1;
+
+    QUEUE_ATOMIC_FETCH_ADD(&ran[worker], 1, QUEUE_ORDER_RELAXED);
+
+    if (left >= NODE_COUNT)
+    {
+        QUEUE_ATOMIC_FETCH_ADD(&leaves, 1, QUEUE_ORDER_RELEASE);
+        return;
+    }
+
+    for (size_t i = left; i < (left + 2); i++)
+    {
+        nodes[i].task.run = run_node;
+        nodes[i].index    = i;
+
+        while (queue_scheduler_spawn(scheduler, worker, &nodes[i].task) != Queue_Result_Ok)
+        {
+            queue_scheduler_try_run(scheduler, worker);
+        }
+    }
+}
+
+#if QUEUE_TEST_THREADS
+int thread_worker(void* data)
+{
+    size_t worker = CAST(size_t, CAST(uintptr_t, data));
+
+    while (QUEUE_ATOMIC_LOAD(&leaves, QUEUE_ORDER_ACQUIRE) < LEAF_COUNT)
+    {
+        if (queue_scheduler_try_run(scheduler, worker) == Queue_Result_Empty)
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+#endif
+
+const char* tree(void)
+{
+    void* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    size_t bytes = 0;
+
+    EXPECT(queue_scheduler_make(QUEUE_TEST_WORKERS, 256, 64, NULL, &bytes) == Queue_Result_Ok);
+
+    q         = malloc(bytes);
+    scheduler = CAST(Queue_Scheduler*, q);
+    nodes     = CAST(Node*, calloc(NODE_COUNT, sizeof(Node)));
+
+    EXPECT(nodes);
+    EXPECT(queue_scheduler_make(QUEUE_TEST_WORKERS, 256, 64, scheduler, &bytes) == Queue_Result_Ok);
+
+    QUEUE_ATOMIC_STORE(&leaves, 0, QUEUE_ORDER_RELAXED);
+
+    for (unsigned i = 0; i < QUEUE_TEST_WORKERS; i++)
+    {
+        QUEUE_ATOMIC_STORE(&ran[i], 0, QUEUE_ORDER_RELAXED);
+    }
+
+    nodes[0].task.run = run_node;
+    nodes[0].index    = 0;
+
+    EXPECT(queue_scheduler_submit(scheduler, &nodes[0].task) == Queue_Result_Ok);
+
+    thrd_t threads[QUEUE_TEST_WORKERS];
+
+    for (unsigned i = 0; i < QUEUE_TEST_WORKERS; i++)
+    {
+        thrd_create(&threads[i], thread_worker, CAST(void*, CAST(uintptr_t, i)));
+    }
+
+    for (unsigned i = 0; i < QUEUE_TEST_WORKERS; i++)
+    {
+        thrd_join(threads[i], NULL);
+    }
+
+    size_t total = 0;
+
+    for (unsigned i = 0; i < QUEUE_TEST_WORKERS; i++)
+    {
+        total += QUEUE_ATOMIC_LOAD(&ran[i], QUEUE_ORDER_RELAXED);
+    }
+
+    free(nodes);
+
+    EXPECT(QUEUE_ATOMIC_LOAD(&leaves, QUEUE_ORDER_RELAXED) == LEAF_COUNT);
+    EXPECT(total == NODE_COUNT);
+    EXPECT(queue_scheduler_try_run(scheduler, 0) == Queue_Result_Empty);
+
+    free(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(ends)
+    , TEST(steal)
+    , TEST(tree)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Scheduler"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
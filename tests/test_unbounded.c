@@ -0,0 +1,315 @@
+// -----------------------------------------------------------------------------
+// Tests for the unbounded queue, amblaq/unbounded.h
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#if defined(__STDC_NO_THREADS__)
+#pragma message("No C11 threading support, skipping thread test (auto pass)")
+#define QUEUE_TEST_THREADS 0
+#else
+#define QUEUE_TEST_THREADS 1
+#include <threads.h>
+#endif
+
+// Counted, to check segments are reused and given back.
+static size_t allocs = 0;
+static size_t frees  = 0;
+
+// Segments only need the 16 byte alignment malloc gives on 64 bit.
+static void* test_alloc(size_t bytes)
+{
+    allocs++;
+
+    return malloc(bytes);
+}
+
+static void test_free(void* pointer)
+{
+    frees++;
+
+    free(pointer);
+}
+
+#define QUEUE_UNBOUNDED_ALLOC(bytes)  test_alloc(bytes)
+#define QUEUE_UNBOUNDED_FREE(pointer) test_free(pointer)
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_MP   0
+#define QUEUE_MC   0
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/queues.h>
+
+#define QUEUE_TYPE uint64_t
+#define QUEUE_IMPLEMENTATION
+#include <amblaq/unbounded.h>
+
+#define CAST(x, y) ((x) y)
+
+#define QUEUE_TEST_ITEMS 1000000
+
+typedef Queue_Unbounded_uint64_t Queue;
+
+// -----------------------------------------------------------------------------
+
+Queue* make_malloc(size_t segment_cells)
+{
+    size_t bytes = 0;
+
+    if (unbounded_make_queue_uint64_t(segment_cells, NULL, &bytes) != Queue_Result_Ok)
+    {
+        return NULL;
+    }
+
+    Queue* q = CAST(Queue*, malloc(bytes));
+
+    if (unbounded_make_queue_uint64_t(segment_cells, q, &bytes) != Queue_Result_Ok)
+    {
+        free(q);
+
+        return NULL;
+    }
+
+    return q;
+}
+
+void destroy(Queue* q)
+{
+    if (q)
+    {
+        unbounded_destroy_queue_uint64_t(q);
+    }
+
+    free(q);
+}
+
+// -----------------------------------------------------------------------------
+
+#define EXPECT(x) do {if(!(x)) { destroy(q); return #x; }} while(0)
+
+const char* create(void)
+{
+    size_t bytes = 0;
+    Queue* q     = NULL;
+
+    EXPECT(unbounded_make_queue_uint64_t(16, NULL, NULL)   == Queue_Result_Error_Null_Bytes);
+    EXPECT(unbounded_make_queue_uint64_t(1,  NULL, &bytes) == Queue_Result_Error_Too_Small);
+    EXPECT(unbounded_make_queue_uint64_t(12, NULL, &bytes) == Queue_Result_Error_Not_Pow2);
+    EXPECT(unbounded_make_queue_uint64_t(16, NULL, &bytes) == Queue_Result_Ok);
+
+    void* memory = malloc(bytes);
+
+    bytes--;
+
+    EXPECT
+    (
+           unbounded_make_queue_uint64_t(16, CAST(Queue*, memory), &bytes)
+        == Queue_Result_Error_Bytes_Smaller_Than_Needed
+    );
+
+    bytes++;
+
+    allocs = 0;
+
+    EXPECT(unbounded_make_queue_uint64_t(16, CAST(Queue*, memory), &bytes) == Queue_Result_Ok);
+
+    q = CAST(Queue*, memory);
+
+    EXPECT(allocs == 1);
+
+    destroy(q);
+
+    return NULL;
+}
+
+// Past many segments, out in order, and the memory goes with the backlog.
+const char* grow(void)
+{
+    allocs = 0;
+    frees  = 0;
+
+    Queue* q = make_malloc(16);
+
+    EXPECT(q);
+
+    uint64_t data = 0;
+
+    EXPECT(unbounded_try_dequeue_uint64_t(q, &data) == Queue_Result_Empty);
+
+    for (uint64_t i = 0; i < (16 * 10); i++)
+    {
+        EXPECT(unbounded_try_enqueue_uint64_t(q, &i) == Queue_Result_Ok);
+    }
+
+    EXPECT(allocs == 10);
+
+    for (uint64_t i = 0; i < (16 * 10); i++)
+    {
+        EXPECT(unbounded_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+        EXPECT(data == i);
+    }
+
+    EXPECT(unbounded_try_dequeue_uint64_t(q, &data) == Queue_Result_Empty);
+
+    // Nine drained, one kept as the spare.
+    EXPECT(frees == 8);
+
+    unbounded_destroy_queue_uint64_t(q);
+
+    EXPECT(frees == allocs);
+
+    free(q);
+
+    return NULL;
+}
+
+// A backlog going back and forth over the end of a segment uses the spare.
+const char* recycle(void)
+{
+    allocs = 0;
+
+    Queue* q = make_malloc(16);
+
+    EXPECT(q);
+
+    uint64_t in  = 0;
+    uint64_t out = 0;
+
+    for (unsigned round = 0; round < 100; round++)
+    {
+        for (unsigned i = 0; i < 20; i++, in++)
+        {
+            EXPECT(unbounded_try_enqueue_uint64_t(q, &in) == Queue_Result_Ok);
+        }
+
+        for (unsigned i = 0; i < 20; i++, out++)
+        {
+            uint64_t data = 0;
+
+            EXPECT(unbounded_try_dequeue_uint64_t(q, &data) == Queue_Result_Ok);
+            EXPECT(data == out);
+        }
+    }
+
+    EXPECT(allocs <= 3);
+
+    destroy(q);
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+#if QUEUE_TEST_THREADS
+int thread_in(void* data)
+{
+    Queue* q = CAST(Queue*, data);
+
+    for (uint64_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        if (unbounded_try_enqueue_uint64_t(q, &i) != Queue_Result_Ok)
+        {
+            return 1;
+        }
+
+        // Let the backlog grow and shrink a bit.
+        if (!(i % 10000))
+        {
+            thrd_yield();
+        }
+    }
+
+    return 0;
+}
+#endif
+
+const char* threads(void)
+{
+    Queue* q = NULL;
+
+#if QUEUE_TEST_THREADS
+    q = make_malloc(64);
+
+    EXPECT(q);
+
+    thrd_t   thread;
+    uint64_t bad = 0;
+
+    thrd_create(&thread, thread_in, q);
+
+    for (uint64_t i = 0; i < QUEUE_TEST_ITEMS; i++)
+    {
+        uint64_t data = 0;
+
+        while (unbounded_try_dequeue_uint64_t(q, &data) != Queue_Result_Ok)
+        {
+            thrd_yield();
+        }
+
+        bad += (data != i);
+    }
+
+    int result = 0;
+
+    thrd_join(thread, &result);
+
+    EXPECT(!result);
+    EXPECT(!bad);
+
+    destroy(q);
+#else
+    (void) q;
+#endif
+
+    return NULL;
+}
+
+// -----------------------------------------------------------------------------
+
+typedef const char* (*Test)(void);
+#define TEST(x) { #x, x }
+
+struct
+{
+    const char* name;
+    Test        test;
+}
+static tests[] =
+{
+      TEST(create)
+    , TEST(grow)
+    , TEST(recycle)
+    , TEST(threads)
+};
+
+#define TEST_COUNT (sizeof(tests) / sizeof(tests[0]))
+
+int main(int arg_count, char** args)
+{
+    (void) arg_count;
+    (void) args;
+
+    for (unsigned j = 0; j < TEST_COUNT; j++)
+    {
+        const char* error = tests[j].test();
+
+        printf
+        (
+              "Test: %s: %-20s: %s%s\n"
+            , "Unbounded"
+            , tests[j].name
+            , (error ? "FAIL: " : "PASS")
+            , (error ? error : "")
+        );
+
+        fflush(stdout);
+
+        if (error)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}